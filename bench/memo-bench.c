@@ -0,0 +1,1110 @@
+/*
+*
+* Copyright 2012  Samsung Electronics Co., Ltd
+*
+* Licensed under the Flora License, Version 1.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.tizenopensource.org/license
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+
+/*
+ * memo-bench : latency, throughput and allocations of the public memo APIs
+ * on synthetic databases.
+ *
+ * Every result is printed as one JSON object per line on stdout:
+ *   {"bench":"memo_get_data","memos":1000,"tombstone_ratio":0.10,"content_len":200,
+ *    "iterations":200,"p50_us":12.3,"p99_us":40.1,"ops_per_sec":70000.0,
+ *    "allocs_per_op":5.0,"alloc_bytes_per_op":420.0}
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <limits.h>
+#include <time.h>
+#include <sqlite3.h>
+
+#include "memo-db.h"
+#include "db-hash.h"
+#include "db-match.h"
+#include "db-compress.h"
+#include "db-collate.h"
+#include "db-schema.h"
+#include "db-alloc.h"
+
+#define MAX_SIZES 8
+#define DEFAULT_ITERATIONS 200
+#define DEFAULT_WARMUP 10
+
+struct bench_config {
+    int sizes[MAX_SIZES];
+    int n_sizes;
+    double tombstone_ratio;
+    int content_len;
+    int iterations;
+    int warmup;
+    const char *dir;
+    const char *only;
+    int stress; /* writer processes of the stress mode, 0 : benchmarks */
+};
+
+struct bench_ctx {
+    struct bench_config *cfg;
+    char db_path[512];
+    char archive_path[600];
+    int memos;
+    int *ids; /* live ids */
+    int n_ids;
+    unsigned int seed;
+    memo_search_session_t *search; /* of memo_search_session_typing */
+    sqlite3 *raw; /* own connection of the scan_* benchmarks */
+    int compress; /* threshold of memo_set_compression the corpus is written with, 0 : plain */
+};
+
+/******************************
+* allocation counting
+*******************************/
+static unsigned long long alloc_count = 0;
+static unsigned long long alloc_bytes = 0;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nmemb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+char *__real_strdup(const char *s);
+char *__real_strndup(const char *s, size_t n);
+
+void *__wrap_malloc(size_t size)
+{
+    alloc_count++;
+    alloc_bytes += size;
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t nmemb, size_t size)
+{
+    alloc_count++;
+    alloc_bytes += nmemb * size;
+    return __real_calloc(nmemb, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    alloc_count++;
+    alloc_bytes += size;
+    return __real_realloc(ptr, size);
+}
+
+char *__wrap_strdup(const char *s)
+{
+    alloc_count++;
+    alloc_bytes += strlen(s) + 1;
+    return __real_strdup(s);
+}
+
+char *__wrap_strndup(const char *s, size_t n)
+{
+    alloc_count++;
+    alloc_bytes += n + 1;
+    return __real_strndup(s, n);
+}
+
+/******************************
+* helpers
+*******************************/
+static const char *words[] = {
+    "meeting", "tomorrow", "shopping", "list", "milk", "bread", "call", "mom",
+    "project", "deadline", "idea", "recipe", "password", "birthday", "gift", "travel",
+    "\xEC\x98\xA4\xEB\x8A\x98", "\xEB\x82\xB4\xEC\x9D\xBC", "\xED\x9A\x8C\xEC\x9D\x98",
+    "\xEC\x95\xBD\xEC\x86\x8D", "book", "movie", "doctor", "appointment",
+};
+#define N_WORDS (int)(sizeof(words) / sizeof(words[0]))
+
+static double _now_us(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static char *_make_text(unsigned int *seed, int len)
+{
+    char *p = (char *)malloc(len + 32);
+    int n = 0;
+    const char *w;
+
+    while (n < len) {
+        w = words[rand_r(seed) % N_WORDS];
+        n += sprintf(p + n, "%s ", w);
+    }
+    p[n] = '\0';
+    return p;
+}
+
+static int _cmp_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void _report(struct bench_ctx *ctx, const char *name, double *samples, int n,
+        double total_us, unsigned long long allocs, unsigned long long bytes)
+{
+    if (n == 0) {
+        return;
+    }
+    qsort(samples, n, sizeof(double), _cmp_double);
+    printf("{\"bench\":\"%s\",\"memos\":%d,\"tombstone_ratio\":%.2f,\"content_len\":%d,"
+            "\"iterations\":%d,\"p50_us\":%.1f,\"p99_us\":%.1f,\"ops_per_sec\":%.1f,"
+            "\"allocs_per_op\":%.1f,\"alloc_bytes_per_op\":%.1f}\n",
+            name, ctx->memos, ctx->cfg->tombstone_ratio, ctx->cfg->content_len,
+            n, samples[n / 2], samples[(int)(n * 0.99)], total_us > 0 ? n * 1e6 / total_us : 0,
+            (double)allocs / n, (double)bytes / n);
+    fflush(stdout);
+}
+
+typedef void (*bench_fn)(struct bench_ctx *ctx, int i);
+
+/* run fn warmup + iterations times, the warmup runs are not reported */
+static void _run(struct bench_ctx *ctx, const char *name, bench_fn fn, int iterations)
+{
+    double *samples;
+    double t0, t1, total = 0;
+    unsigned long long allocs = 0, bytes = 0, a0, b0;
+    int i;
+
+    if (ctx->cfg->only && strstr(name, ctx->cfg->only) == NULL) {
+        return;
+    }
+    if (iterations < 1) {
+        iterations = 1;
+    }
+
+    samples = (double *)malloc(sizeof(double) * iterations);
+    for (i = 0; i < ctx->cfg->warmup; i++) {
+        fn(ctx, i);
+    }
+    for (i = 0; i < iterations; i++) {
+        a0 = alloc_count;
+        b0 = alloc_bytes;
+        t0 = _now_us();
+        fn(ctx, i);
+        t1 = _now_us();
+        allocs += alloc_count - a0;
+        bytes += alloc_bytes - b0;
+        samples[i] = t1 - t0;
+        total += t1 - t0;
+    }
+    _report(ctx, name, samples, iterations, total, allocs, bytes);
+    free(samples);
+}
+
+static int _random_id(struct bench_ctx *ctx)
+{
+    if (ctx->n_ids == 0) {
+        return 1;
+    }
+    return ctx->ids[rand_r(&ctx->seed) % ctx->n_ids];
+}
+
+/******************************
+* synthetic database
+*******************************/
+static int _generate(struct bench_ctx *ctx)
+{
+    sqlite3 *db = NULL;
+    sqlite3_stmt *stmt = NULL;
+    int count = 0;
+    int i, plen;
+    char *text;
+    unsigned char *packed;
+    time_t now = time(NULL);
+    unsigned int seed = 1234;
+
+    unlink(ctx->db_path);
+
+    /* let the library create the schema */
+    if (memo_init(ctx->db_path) != 0 || memo_get_count(&count) != 0) {
+        fprintf(stderr, "can't create %s\n", ctx->db_path);
+        return -1;
+    }
+    memo_fini();
+
+    /* sort_key is set here like the library does, with its memo_unpack and memo_sort_key */
+    if (sqlite3_open(ctx->db_path, &db) != SQLITE_OK
+            || db_compress_register(db) == -1 || db_collate_register(db) == -1) {
+        sqlite3_close(db);
+        return -1;
+    }
+    sqlite3_exec(db, "BEGIN", NULL, NULL, NULL);
+    sqlite3_prepare_v2(db, "insert into memo (content, create_time, modi_time, delete_time, doodle, color, "
+            "comment, favorite, font_respect, font_size, font_color, doodle_path, content_hash, "
+            "create_utime, modi_utime, sort_key) values (?1, ?2, ?3, ?4, 0, ?5, NULL, ?6, 1, 44, 0, NULL, ?7, "
+            "?2 * 1000000, ?3 * 1000000 + ?8, " MEMO_SORT_KEY_OF("?1", "NULL") ")", -1, &stmt, NULL);
+
+    ctx->ids = (int *)malloc(sizeof(int) * ctx->memos);
+    ctx->n_ids = 0;
+    for (i = 0; i < ctx->memos; i++) {
+        int deleted = rand_r(&seed) < ctx->cfg->tombstone_ratio * RAND_MAX;
+        time_t created = now - (ctx->memos - i) * 60;
+
+        text = _make_text(&seed, ctx->cfg->content_len);
+        sqlite3_bind_int64(stmt, 7, db_hash_memo(text, NULL, NULL));
+        sqlite3_bind_int(stmt, 8, i); /* unique like the library's stamps */
+        packed = NULL;
+        if (ctx->compress > 0 && strlen(text) >= ctx->compress) {
+            packed = db_compress_pack(text, strlen(text), &plen);
+        }
+        if (packed != NULL) { /* as the library stores it, see db_compress_make_constant */
+            sqlite3_bind_blob(stmt, 1, packed, plen, db_free);
+            free(text);
+        } else {
+            sqlite3_bind_text(stmt, 1, text, -1, free);
+        }
+        sqlite3_bind_int64(stmt, 2, created);
+        sqlite3_bind_int64(stmt, 3, created + rand_r(&seed) % 3600);
+        sqlite3_bind_int64(stmt, 4, deleted ? now : -1);
+        sqlite3_bind_int(stmt, 5, rand_r(&seed) % 8);
+        sqlite3_bind_int(stmt, 6, rand_r(&seed) % 10 == 0);
+        sqlite3_step(stmt);
+        sqlite3_reset(stmt);
+        if (!deleted) {
+            ctx->ids[ctx->n_ids++] = sqlite3_last_insert_rowid(db);
+        }
+    }
+    sqlite3_finalize(stmt);
+    sqlite3_exec(db, "COMMIT", NULL, NULL, NULL);
+    sqlite3_close(db);
+    return 0;
+}
+
+/* drop the db file from the page cache, so the next open starts cold */
+static void _drop_cache(const char *path)
+{
+    int fd = open(path, O_RDONLY);
+
+    if (fd >= 0) {
+        fdatasync(fd);
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+}
+
+/******************************
+* benchmarks
+*******************************/
+static void _iter_cb(memo_data_t *md, void *user_data)
+{
+    (*(int *)user_data)++;
+}
+
+static void b_startup_first_list(struct bench_ctx *ctx, int i)
+{
+    int idx[20];
+
+    memo_fini();
+    _drop_cache(ctx->db_path);
+    memo_init(ctx->db_path);
+    memo_get_indexes(idx, 20, MEMO_SORT_CREATE_TIME);
+}
+
+static void b_get_data(struct bench_ctx *ctx, int i)
+{
+    memo_free_data(memo_get_data(_random_id(ctx)));
+}
+
+/* the visible rows of a list page */
+static void b_get_data_page(struct bench_ctx *ctx, int i)
+{
+    int k;
+
+    for (k = 0; k < 20; k++) {
+        memo_free_data(memo_get_data(_random_id(ctx)));
+    }
+}
+
+static void b_get_data_many(struct bench_ctx *ctx, int i)
+{
+    int ids[20];
+    int k;
+
+    for (k = 0; k < 20; k++) {
+        ids[k] = _random_id(ctx);
+    }
+    memo_free_data_many(memo_get_data_many(ids, 20));
+}
+
+static void b_get_modified_time(struct bench_ctx *ctx, int i)
+{
+    memo_get_modified_time(_random_id(ctx));
+}
+
+/* validation of a cached list page */
+static void b_get_modified_time_page(struct bench_ctx *ctx, int i)
+{
+    int k;
+
+    for (k = 0; k < 20; k++) {
+        memo_get_modified_time(_random_id(ctx));
+    }
+}
+
+static void b_probe_many(struct bench_ctx *ctx, int i)
+{
+    struct memo_probe probes[20];
+    int ids[20];
+    int k;
+
+    for (k = 0; k < 20; k++) {
+        ids[k] = _random_id(ctx);
+    }
+    memo_probe_many(ids, 20, probes);
+}
+
+static void b_get_count(struct bench_ctx *ctx, int i)
+{
+    int count;
+    memo_get_count(&count);
+}
+
+static void b_get_indexes(struct bench_ctx *ctx, int i)
+{
+    int idx[50];
+    memo_get_indexes(idx, 50, MEMO_SORT_CREATE_TIME);
+}
+
+static void b_get_all_data_list(struct bench_ctx *ctx, int i)
+{
+    memo_free_data_list(memo_get_all_data_list());
+}
+
+static void b_all_data(struct bench_ctx *ctx, int i)
+{
+    int n = 0;
+    memo_all_data(_iter_cb, &n);
+}
+
+static int _first_cb(memo_data_t *md, void *user_data)
+{
+    int *n = user_data;
+    return ++*n < 3 ? MEMO_ITERATE_CONTINUE : MEMO_ITERATE_STOP;
+}
+
+/* the preview strip of the home screen, the first three memos */
+static void b_all_data_first3(struct bench_ctx *ctx, int i)
+{
+    int n = 0;
+    memo_all_data_ex(-1, 0, NULL, _first_cb, &n);
+}
+
+static void b_search_data_first3(struct bench_ctx *ctx, int i)
+{
+    int n = 0;
+    memo_search_data_ex("a", -1, 0, MEMO_SORT_CREATE_TIME, _first_cb, &n);
+}
+
+/* one page of each app tab */
+static void b_page_favorites(struct bench_ctx *ctx, int i)
+{
+    int n = 0;
+    struct memo_filter filter = { MEMO_FILTER_FAVORITE, 0, 0 };
+    memo_all_data_filtered(20, 0, MEMO_SORT_CREATE_TIME, &filter, _iter_cb, &n);
+}
+
+static void b_page_recent(struct bench_ctx *ctx, int i)
+{
+    int n = 0;
+    memo_all_data_filtered(20, 0, MEMO_SORT_MODI_TIME, NULL, _iter_cb, &n);
+}
+
+static void b_page_title(struct bench_ctx *ctx, int i)
+{
+    int n = 0;
+    memo_all_data_filtered(20, 0, MEMO_SORT_TITLE_ASC, NULL, _iter_cb, &n);
+}
+
+static void b_page_color(struct bench_ctx *ctx, int i)
+{
+    int n = 0;
+    struct memo_filter filter = { MEMO_FILTER_COLOR, i % 8, 0 };
+    memo_all_data_filtered(20, 0, MEMO_SORT_CREATE_TIME, &filter, _iter_cb, &n);
+}
+
+static void b_search_data(struct bench_ctx *ctx, int i)
+{
+    int n = 0;
+    memo_search_data(words[i % N_WORDS], 20, 0, MEMO_SORT_CREATE_TIME, _iter_cb, &n);
+}
+
+/* no memo has it, so every memo is read */
+static void _search_parallel(int threads)
+{
+    int n = 0;
+    memo_search_data_parallel("xylophone", 20, 0, MEMO_SORT_CREATE_TIME, threads, _iter_cb, &n);
+}
+
+static void b_search_scan(struct bench_ctx *ctx, int i)
+{
+    int n = 0;
+    memo_search_data("xylophone", 20, 0, MEMO_SORT_CREATE_TIME, _iter_cb, &n);
+}
+
+static void b_search_parallel_1(struct bench_ctx *ctx, int i)
+{
+    _search_parallel(1);
+}
+
+static void b_search_parallel_2(struct bench_ctx *ctx, int i)
+{
+    _search_parallel(2);
+}
+
+static void b_search_parallel_4(struct bench_ctx *ctx, int i)
+{
+    _search_parallel(4);
+}
+
+static void b_search_data_title(struct bench_ctx *ctx, int i)
+{
+    int n = 0;
+    memo_search_data(words[i % N_WORDS], 20, 0, MEMO_SORT_TITLE_ASC, _iter_cb, &n);
+}
+
+/* keystroke i types the (i % 12 + 1)th character of a two word phrase, which gets rarer as it grows */
+static void _typed(int i, char *buf, int len)
+{
+    int w = i / 12;
+
+    snprintf(buf, len, "%s %s", words[w % 16], words[(w * 7 + 3) % 16]);
+    if (len > i % 12 + 1) {
+        buf[i % 12 + 1] = '\0';
+    }
+}
+
+static void b_search_typing(struct bench_ctx *ctx, int i)
+{
+    int n = 0;
+    char typed[32];
+
+    _typed(i, typed, sizeof(typed));
+    memo_search_data(typed, 20, 0, MEMO_SORT_CREATE_TIME, _iter_cb, &n);
+}
+
+static void b_search_session_typing(struct bench_ctx *ctx, int i)
+{
+    int n = 0;
+    char typed[32];
+
+    _typed(i, typed, sizeof(typed));
+    memo_search_session_data(ctx->search, typed, 20, 0, MEMO_SORT_CREATE_TIME, _iter_cb, &n);
+}
+
+/* the content column scanned with LIKE and with memo_contains, hits, a miss and UTF-8 */
+static const char *scan_needles[] = {
+    "meeting", "DeadLine", "xylophone", "\xEC\x95\xBD\xEC\x86\x8D",
+};
+
+static void _scan(struct bench_ctx *ctx, const char *query, int i)
+{
+    sqlite3_stmt *stmt = NULL;
+
+    sqlite3_prepare_v2(ctx->raw, query, -1, &stmt, NULL);
+    sqlite3_bind_text(stmt, 1, scan_needles[i % 4], -1, SQLITE_STATIC);
+    sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+}
+
+static void b_scan_like(struct bench_ctx *ctx, int i)
+{
+    _scan(ctx, "select count(*) from memo where delete_time = -1 and content like '%' || ?1 || '%'", i);
+}
+
+static void b_scan_contains(struct bench_ctx *ctx, int i)
+{
+    _scan(ctx, "select count(*) from memo where delete_time = -1 and " MEMO_CONTAINS_FUNC "(content, ?1)", i);
+}
+
+static void b_get_operation_list(struct bench_ctx *ctx, int i)
+{
+    memo_free_operation_list(memo_get_operation_list(time(NULL) - 3600));
+}
+
+static void b_add_data(struct bench_ctx *ctx, int i)
+{
+    struct memo_data *md = memo_create_data();
+
+    md->content = _make_text(&ctx->seed, ctx->cfg->content_len);
+    md->font_respect = 1;
+    memo_add_data(md);
+    memo_free_data(md);
+}
+
+/* an existing memo, so only the lookup runs */
+static void b_add_data_if_absent(struct bench_ctx *ctx, int i)
+{
+    struct memo_data *md = memo_get_data(_random_id(ctx));
+
+    if (md) {
+        memo_add_data_if_absent(md);
+        memo_free_data(md);
+    }
+}
+
+static void b_mod_data(struct bench_ctx *ctx, int i)
+{
+    struct memo_data *md = memo_create_data();
+
+    md->id = _random_id(ctx);
+    md->content = _make_text(&ctx->seed, ctx->cfg->content_len);
+    md->font_respect = 1;
+    memo_mod_data(md);
+    memo_free_data(md);
+}
+
+static void b_del_data(struct bench_ctx *ctx, int i)
+{
+    /* delete from the end of the live ids, so each iteration removes a live memo */
+    if (ctx->n_ids > 1) {
+        memo_del_data(ctx->ids[--ctx->n_ids]);
+    }
+}
+
+static void b_del_data_many(struct bench_ctx *ctx, int i)
+{
+    int n = ctx->n_ids > 11 ? 10 : 0;
+
+    if (n > 0) {
+        ctx->n_ids -= n;
+        memo_del_data_many(ctx->ids + ctx->n_ids, n);
+    }
+}
+
+static void _export(int format, int threads)
+{
+    int fd = open("/dev/null", O_WRONLY);
+
+    memo_export_set_threads(threads);
+    memo_export(fd, format);
+    memo_export_set_threads(1);
+    close(fd);
+}
+
+static void b_export_jsonl(struct bench_ctx *ctx, int i)
+{
+    _export(MEMO_EXPORT_JSON_LINES, 1);
+}
+
+static void b_export_jsonl_4(struct bench_ctx *ctx, int i)
+{
+    _export(MEMO_EXPORT_JSON_LINES, 4);
+}
+
+static void b_export_binary(struct bench_ctx *ctx, int i)
+{
+    _export(MEMO_EXPORT_BINARY, 1);
+}
+
+static void b_backup(struct bench_ctx *ctx, int i)
+{
+    char path[600];
+
+    snprintf(path, sizeof(path), "%s.backup", ctx->db_path);
+    memo_backup(path);
+    unlink(path);
+}
+
+static void b_import(struct bench_ctx *ctx, int i)
+{
+    char path[600];
+    int fd;
+
+    snprintf(path, sizeof(path), "%s.import", ctx->db_path);
+    unlink(path);
+    memo_init(path);
+    fd = open(ctx->archive_path, O_RDONLY);
+    memo_import(fd, MEMO_IMPORT_SKIP, NULL, NULL);
+    close(fd);
+    memo_fini();
+    unlink(path);
+}
+
+/* every memo of the archive is already there */
+static void b_import_duplicates(struct bench_ctx *ctx, int i)
+{
+    int fd = open(ctx->archive_path, O_RDONLY);
+
+    memo_import(fd, MEMO_IMPORT_SKIP, NULL, NULL);
+    close(fd);
+}
+
+static void b_content_read(struct bench_ctx *ctx, int i)
+{
+    char buf[4096];
+    memo_content_stream_t *s = memo_content_open(_random_id(ctx), MEMO_CONTENT_READ);
+
+    while (s && memo_content_read(s, buf, sizeof(buf)) > 0);
+    memo_content_close(s);
+}
+
+static void b_snapshot_open(struct bench_ctx *ctx, int i)
+{
+    char path[600];
+    memo_snapshot_t *s;
+    int n, k;
+
+    snprintf(path, sizeof(path), "%s.snapshot", ctx->db_path);
+    s = memo_snapshot_open(path);
+    n = memo_snapshot_count(s);
+    for (k = 0; k < n && k < 20; k++) {
+        memo_snapshot_preview(s, memo_snapshot_record(s, k));
+    }
+    memo_snapshot_close(s);
+}
+
+/*
+ * Peak RSS of one call of fn in a fresh process, with the memory budget if given.
+ * The forked child starts with the pages of the parent, its peak before memo_init
+ * is the baseline.
+ */
+static void _run_rss(struct bench_ctx *ctx, const char *name, bench_fn fn,
+        const struct memo_memory_budget *budget)
+{
+    struct rusage ru;
+    long base;
+    int status;
+    pid_t pid;
+
+    if (ctx->cfg->only && strstr(name, ctx->cfg->only) == NULL) {
+        return;
+    }
+    fflush(stdout);
+    pid = fork();
+    if (pid == 0) {
+        if (budget != NULL && memo_set_memory_budget(budget) != 0) {
+            _exit(1);
+        }
+        getrusage(RUSAGE_SELF, &ru);
+        base = ru.ru_maxrss;
+        memo_init(ctx->db_path);
+        fn(ctx, 0);
+        getrusage(RUSAGE_SELF, &ru);
+        printf("{\"bench\":\"%s\",\"memos\":%d,\"tombstone_ratio\":%.2f,\"content_len\":%d,"
+                "\"peak_rss_kb\":%ld}\n",
+                name, ctx->memos, ctx->cfg->tombstone_ratio, ctx->cfg->content_len, ru.ru_maxrss - base);
+        fflush(stdout);
+        memo_fini();
+        _exit(0);
+    }
+    if (pid > 0) {
+        waitpid(pid, &status, 0);
+    }
+}
+
+/*
+ * The same corpus stored plain and compressed: file size and read latency of each.
+ * The db is written with memo_set_compression(threshold), reads decompress it.
+ */
+static void _run_compression(struct bench_config *cfg, int memos)
+{
+    static const int thresholds[] = {0, 64};
+    static const struct {
+        const char *name;
+        bench_fn fn;
+        int heavy;
+    } reads[] = {
+        {"memo_get_data", b_get_data, 0},
+        {"memo_get_data_page_20", b_get_data_page, 0},
+        {"memo_get_all_data_list", b_get_all_data_list, 1},
+        {"memo_search_data", b_search_data, 1},
+    };
+    struct bench_ctx ctx;
+    struct stat st;
+    char name[NAME_MAX];
+    const char *tag;
+    int heavy = cfg->iterations * 1000 / (memos > 0 ? memos : 1);
+    int k, r, selected = 0;
+
+    if (heavy < 5) {
+        heavy = 5;
+    }
+    if (heavy > cfg->iterations) {
+        heavy = cfg->iterations;
+    }
+    for (k = 0; k < sizeof(thresholds) / sizeof(thresholds[0]); k++) {
+        tag = thresholds[k] > 0 ? "on" : "off";
+        snprintf(name, sizeof(name), "compress_%s_db_size", tag);
+        selected |= cfg->only == NULL || strstr(name, cfg->only) != NULL;
+        for (r = 0; r < sizeof(reads) / sizeof(reads[0]); r++) {
+            snprintf(name, sizeof(name), "compress_%s_%s", tag, reads[r].name);
+            selected |= cfg->only == NULL || strstr(name, cfg->only) != NULL;
+        }
+    }
+    if (!selected) { /* the corpus takes long to write */
+        return;
+    }
+
+    for (k = 0; k < sizeof(thresholds) / sizeof(thresholds[0]); k++) {
+        memset(&ctx, 0, sizeof(ctx));
+        ctx.cfg = cfg;
+        ctx.memos = memos;
+        ctx.seed = 42;
+        ctx.compress = thresholds[k];
+        tag = ctx.compress > 0 ? "on" : "off";
+        snprintf(ctx.db_path, sizeof(ctx.db_path), "%s/memo-bench-%d-z%d.db", cfg->dir, memos, ctx.compress);
+        if (_generate(&ctx) != 0) {
+            continue;
+        }
+        snprintf(name, sizeof(name), "compress_%s_db_size", tag);
+        if ((cfg->only == NULL || strstr(name, cfg->only) != NULL) && stat(ctx.db_path, &st) == 0) {
+            printf("{\"bench\":\"%s\",\"memos\":%d,\"tombstone_ratio\":%.2f,\"content_len\":%d,"
+                    "\"threshold\":%d,\"bytes\":%lld}\n",
+                    name, memos, cfg->tombstone_ratio, cfg->content_len, ctx.compress, (long long)st.st_size);
+            fflush(stdout);
+        }
+        memo_set_compression(ctx.compress);
+        memo_init(ctx.db_path);
+        for (r = 0; r < sizeof(reads) / sizeof(reads[0]); r++) {
+            snprintf(name, sizeof(name), "compress_%s_%s", tag, reads[r].name);
+            _run(&ctx, name, reads[r].fn, reads[r].heavy ? heavy : cfg->iterations);
+        }
+        memo_fini();
+        unlink(ctx.db_path);
+        free(ctx.ids);
+    }
+    memo_set_compression(0);
+}
+
+static void _run_size(struct bench_config *cfg, int memos)
+{
+    struct memo_memory_budget budget;
+    struct bench_ctx ctx;
+    int heavy; /* iterations for the O(n) list APIs */
+    char path[600];
+    int fd;
+
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.cfg = cfg;
+    ctx.memos = memos;
+    ctx.seed = 42;
+    snprintf(ctx.db_path, sizeof(ctx.db_path), "%s/memo-bench-%d.db", cfg->dir, memos);
+
+    if (_generate(&ctx) != 0) {
+        return;
+    }
+
+    heavy = cfg->iterations * 1000 / (memos > 0 ? memos : 1);
+    if (heavy < 5) {
+        heavy = 5;
+    }
+    if (heavy > cfg->iterations) {
+        heavy = cfg->iterations;
+    }
+
+    /* a phone sized budget: small page cache, lists up to 1 MiB */
+    memset(&budget, 0, sizeof(budget));
+    budget.soft_heap_limit = 2 * 1024 * 1024;
+    budget.hard_heap_limit = 8 * 1024 * 1024;
+    budget.cache_size_kb = 256;
+    budget.lookaside_slot_size = 64;
+    budget.lookaside_slots = 32;
+    budget.list_limit = 1024 * 1024;
+    _run_rss(&ctx, "rss_get_all_data_list", b_get_all_data_list, NULL);
+    _run_rss(&ctx, "rss_get_all_data_list_budget", b_get_all_data_list, &budget);
+    _run_rss(&ctx, "rss_all_data", b_all_data, NULL);
+    _run_rss(&ctx, "rss_all_data_budget", b_all_data, &budget);
+
+    memo_init(ctx.db_path);
+
+    _run(&ctx, "startup_first_list", b_startup_first_list, cfg->iterations / 10);
+    _run(&ctx, "memo_get_data", b_get_data, cfg->iterations);
+    _run(&ctx, "memo_get_data_page_20", b_get_data_page, cfg->iterations);
+    _run(&ctx, "memo_get_data_many_20", b_get_data_many, cfg->iterations);
+    _run(&ctx, "memo_get_modified_time", b_get_modified_time, cfg->iterations);
+    _run(&ctx, "memo_get_modified_time_page_20", b_get_modified_time_page, cfg->iterations);
+    _run(&ctx, "memo_probe_many_20", b_probe_many, cfg->iterations);
+    _run(&ctx, "memo_get_count", b_get_count, cfg->iterations);
+    _run(&ctx, "memo_get_indexes", b_get_indexes, cfg->iterations);
+    _run(&ctx, "memo_get_all_data_list", b_get_all_data_list, heavy);
+    _run(&ctx, "memo_all_data", b_all_data, heavy);
+    _run(&ctx, "memo_all_data_first3", b_all_data_first3, cfg->iterations);
+    _run(&ctx, "memo_page_favorites", b_page_favorites, cfg->iterations);
+    _run(&ctx, "memo_page_recent", b_page_recent, cfg->iterations);
+    _run(&ctx, "memo_page_color", b_page_color, cfg->iterations);
+    _run(&ctx, "memo_page_title", b_page_title, cfg->iterations);
+    _run(&ctx, "memo_search_data", b_search_data, heavy);
+    _run(&ctx, "memo_search_data_first3", b_search_data_first3, cfg->iterations);
+    _run(&ctx, "memo_search_data_title", b_search_data_title, heavy);
+    _run(&ctx, "memo_search_scan", b_search_scan, heavy);
+    _run(&ctx, "memo_search_parallel_1", b_search_parallel_1, heavy);
+    _run(&ctx, "memo_search_parallel_2", b_search_parallel_2, heavy);
+    _run(&ctx, "memo_search_parallel_4", b_search_parallel_4, heavy);
+    if (sqlite3_open(ctx.db_path, &ctx.raw) == SQLITE_OK && db_match_register(ctx.raw) == 0) {
+        _run(&ctx, "scan_like", b_scan_like, heavy);
+        _run(&ctx, "scan_contains", b_scan_contains, heavy);
+    }
+    sqlite3_close(ctx.raw);
+    _run(&ctx, "memo_search_typing", b_search_typing, heavy);
+    ctx.search = memo_search_session_open();
+    _run(&ctx, "memo_search_session_typing", b_search_session_typing, heavy);
+    memo_search_session_close(ctx.search);
+    _run(&ctx, "memo_get_operation_list", b_get_operation_list, heavy);
+    _run(&ctx, "memo_content_read", b_content_read, cfg->iterations);
+    _run(&ctx, "memo_export_jsonl", b_export_jsonl, heavy);
+    _run(&ctx, "memo_export_jsonl_4threads", b_export_jsonl_4, heavy);
+    _run(&ctx, "memo_export_binary", b_export_binary, heavy);
+    _run(&ctx, "memo_backup", b_backup, heavy);
+
+    snprintf(path, sizeof(path), "%s.snapshot", ctx.db_path);
+    if (memo_snapshot_enable(path) == 0) {
+        _run(&ctx, "memo_snapshot_open", b_snapshot_open, cfg->iterations);
+    }
+    memo_fini(); /* stop publishing snapshots for the write benchmarks */
+    memo_init(ctx.db_path);
+
+    /* the archive is written only when an import benchmark is selected */
+    snprintf(ctx.archive_path, sizeof(ctx.archive_path), "%s.jsonl", ctx.db_path);
+    fd = (cfg->only && strstr("memo_import_duplicates", cfg->only) == NULL) ? -1 : open(ctx.archive_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd >= 0 && memo_export(fd, MEMO_EXPORT_JSON_LINES) == 0) {
+        _run(&ctx, "memo_import_duplicates", b_import_duplicates, heavy);
+        memo_fini();
+        _run(&ctx, "memo_import", b_import, heavy);
+        memo_init(ctx.db_path);
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    unlink(ctx.archive_path);
+
+    _run(&ctx, "memo_add_data", b_add_data, cfg->iterations);
+    _run(&ctx, "memo_add_data_if_absent", b_add_data_if_absent, cfg->iterations);
+    _run(&ctx, "memo_mod_data", b_mod_data, cfg->iterations);
+    _run(&ctx, "memo_del_data", b_del_data, cfg->iterations);
+    _run(&ctx, "memo_del_data_many_10", b_del_data_many, cfg->iterations / 10);
+
+    memo_fini();
+    unlink(path);
+    unlink(ctx.db_path);
+    free(ctx.ids);
+}
+
+/******************************
+* multi-process stress
+*******************************/
+struct stress_result {
+    int added;
+    int failed;
+    struct memo_stats stats;
+};
+
+/*
+ * One of the processes sharing the db, like the memo app, widget and sync daemon do:
+ * it adds memos, every fourth one long enough to be written in a transaction,
+ * edits its previous memo and lists the newest memos in between.
+ */
+static void _stress_proc(struct bench_ctx *ctx, int proc, int fd)
+{
+    struct stress_result r;
+    struct memo_data *md;
+    int idx[20];
+    int prev = 0;
+    int i, id;
+
+    memset(&r, 0, sizeof(r));
+    ctx->seed = 1000 + proc;
+    memo_init(ctx->db_path);
+    memo_stats_enable(true);
+    for (i = 0; i < ctx->cfg->iterations; i++) {
+        md = memo_create_data();
+        md->content = _make_text(&ctx->seed, i % 4 == 0 ? 2000 : ctx->cfg->content_len);
+        id = memo_add_data(md);
+        memo_free_data(md);
+        if (id > 0) {
+            r.added++;
+        } else {
+            r.failed++;
+        }
+
+        if (prev > 0) {
+            md = memo_create_data();
+            md->id = prev;
+            md->content = _make_text(&ctx->seed, ctx->cfg->content_len);
+            if (memo_mod_data(md) != 0) {
+                r.failed++;
+            }
+            memo_free_data(md);
+        }
+        prev = id;
+        memo_get_indexes(idx, 20, MEMO_SORT_CREATE_TIME);
+    }
+    memo_get_stats(&r.stats);
+    memo_fini();
+    if (write(fd, &r, sizeof(r)) != sizeof(r)) {
+        _exit(1);
+    }
+    _exit(0);
+}
+
+/* every memo added by a process must be in the db afterwards */
+static void _stress(struct bench_config *cfg, int memos)
+{
+    struct bench_ctx ctx;
+    struct stress_result r, total;
+    int fds[2];
+    int before = 0, after = 0;
+    int p, status;
+    double t0, t1;
+
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.cfg = cfg;
+    ctx.memos = memos;
+    snprintf(ctx.db_path, sizeof(ctx.db_path), "%s/memo-bench-%d.db", cfg->dir, memos);
+    if (_generate(&ctx) != 0 || pipe(fds) != 0) {
+        return;
+    }
+    memo_init(ctx.db_path);
+    memo_get_count(&before);
+    memo_fini();
+
+    t0 = _now_us();
+    for (p = 0; p < cfg->stress; p++) {
+        if (fork() == 0) {
+            close(fds[0]);
+            _stress_proc(&ctx, p, fds[1]);
+        }
+    }
+    close(fds[1]);
+    memset(&total, 0, sizeof(total));
+    while (read(fds[0], &r, sizeof(r)) == sizeof(r)) {
+        total.added += r.added;
+        total.failed += r.failed;
+        total.stats.busy_waits += r.stats.busy_waits;
+        total.stats.busy_retries += r.stats.busy_retries;
+        total.stats.busy_usec += r.stats.busy_usec;
+        total.stats.busy_timeouts += r.stats.busy_timeouts;
+    }
+    close(fds[0]);
+    while (wait(&status) > 0);
+    t1 = _now_us();
+
+    memo_init(ctx.db_path);
+    memo_get_count(&after);
+    memo_fini();
+
+    printf("{\"bench\":\"stress\",\"memos\":%d,\"procs\":%d,\"writes\":%d,\"added\":%d,"
+            "\"failed\":%d,\"lost\":%d,\"ops_per_sec\":%.1f,\"busy_waits\":%llu,\"busy_retries\":%llu,"
+            "\"busy_wait_ms\":%.1f,\"busy_timeouts\":%llu}\n",
+            memos, cfg->stress, cfg->stress * cfg->iterations * 2, total.added, total.failed,
+            total.added - (after - before), cfg->stress * cfg->iterations * 2 * 1e6 / (t1 - t0),
+            total.stats.busy_waits, total.stats.busy_retries, total.stats.busy_usec / 1e3,
+            total.stats.busy_timeouts);
+    fflush(stdout);
+    unlink(ctx.db_path);
+    free(ctx.ids);
+}
+
+static void _usage(const char *prog)
+{
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  -n, --memos N[,N...]      database sizes (default 1000,10000,100000)\n"
+            "  -t, --tombstones RATIO    ratio of deleted memos (default 0.1)\n"
+            "  -l, --content-len BYTES   content length (default 200)\n"
+            "  -i, --iterations N        measured iterations (default %d)\n"
+            "  -w, --warmup N            warmup iterations (default %d)\n"
+            "  -d, --dir PATH            directory of the temporary databases (default /tmp)\n"
+            "  -b, --bench NAME          run only benchmarks whose name contains NAME\n"
+            "  -s, --stress PROCS        instead of the benchmarks, PROCS processes write\n"
+            "                            iterations memos each to one db\n",
+            prog, DEFAULT_ITERATIONS, DEFAULT_WARMUP);
+}
+
+int main(int argc, char *argv[])
+{
+    static const struct option options[] = {
+        {"memos", required_argument, NULL, 'n'},
+        {"tombstones", required_argument, NULL, 't'},
+        {"content-len", required_argument, NULL, 'l'},
+        {"iterations", required_argument, NULL, 'i'},
+        {"warmup", required_argument, NULL, 'w'},
+        {"dir", required_argument, NULL, 'd'},
+        {"bench", required_argument, NULL, 'b'},
+        {"stress", required_argument, NULL, 's'},
+        {"help", no_argument, NULL, 'h'},
+        {NULL, 0, NULL, 0},
+    };
+    struct bench_config cfg;
+    char *tok, *save = NULL;
+    int c, i;
+
+    memset(&cfg, 0, sizeof(cfg));
+    cfg.sizes[0] = 1000;
+    cfg.sizes[1] = 10000;
+    cfg.sizes[2] = 100000;
+    cfg.n_sizes = 3;
+    cfg.tombstone_ratio = 0.1;
+    cfg.content_len = 200;
+    cfg.iterations = DEFAULT_ITERATIONS;
+    cfg.warmup = DEFAULT_WARMUP;
+    cfg.dir = "/tmp";
+
+    while ((c = getopt_long(argc, argv, "n:t:l:i:w:d:b:s:h", options, NULL)) != -1) {
+        switch (c) {
+        case 'n':
+            cfg.n_sizes = 0;
+            for (tok = strtok_r(optarg, ",", &save); tok && cfg.n_sizes < MAX_SIZES;
+                    tok = strtok_r(NULL, ",", &save)) {
+                cfg.sizes[cfg.n_sizes++] = atoi(tok);
+            }
+            break;
+        case 't':
+            cfg.tombstone_ratio = atof(optarg);
+            break;
+        case 'l':
+            cfg.content_len = atoi(optarg);
+            break;
+        case 'i':
+            cfg.iterations = atoi(optarg);
+            break;
+        case 'w':
+            cfg.warmup = atoi(optarg);
+            break;
+        case 'd':
+            cfg.dir = optarg;
+            break;
+        case 'b':
+            cfg.only = optarg;
+            break;
+        case 's':
+            cfg.stress = atoi(optarg);
+            break;
+        default:
+            _usage(argv[0]);
+            return c == 'h' ? 0 : 1;
+        }
+    }
+
+    for (i = 0; i < cfg.n_sizes; i++) {
+        if (cfg.stress > 0) {
+            _stress(&cfg, cfg.sizes[i]);
+        } else {
+            _run_size(&cfg, cfg.sizes[i]);
+            _run_compression(&cfg, cfg.sizes[i]);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,36 @@
+/*
+*
+* Copyright 2012  Samsung Electronics Co., Ltd
+*
+* Licensed under the Flora License, Version 1.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.tizenopensource.org/license
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+
+#ifndef __MEMO_DB_ALLOC_H__
+#define __MEMO_DB_ALLOC_H__
+
+#include <stddef.h>
+#include "memo-db.h"
+
+/* every allocation of the library, see memo_set_allocator */
+void *db_malloc(size_t size);
+void *db_calloc(size_t nmemb, size_t size);
+void *db_realloc(void *ptr, size_t size);
+void db_free(void *ptr);
+char *db_strdup(const char *s);
+char *db_strndup(const char *s, size_t n);
+
+int db_alloc_set(memo_malloc_fn malloc_fn, memo_free_fn free_fn, memo_realloc_fn realloc_fn,
+        void *ctx, bool sqlite);
+
+#endif /* __MEMO_DB_ALLOC_H__ */
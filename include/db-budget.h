@@ -0,0 +1,30 @@
+/*
+*
+* Copyright 2012  Samsung Electronics Co., Ltd
+*
+* Licensed under the Flora License, Version 1.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.tizenopensource.org/license
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+
+#ifndef __MEMO_DB_BUDGET_H__
+#define __MEMO_DB_BUDGET_H__
+
+#include <stddef.h>
+#include <sqlite3.h>
+#include "memo-db.h"
+
+int db_budget_set(const struct memo_memory_budget *budget);
+int db_budget_apply(sqlite3 *db);
+int db_budget_list_over(size_t bytes);
+
+#endif /* __MEMO_DB_BUDGET_H__ */
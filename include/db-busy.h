@@ -0,0 +1,33 @@
+/*
+*
+* Copyright 2012  Samsung Electronics Co., Ltd
+*
+* Licensed under the Flora License, Version 1.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.tizenopensource.org/license
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+
+#ifndef __MEMO_DB_BUSY_H__
+#define __MEMO_DB_BUSY_H__
+
+#include <sqlite3.h>
+
+#define BUSY_TIMEOUT_DEFAULT 3000 /* msec */
+#define BUSY_DELAY_MIN_DEFAULT 1
+#define BUSY_DELAY_MAX_DEFAULT 64
+
+int db_busy_register(sqlite3 *db);
+int db_busy_wait(int count);
+int db_busy_set_timeout(int timeout_ms);
+int db_busy_set_backoff(int min_delay_ms, int max_delay_ms);
+
+#endif /* __MEMO_DB_BUSY_H__ */
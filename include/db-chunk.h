@@ -0,0 +1,34 @@
+/*
+*
+* Copyright 2012  Samsung Electronics Co., Ltd
+*
+* Licensed under the Flora License, Version 1.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.tizenopensource.org/license
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+
+#ifndef __MEMO_DB_CHUNK_H__
+#define __MEMO_DB_CHUNK_H__
+
+#include <sqlite3.h>
+#include "memo-db.h"
+
+int db_chunk_clear(sqlite3 *db, int id);
+int db_chunk_store(sqlite3 *db, int id, const char *tail, int len);
+char *db_chunk_join(sqlite3 *db, int id, char *head);
+
+memo_content_stream_t *db_content_open(sqlite3 *db, int id, int mode);
+int db_content_read(memo_content_stream_t *s, char *buf, int len);
+int db_content_write(memo_content_stream_t *s, const char *buf, int len);
+int db_content_close(memo_content_stream_t *s);
+
+#endif /* __MEMO_DB_CHUNK_H__ */
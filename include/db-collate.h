@@ -0,0 +1,40 @@
+/*
+*
+* Copyright 2012  Samsung Electronics Co., Ltd
+*
+* Licensed under the Flora License, Version 1.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.tizenopensource.org/license
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+
+#ifndef __MEMO_DB_COLLATE_H__
+#define __MEMO_DB_COLLATE_H__
+
+#include <sqlite3.h>
+
+/* name of the sql function which returns the collation key (BLOB) of a text */
+#define MEMO_SORT_KEY_FUNC "memo_sort_key"
+
+/* name of the sql collation comparing texts like their sort keys */
+#define MEMO_COLLATION "memo_locale"
+
+int db_collate_set_locale(const char *locale);
+
+int db_collate_need_fold(const char *text, int len);
+char *db_collate_fold(const char *text, int len, int *out_len);
+
+int db_collate_register(sqlite3 *db);
+int db_collate_load(sqlite3 *db);
+int db_collate_refresh(sqlite3 *db);
+int db_collate_update_key(sqlite3 *db, int id);
+
+#endif /* __MEMO_DB_COLLATE_H__ */
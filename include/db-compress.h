@@ -0,0 +1,36 @@
+/*
+*
+* Copyright 2012  Samsung Electronics Co., Ltd
+*
+* Licensed under the Flora License, Version 1.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.tizenopensource.org/license
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+
+#ifndef __MEMO_DB_COMPRESS_H__
+#define __MEMO_DB_COMPRESS_H__
+
+#include <sqlite3.h>
+
+/* name of the sql function which returns the plain text of a (possibly) packed column */
+#define MEMO_UNPACK_FUNC "memo_unpack"
+
+void db_compress_set_threshold(int threshold);
+int db_compress_get_threshold(void);
+
+unsigned char *db_compress_pack(const char *input, int len, int *out_len);
+char *db_compress_make_constant(const char *input);
+char *db_decompress(const void *blob, int len);
+
+int db_compress_register(sqlite3 *db);
+
+#endif /* __MEMO_DB_COMPRESS_H__ */
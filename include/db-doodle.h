@@ -0,0 +1,35 @@
+/*
+*
+* Copyright 2012  Samsung Electronics Co., Ltd
+*
+* Licensed under the Flora License, Version 1.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.tizenopensource.org/license
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+
+#ifndef __MEMO_DB_DOODLE_H__
+#define __MEMO_DB_DOODLE_H__
+
+#include <sqlite3.h>
+
+/* files younger than this are never treated as orphans, the app may not have saved the memo yet */
+#define DOODLE_ORPHAN_GRACE 60
+
+/* doodle_path of the memo if no other live memo refers to the same file, NULL otherwise */
+char *db_doodle_path_to_release(sqlite3 *db, int id);
+
+int db_doodle_queue(char *path);
+void db_doodle_flush(void);
+void db_doodle_stop(void);
+int db_doodle_scan_orphans(sqlite3 *db, const char *dir);
+
+#endif /* __MEMO_DB_DOODLE_H__ */
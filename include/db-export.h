@@ -0,0 +1,58 @@
+/*
+*
+* Copyright 2012  Samsung Electronics Co., Ltd
+*
+* Licensed under the Flora License, Version 1.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.tizenopensource.org/license
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+
+/*
+ * Export formats
+ *
+ * JSON lines, one memo per line:
+ *   {"id":1,"create_time":..,"modi_time":..,"doodle":0,"color":0,"favorite":0,
+ *    "font_respect":1,"font_size":44,"font_color":4278190080,"content":"..",
+ *    "comment":null,"doodle_path":null[,"doodle_data":"<base64>"]}
+ *
+ * Binary, little endian:
+ *   "MEXP" u8 version u8 flags u16 reserved
+ *   records, each: u32 length of the rest of the record
+ *                  i32 id, i64 create_time, i64 modi_time,
+ *                  i32 doodle, i32 color, i32 favorite, i32 font_respect, i32 font_size,
+ *                  u32 font_color,
+ *                  str content, str comment, str doodle_path, str doodle_data
+ *   u32 0
+ *   str: u32 length followed by the bytes, EXPORT_NULL_LEN for NULL
+ */
+
+#ifndef __MEMO_DB_EXPORT_H__
+#define __MEMO_DB_EXPORT_H__
+
+#include <stdint.h>
+#include <sqlite3.h>
+
+#define EXPORT_MAGIC        "MEXP"
+#define EXPORT_VERSION      1
+#define EXPORT_NULL_LEN     0xffffffffU
+#define EXPORT_FIXED_LEN    44  /* record bytes before the strings */
+
+#define EXPORT_MAX_THREADS  8
+#define EXPORT_MAX_DOODLE   (16 * 1024 * 1024)
+
+int db_export(sqlite3 *db, int fd, int format, int threads);
+int db_backup(sqlite3 *db, const char *dest);
+
+sqlite3 *db_export_open_reader(const char *path);
+void db_export_close_reader(sqlite3 *db);
+
+#endif /* __MEMO_DB_EXPORT_H__ */
@@ -0,0 +1,43 @@
+/*
+*
+* Copyright 2012  Samsung Electronics Co., Ltd
+*
+* Licensed under the Flora License, Version 1.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.tizenopensource.org/license
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+
+#ifndef __MEMO_DB_HASH_H__
+#define __MEMO_DB_HASH_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* streaming xxHash64 */
+struct db_hash {
+    uint64_t v[4];
+    uint64_t total_len;
+    unsigned char mem[32];
+    size_t memsize;
+};
+
+void db_hash_init(struct db_hash *h, uint64_t seed);
+void db_hash_update(struct db_hash *h, const void *data, size_t len);
+uint64_t db_hash_digest(const struct db_hash *h);
+
+/* value of the content_hash column, over content, comment and doodle_path */
+int64_t db_hash_memo(const char *content, const char *comment, const char *doodle_path);
+
+/* the same when the content is fed with db_hash_update, len bytes in total */
+int64_t db_hash_memo_finish(struct db_hash *h, uint32_t len, const char *comment, const char *doodle_path);
+
+#endif /* __MEMO_DB_HASH_H__ */
@@ -19,10 +19,21 @@
 #ifndef __MEMO_DB_HELPER_H__
 #define __MEMO_DB_HELPER_H__
 
+#include <stdint.h>
+
+/* length of the content column, the rest of a longer memo is stored in memo_chunk */
 #define MEMO_DB_MAX_CONTENT_LEN 1500
+#define MEMO_DB_CHUNK_LEN (32 * 1024)
 
 #define KEY_ID_NAME  "id"
 
+/*
+ * modi_utime of a write: the wall clock in microseconds, or one more than the
+ * latest stamp of the db when the clock is behind it. Evaluated inside the
+ * writing statement, so stamps are unique and increasing across processes.
+ */
+#define NEXT_UTIME_SQL(now) "max(" now ", (select ifnull(max(modi_utime), 0) + 1 from memo))"
+
 enum key_public_t
 {
     KEY_INPUT_END = -1,
@@ -30,7 +41,7 @@ enum key_public_t
     /* common */
     KEY_ITEM_MODE,  /* 0-text, 1-doodle */
     KEY_FAVORITE,
-    KEY_COLOR,
+    KEY_COLOR,      /* passed as a pointer to unsigned int, stored as a signed int */
 
     /* about text */
     KEY_CONTENT,
@@ -51,6 +62,9 @@ enum key_private_t
     KEY_MODI_TIME,
     KEY_DELETE_TIME,
     KEY_WRITTEN_TIME,
+    KEY_CONTENT_HASH,   /* passed as a pointer to int64_t */
+    KEY_CREATE_UTIME,   /* set by the helper, see NEXT_UTIME_SQL */
+    KEY_MODI_UTIME,
 
     END_KEY_PRIVATE,
     TOTAL_NUM_OF_KEYS = END_KEY_PRIVATE,
@@ -62,6 +76,9 @@ struct column_t
     char *type;
 };
 
+int64_t db_now_utime(void);
+
+int db_content_preview_len(const char *content);
 char *db_content_truncate(char *content);
 
 char *db_make_insert_query(int key1, void *val1, ...);
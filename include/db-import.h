@@ -0,0 +1,34 @@
+/*
+*
+* Copyright 2012  Samsung Electronics Co., Ltd
+*
+* Licensed under the Flora License, Version 1.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.tizenopensource.org/license
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+
+#ifndef __MEMO_DB_IMPORT_H__
+#define __MEMO_DB_IMPORT_H__
+
+#include <sqlite3.h>
+#include "memo-db.h"
+
+/* memos per transaction */
+#define IMPORT_BATCH        1000
+
+/* longest record accepted, larger ones are treated as a corrupt archive */
+#define IMPORT_MAX_RECORD   (64 * 1024 * 1024)
+
+int db_import(sqlite3 *db, int fd, MEMO_IMPORT_POLICY policy, const char *doodle_dir,
+        memo_import_progress_cb cb, void *user_data);
+
+#endif /* __MEMO_DB_IMPORT_H__ */
@@ -0,0 +1,40 @@
+/*
+*
+* Copyright 2012  Samsung Electronics Co., Ltd
+*
+* Licensed under the Flora License, Version 1.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.tizenopensource.org/license
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+
+#ifndef __MEMO_DB_MATCH_H__
+#define __MEMO_DB_MATCH_H__
+
+#include <sqlite3.h>
+
+/*
+ * name of the sql function memo_contains(text, needle): 1 when text LIKE '%needle%',
+ * 0 when not and NULL when either is NULL. ASCII letters are case folded like LIKE does,
+ * other letters with Unicode case folding (see db-collate.c), which matches a superset
+ * of LIKE for needles with cased letters outside ASCII.
+ */
+#define MEMO_CONTAINS_FUNC "memo_contains"
+
+struct db_match_needle;
+
+struct db_match_needle *db_match_compile(const char *needle, int len);
+int db_match_find(const struct db_match_needle *n, const char *text, int len);
+void db_match_free(struct db_match_needle *n);
+
+int db_match_register(sqlite3 *db);
+
+#endif /* __MEMO_DB_MATCH_H__ */
@@ -0,0 +1,30 @@
+/*
+*
+* Copyright 2012  Samsung Electronics Co., Ltd
+*
+* Licensed under the Flora License, Version 1.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.tizenopensource.org/license
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+
+#ifndef __MEMO_DB_PSEARCH_H__
+#define __MEMO_DB_PSEARCH_H__
+
+#include <sqlite3.h>
+#include "memo-db.h"
+
+#define PSEARCH_MAX_THREADS 8
+
+int db_search_parallel(sqlite3 *db, const char *search_str, int limit, int offset, MEMO_SORT_TYPE sort,
+        int threads, memo_data_iterate_cb_t cb, void *user_data);
+
+#endif /* __MEMO_DB_PSEARCH_H__ */
@@ -19,6 +19,9 @@
 #ifndef __MEMO_SCHEMA_H__
 #define __MEMO_SCHEMA_H__
 
+/* stored in PRAGMA user_version, increase it whenever the statements below change */
+#define MEMO_SCHEMA_VERSION 8
+
 #define CREATE_MEMO_TABLE " \
 create table if not exists memo ( \
 id INTEGER PRIMARY KEY autoincrement, \
@@ -34,7 +37,80 @@ favorite INTEGER, \
 font_respect INTEGER, \
 font_size INTEGER, \
 font_color INTEGER, \
-doodle_path TEXT \
+doodle_path TEXT, \
+content_hash INTEGER, \
+create_utime INTEGER, \
+modi_utime INTEGER, \
+sort_key BLOB \
+)"
+
+/* create_time and modi_time in microseconds, modi_utime is unique and increasing, see NEXT_UTIME_SQL */
+#define CREATE_MEMO_UTIME_INDEX " \
+create index if not exists memo_modi_utime on memo (modi_utime)"
+
+/* see db-hash.c, only live memos are looked up */
+#define CREATE_MEMO_HASH_INDEX " \
+create index if not exists memo_content_hash on memo (content_hash) \
+where delete_time = -1"
+
+/*
+ * Partial indexes of the list views, see _get_filter_exp in db.c.
+ * "Recently edited" uses memo_modi_utime.
+ */
+#define CREATE_MEMO_LIST_INDEXES " \
+create index if not exists memo_live_create on memo (create_utime) \
+where delete_time = -1; \
+create index if not exists memo_live_favorite on memo (create_utime) \
+where delete_time = -1 and favorite = 1; \
+create index if not exists memo_live_doodle on memo (create_utime) \
+where delete_time = -1 and doodle = 1; \
+create index if not exists memo_live_color on memo (color, create_utime) \
+where delete_time = -1"
+
+/*
+ * Collation key of the first characters of the title (comment, else content), see
+ * db-collate.c. The library sets it with every write of content or comment, on its own
+ * connection which has memo_unpack and memo_sort_key registered; other writers of the
+ * db need neither.
+ */
+#define MEMO_SORT_KEY_OF(content, comment) \
+"memo_sort_key(substr(CASE WHEN " comment " IS NOT NULL THEN memo_unpack(" comment ") \
+ELSE memo_unpack(" content ") END, 1, 64))"
+
+#define MEMO_SORT_KEY_EXP MEMO_SORT_KEY_OF("content", "comment")
+
+#define CREATE_MEMO_SORT_KEY " \
+create index if not exists memo_live_title on memo (sort_key) \
+where delete_time = -1"
+
+/* version 6 kept sort_key with triggers, which failed writes of other connections */
+#define DROP_MEMO_SORT_KEY_TRIGGERS " \
+drop trigger if exists memo_sort_key_insert; \
+drop trigger if exists memo_sort_key_update"
+
+/* settings the stored data depend on, "collation" names the collator of sort_key */
+#define CREATE_MEMO_META_TABLE " \
+create table if not exists memo_meta ( \
+key TEXT PRIMARY KEY, \
+value TEXT \
+)"
+
+/* tail of memos longer than MEMO_DB_MAX_CONTENT_LEN, see db-chunk.c */
+#define CREATE_MEMO_CHUNK_TABLE " \
+create table if not exists memo_chunk ( \
+memo_id INTEGER, \
+seq INTEGER, \
+packed INTEGER, \
+data BLOB, \
+PRIMARY KEY (memo_id, seq) \
+)"
+
+/* doodle thumbnails, valid while modi_time matches modi_utime of the memo, see db-thumb.c */
+#define CREATE_MEMO_THUMB_TABLE " \
+create table if not exists memo_thumb ( \
+memo_id INTEGER PRIMARY KEY, \
+modi_time INTEGER, \
+data BLOB \
 )"
 
 #endif /* __MEMO_SCHEMA_H__ */
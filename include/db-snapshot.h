@@ -0,0 +1,40 @@
+/*
+*
+* Copyright 2012  Samsung Electronics Co., Ltd
+*
+* Licensed under the Flora License, Version 1.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.tizenopensource.org/license
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+
+#ifndef __MEMO_DB_SNAPSHOT_H__
+#define __MEMO_DB_SNAPSHOT_H__
+
+#include <sqlite3.h>
+#include "memo-db.h"
+
+/* published next to the .LIBSLP_MEMO_DB_CHANGED marker */
+#define SNAPSHOT_DEFAULT_PATH "/opt/data/libslp-memo/.memo.snapshot"
+
+int db_snapshot_publish(sqlite3 *db, const char *path);
+int db_snapshot_request(sqlite3 *db, const char *path);
+void db_snapshot_stop(void);
+
+memo_snapshot_t *db_snapshot_open(const char *path);
+void db_snapshot_close(memo_snapshot_t *s);
+int db_snapshot_count(memo_snapshot_t *s);
+unsigned long long db_snapshot_seq(memo_snapshot_t *s);
+const struct memo_snapshot_record *db_snapshot_record(memo_snapshot_t *s, int index);
+const char *db_snapshot_preview(memo_snapshot_t *s, const struct memo_snapshot_record *r);
+int db_snapshot_is_stale(memo_snapshot_t *s);
+
+#endif /* __MEMO_DB_SNAPSHOT_H__ */
@@ -0,0 +1,57 @@
+/*
+*
+* Copyright 2012  Samsung Electronics Co., Ltd
+*
+* Licensed under the Flora License, Version 1.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.tizenopensource.org/license
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+
+#ifndef __MEMO_DB_STATS_H__
+#define __MEMO_DB_STATS_H__
+
+#include <sqlite3.h>
+#include "memo-db.h"
+
+extern int db_stats_enabled;
+
+unsigned long long db_stats_now(void);
+void db_stats_op(MEMO_STAT_OP op, unsigned long long start, int failed);
+void db_stats_rows(MEMO_STAT_OP op, int rows, unsigned long long bytes);
+void db_stats_trans(int notified);
+void db_stats_busy(int first, unsigned long long usec, int timed_out);
+
+void db_stats_enable(int enable);
+void db_stats_get(sqlite3 *db, struct memo_stats *stats);
+void db_stats_reset(sqlite3 *db);
+void db_stats_set_dump_interval(int seconds);
+
+/* cheap enough to leave in hot paths: a single branch while statistics are disabled */
+#define STAT_BEGIN() (db_stats_enabled ? db_stats_now() : 0)
+#define STAT_END(op, start, failed) do { \
+    if (db_stats_enabled) { \
+        db_stats_op(op, start, failed); \
+    } \
+} while (0)
+#define STAT_ROW(op, md) do { \
+    if (db_stats_enabled) { \
+        db_stats_rows(op, 1, ((md)->content ? strlen((md)->content) : 0) \
+            + ((md)->comment ? strlen((md)->comment) : 0)); \
+    } \
+} while (0)
+#define STAT_BUSY(first, usec, timed_out) do { \
+    if (db_stats_enabled) { \
+        db_stats_busy(first, usec, timed_out); \
+    } \
+} while (0)
+
+#endif /* __MEMO_DB_STATS_H__ */
@@ -0,0 +1,31 @@
+/*
+*
+* Copyright 2012  Samsung Electronics Co., Ltd
+*
+* Licensed under the Flora License, Version 1.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.tizenopensource.org/license
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+
+#ifndef __MEMO_DB_THUMB_H__
+#define __MEMO_DB_THUMB_H__
+
+#include <sqlite3.h>
+
+/* larger doodles are not decoded */
+#define THUMB_MAX_SOURCE_PIXELS (4096 * 4096)
+
+int db_thumb_update(sqlite3 *db, int id, const char *path);
+int db_thumb_get(sqlite3 *db, int id, unsigned char **buf, int *len);
+int db_thumb_clear(sqlite3 *db, int id);
+
+#endif /* __MEMO_DB_THUMB_H__ */
@@ -20,6 +20,7 @@
 #define __LIBSLP_MEMO_DB_H__
 
 //#include <sqlite3.h> // changed to db-util.h
+#include <stdint.h>
 #include "db-util.h"
 #include "memo-db.h"
 
@@ -27,21 +28,48 @@ sqlite3* db_init(char *);
 void db_fini(sqlite3 *);
 
 int insert_data(sqlite3 *, struct memo_data *);
+int insert_data_if_absent(sqlite3 *db, struct memo_data *cd);
+int find_content_hash(sqlite3 *db, int64_t hash);
+int get_duplicates(sqlite3 *db, int id, int *ids, int len);
+int foreach_duplicate(sqlite3 *db, void (*cb)(int id, int original, void *user_data), void *user_data);
 int remove_data(sqlite3 *, int id);
+int remove_data_many(sqlite3 *db, const int *ids, int count);
 int update_data(sqlite3 *, struct memo_data *);
+int update_data_if_unchanged(sqlite3 *db, struct memo_data *cd, int64_t expected);
 
 int get_data(sqlite3 *, int , struct memo_data *);
+memo_data_t *get_data_many(sqlite3 *db, const int *ids, int n);
 struct memo_data_list* get_all_data_list(sqlite3 *);
 struct memo_operation_list* get_operation_list(sqlite3 *db, time_t stamp);
+struct memo_operation_list* get_operation_list_since(sqlite3 *db, int64_t ustamp);
 int get_data_count(sqlite3 *db, int *count);
 
 int has_id(sqlite3 *, int id);
+int probe_data(sqlite3 *db, int cid, struct memo_probe *p);
+int probe_data_many(sqlite3 *db, const int *ids, int n, struct memo_probe *probes);
 time_t get_modtime(sqlite3 *, int id);
+int64_t get_modutime(sqlite3 *db, int cid);
 int get_indexes(sqlite3 *db, int *aIndex, int len, MEMO_SORT_TYPE sort);
 int search_data(sqlite3 *db, const char *search_str, int limit, int offset, MEMO_SORT_TYPE sort,
     memo_data_iterate_cb_t cb, void *user_data);
 int all_data(sqlite3 *db, memo_data_iterate_cb_t cb, void *user_data);
 
+int get_indexes_filtered(sqlite3 *db, int *aIndex, int len, MEMO_SORT_TYPE sort,
+    const struct memo_filter *filter);
+int get_data_count_filtered(sqlite3 *db, const struct memo_filter *filter, int *count);
+int search_data_filtered(sqlite3 *db, const char *search_str, int limit, int offset, MEMO_SORT_TYPE sort,
+    const struct memo_filter *filter, memo_data_iterate_cb_t cb, void *user_data);
+int search_data_ex(sqlite3 *db, const char *search_str, int limit, int offset, MEMO_SORT_TYPE sort,
+    memo_data_iterate_ex_cb_t cb, void *user_data);
+int all_data_ex(sqlite3 *db, int limit, int offset, memo_cursor_t *cursor,
+    memo_data_iterate_ex_cb_t cb, void *user_data);
+memo_search_session_t *search_session_open(sqlite3 *db);
+int search_session_data(memo_search_session_t *s, const char *search_str, int limit, int offset,
+    MEMO_SORT_TYPE sort, memo_data_iterate_cb_t cb, void *user_data);
+void search_session_close(memo_search_session_t *s);
+int all_data_filtered(sqlite3 *db, int limit, int offset, MEMO_SORT_TYPE sort,
+    const struct memo_filter *filter, memo_data_iterate_cb_t cb, void *user_data);
+
 #define DBHandle sqlite3
 //#define VCONFKEY_MEMO_DATA_CHANGE "db/memo/data-change"
 
@@ -42,6 +42,7 @@
 #include <string.h>
 #include <time.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -97,9 +98,32 @@ typedef enum {
     MEMO_SORT_CREATE_TIME_ASC,
     MEMO_SORT_TITLE, /* descend */
     MEMO_SORT_TITLE_ASC,
+    MEMO_SORT_MODI_TIME, /* descend, most recently edited first */
+    MEMO_SORT_MODI_TIME_ASC,
     MEMO_SORT_TYPES,
 }MEMO_SORT_TYPE;
 
+/**
+ * @brief Flags of struct memo_filter, combined with AND
+ */
+enum {
+    MEMO_FILTER_FAVORITE = 1 << 0, /**< favorite memos */
+    MEMO_FILTER_COLOR = 1 << 1, /**< memos of memo_filter.color */
+    MEMO_FILTER_DOODLE = 1 << 2, /**< memos with a doodle */
+    MEMO_FILTER_TEXT = 1 << 3, /**< memos without a doodle */
+    MEMO_FILTER_MODIFIED_AFTER = 1 << 4, /**< memos modified after memo_filter.modified_after */
+};
+
+/**
+ * @struct memo_filter
+ * @brief Filter of the *_filtered list APIs, a zeroed filter matches every memo
+ */
+struct memo_filter {
+    unsigned int flags; /**< MEMO_FILTER_* */
+    unsigned int color; /**< background color, with MEMO_FILTER_COLOR */
+    int64_t modified_after; /**< microsecond stamp (see memo_get_modified_utime), with MEMO_FILTER_MODIFIED_AFTER */
+};
+
 /**
  * @struct memo_operation_list
  * @brief List for memo data operation
@@ -108,6 +132,7 @@ struct memo_operation_list {
     int id; /**< index of memo record */
     int operation; /**< operation type */
     struct memo_operation_list *next; /**< Next list */
+    int64_t modi_utime; /**< modify time stamp in microseconds, see memo_get_modified_utime */
 };
 
 /**
@@ -121,10 +146,12 @@ struct memo_operation_list {
  * @return     On success, 0 is returned. On error, -1 is returned
  *
  * @remarks  The function must be called fristly before calling other functions of memo-db.
+ *           The db is opened by the first function accessing it, call memo_prewarm()
+ *           to open it in the background in the meantime.
  *
  * @exception   None
  *
- * @see memo_fini
+ * @see memo_fini memo_prewarm
  *
  * \par Sample code:
  * \code
@@ -135,6 +162,30 @@ struct memo_operation_list {
  */
 int memo_init(char *dbfile);
 
+/**
+ * This function opens the memo database in a background thread, so the first query
+ * does not have to wait for it.
+ *
+ * @brief       Prewarm Memo-Database
+ *
+ * @return     On success, 0 is returned. On error, -1 is returned
+ *
+ * @remarks  The function must be called after memo_init().
+ *
+ * @exception   None
+ *
+ * @see memo_init
+ *
+ * \par Sample code:
+ * \code
+ * ...
+ * memo_init(NULL);
+ * memo_prewarm();
+ * ...
+ * \endcode
+ */
+int memo_prewarm(void);
+
 /**
  * This function fini memo database, it will close db and free db resource
  *
@@ -157,6 +208,74 @@ int memo_init(char *dbfile);
  */
 void memo_fini(void);
 
+/**
+ * Allocator hooks of memo_set_allocator, ctx is the one given to it
+ */
+typedef void *(*memo_malloc_fn) (size_t size, void *ctx);
+typedef void (*memo_free_fn) (void *ptr, void *ctx);
+typedef void *(*memo_realloc_fn) (void *ptr, size_t size, void *ctx);
+
+/**
+ *  This function routes every allocation and free of the library through the given
+ *  functions, e.g. into a pool of the application or to count memory per operation.
+ *  With sqlite set, the allocations of SQLite go through them as well.
+ *
+ * @brief      Set the allocator of the library
+ *
+ * @param     [in] malloc_fn   allocate, NULL (all three) for the libc allocator
+ * @param     [in] free_fn     free, never called with NULL
+ * @param     [in] realloc_fn  reallocate, called with NULL like realloc
+ * @param     [in] ctx         passed to the functions
+ * @param     [in] sqlite      also use them for SQLite (SQLITE_CONFIG_MALLOC)
+ *
+ * @return     Return 0 (Success) or -1 (Failed)
+ *
+ * @remarks    Call it before memo_init, while the library holds no memory.
+ *             With sqlite it must come before anything in the process initializes SQLite,
+ *             and the allocator can not be changed afterwards.
+ *             Strings put into a memo_data which the library frees (memo_free_data)
+ *             must come from malloc_fn too.
+ *
+ * @exception   None
+ *
+ * @see memo_init
+ */
+int memo_set_allocator(memo_malloc_fn malloc_fn, memo_free_fn free_fn, memo_realloc_fn realloc_fn,
+        void *ctx, bool sqlite);
+
+/**
+ * Memory budget of memo_set_memory_budget, 0 leaves a setting at the SQLite default
+ */
+struct memo_memory_budget {
+    int64_t soft_heap_limit;    /**< bytes, SQLite frees cache pages above it */
+    int64_t hard_heap_limit;    /**< bytes, SQLite allocations fail (SQLITE_NOMEM) above it */
+    int cache_size_kb;          /**< page cache of each connection in KiB */
+    int lookaside_slot_size;    /**< bytes of a lookaside slot of each connection */
+    int lookaside_slots;        /**< lookaside slots of each connection */
+    int64_t list_limit;         /**< bytes a list (memo_get_all_data_list, ...) may take */
+};
+
+/**
+ *  This function bounds the memory the library and SQLite use, for devices with little RAM.
+ *  The heap limits are for the whole process, page cache and lookaside for each
+ *  connection the library opens. A list which would take more than list_limit is
+ *  not built, memo_get_all_data_list then returns NULL; iterate with memo_all_data instead.
+ *
+ * @brief      Set the memory budget
+ *
+ * @param     [in] budget   the budget, NULL for no limits
+ *
+ * @return     Return 0 (Success) or -1 (Failed)
+ *
+ * @remarks    Call it before memo_init.
+ *             Within the hard heap limit, reads and writes can fail which would succeed without it.
+ *
+ * @exception   None
+ *
+ * @see memo_init, memo_all_data
+ */
+int memo_set_memory_budget(const struct memo_memory_budget *budget);
+
 /**
  * This function create a pointer to struct memo_data.
  *
@@ -246,6 +365,47 @@ struct memo_data* memo_get_data(int id);
  */
 void memo_free_data(struct memo_data *md);
 
+/**
+ *  This function gets the memos of several ids, e.g. the visible rows of a page of
+ *  memo_get_indexes, with one query instead of a memo_get_data per id.
+ *
+ * @brief       Get the records of several ids
+ *
+ * @param       [in]    ids    ids of the memos
+ * @param       [in]    n      number of ids
+ *
+ * @return     An array of n memo_data, entry i is the memo of ids[i] or has id 0 if it does
+ *             not exist or is deleted. NULL on failure.
+ *
+ * @remarks  The array and its strings are a single allocation, free it with memo_free_data_many()
+ *           and not the entries with memo_free_data().
+ *
+ * @exception   None
+ *
+ * @see memo_get_data
+ *
+ * \par Sample code:
+ * \code
+ * ...
+ * int ids[20];
+ * int n = memo_get_indexes(ids, 20, MEMO_SORT_CREATE_TIME);
+ * memo_data_t *mds = memo_get_data_many(ids, n);
+ * for (i = 0; mds && i < n; i++) {
+ *     if (mds[i].id != 0) {
+ *         ...
+ *     }
+ * }
+ * memo_free_data_many(mds);
+ * ...
+ * \endcode
+ */
+memo_data_t *memo_get_data_many(const int *ids, int n);
+
+/**
+ * @brief      Free the array of memo_get_data_many
+ */
+void memo_free_data_many(memo_data_t *mds);
+
 /**
  * This function add the data: struct memo_data.
  * This function is usually called together with memo_create_data();
@@ -312,6 +472,45 @@ int memo_add_data(struct memo_data *md);
  */
 int memo_mod_data(struct memo_data *md);
 
+/**
+ * @def MEMO_ERROR_CONFLICT
+ * Return value of memo_mod_data_if_unchanged when another writer changed the memo first
+ */
+#define MEMO_ERROR_CONFLICT -2
+
+/**
+ *  This function updates a memo like memo_mod_data, but only if nobody changed it since
+ *  its stamp was read, so the app and a sync agent can edit the same memo without a lock
+ *  of their own. The check and the update are atomic.
+ *
+ * @brief      Update a data to DB if it is unchanged
+ *
+ * @param     [in] md          a pointer to struct memo_data*
+ * @param     [in] modi_utime  the stamp the edit is based on, of memo_get_modified_utime or memo_probe
+ *
+ * @return      Return 0 (Success), MEMO_ERROR_CONFLICT (changed since modi_utime, nothing written)
+ *              or -1 (Failed, also when the memo does not exist or is deleted)
+ *
+ * @remarks     The stamp is unique per change, unlike modi_time which is in seconds.
+ *
+ * @exception   None
+ *
+ * @see memo_mod_data memo_probe
+ *
+ * \par Sample code:
+ * \code
+ * ...
+ * int64_t stamp = memo_get_modified_utime(id);
+ * md = memo_get_data(id);
+ * ... edit md ...
+ * if (memo_mod_data_if_unchanged(md, stamp) == MEMO_ERROR_CONFLICT) {
+ *     ... reload and merge ...
+ * }
+ * ...
+ * \endcode
+ */
+int memo_mod_data_if_unchanged(struct memo_data *md, int64_t modi_utime);
+
 /**
  *  This function delete the data assosiated with id.
  *
@@ -319,9 +518,10 @@ int memo_mod_data(struct memo_data *md);
  *
  * @param     [in]    id        the id of the memo record
  *
- * @return      Return 0 (Success) or -1 (Failed)
+ * @return      Return 0 (Success) or -1 (Failed, also when the memo does not exist or is already deleted)
  *
- * @remarks     None
+ * @remarks     The doodle file of the memo (doodle_path) is removed in background
+ *              after the delete is committed, unless another memo refers to it.
  *
  * @exception   None
  *
@@ -340,6 +540,66 @@ int memo_mod_data(struct memo_data *md);
  */
 int memo_del_data(int id);
 
+/**
+ *  This function deletes the data of several ids in one transaction,
+ *  change subscribers are notified once.
+ *
+ * @brief      Delete several data from DB
+ *
+ * @param     [in]    ids      the ids of the memo records
+ * @param     [in]    count    the number of ids
+ *
+ * @return      Return the number of deleted memos (Success) or -1 (Failed)
+ *
+ * @remarks     Ids which do not exist or are already deleted are skipped.
+ *              Doodle files referred by doodle_path are removed in background
+ *              after the delete is committed, unless another memo refers to them.
+ *
+ * @exception   None
+ *
+ * @see memo_del_data memo_doodle_flush
+ *
+ * \par Sample code:
+ * \code
+ * ...
+ * int ids[] = { 3, 5, 8 };
+ * if (memo_del_data_many(ids, 3) == -1) {
+ *     return false;
+ * }
+ * ...
+ * \endcode
+ */
+int memo_del_data_many(const int *ids, int count);
+
+/**
+ *  This function removes the files of a doodle directory which no memo refers to,
+ *  e.g. files left by a crash or by memos changed to another doodle.
+ *
+ * @brief      Remove orphan doodle files
+ *
+ * @param     [in]    dir    the doodle directory, absolute path
+ *
+ * @return      Return the number of files queued for removal (Success) or -1 (Failed)
+ *
+ * @remarks     Files modified in the last minute are kept, the memo may not be saved yet.
+ *              Files named <id>.png of an existing memo are kept as well.
+ *              Files are matched by device and inode, doodle_path may name them
+ *              through a symbolic link or any other spelling of the path.
+ *              The files are removed in background, see memo_doodle_flush.
+ *
+ * @exception   None
+ *
+ * @see memo_doodle_flush
+ */
+int memo_doodle_reap_orphans(const char *dir);
+
+/**
+ * @brief      Wait until doodle files queued by deletes are removed
+ *
+ * @remarks    memo_fini waits for them as well.
+ */
+void memo_doodle_flush(void);
+
 /**
  *  This function gets the data list of the memo assosiated.
  *
@@ -637,6 +897,914 @@ int memo_search_data(const char *search_str, int limit, int offset, MEMO_SORT_TY
 
 int memo_all_data(memo_data_iterate_cb_t cb, void *user_data);
 
+/**
+ * @brief Return values of memo_data_iterate_ex_cb_t
+ */
+enum {
+    MEMO_ITERATE_CONTINUE = 0, /**< call again with the next memo */
+    MEMO_ITERATE_STOP = 1, /**< no more memos, the query is not run any further */
+};
+
+/**
+ * @brief      Iterate callback which can end the iteration, md is valid during the call only
+ *
+ * @return     MEMO_ITERATE_CONTINUE or MEMO_ITERATE_STOP
+ */
+typedef int (*memo_data_iterate_ex_cb_t) (memo_data_t *md, void *user_data);
+
+/**
+ * @struct memo_cursor
+ * @brief Position in the memo list of memo_all_data_ex, zeroed for the start of the list
+ */
+typedef struct memo_cursor {
+    int64_t create_utime; /**< create stamp of the last memo handed out */
+    int id; /**< id of the last memo handed out, 0 for the start of the list */
+} memo_cursor_t;
+
+/**
+ *  This function calls cb for the memos, newest first, until limit memos were handed out,
+ *  cb returns MEMO_ITERATE_STOP or there is no more memo. The query stops with it.
+ *
+ * @brief      Iterate over memos with early termination
+ *
+ * @param     [in] limit     maximum number of memos, -1 for no limit
+ * @param     [in] offset    number of memos to skip (after cursor)
+ * @param     [in/out] cursor  NULL, or where to resume; it is moved to the last memo handed out
+ * @param     [in] cb        callback
+ * @param     [in] user_data passed to cb
+ *
+ * @return     number of memos handed out or -1 (Failed)
+ *
+ * @remarks    A cursor keeps its place when memos are added or deleted between the calls,
+ *             unlike an offset.
+ *
+ * @exception   None
+ *
+ * \par Sample code:
+ * \code
+ * ...
+ * memo_cursor_t cursor = { 0, 0 };
+ * while (memo_all_data_ex(50, 0, &cursor, _page_cb, NULL) == 50) {
+ *     ...
+ * }
+ * ...
+ * \endcode
+ */
+int memo_all_data_ex(int limit, int offset, memo_cursor_t *cursor, memo_data_iterate_ex_cb_t cb, void *user_data);
+
+/**
+ * @brief      memo_search_data with a callback which can end the search
+ *
+ * @return     number of memos handed out or -1 (Failed)
+ */
+int memo_search_data_ex(const char *search_str, int limit, int offset, MEMO_SORT_TYPE sort,
+    memo_data_iterate_ex_cb_t cb, void *user_data);
+
+/**
+ *  This function enables transparent compression of content and comment.
+ *
+ *
+ * @brief      Set compression threshold
+ *
+ * @param     [in]    threshold    content or comment of at least threshold bytes is stored compressed,
+ *                                 0 disables compression (default)
+ *
+ * @return     Return 0 (Success) or -1 (Failed)
+ *
+ * @remarks    Only new writes are affected, memos already stored are read in either form.
+ *             Compressed data is decompressed only when the column is read.
+ *
+ * @exception   None
+ *
+ * \par Sample code:
+ * \code
+ * ...
+ * memo_init(NULL);
+ * memo_set_compression(256);
+ * ...
+ * \endcode
+ */
+int memo_set_compression(int threshold);
+
+/**
+ * @brief Open mode of memo content stream
+ */
+enum {
+   MEMO_CONTENT_READ, /**< read the whole body */
+   MEMO_CONTENT_WRITE, /**< replace the whole body */
+};
+
+typedef struct memo_content_stream memo_content_stream_t;
+
+/**
+ *  This function opens the content of a memo for streamed reading or writing.
+ *  Content longer than the preview kept in list and search results is only fully available
+ *  through memo_get_data() or a content stream.
+ *
+ *
+ * @brief      Open content stream
+ *
+ * @param     [in]    id      the id of the memo record
+ *
+ * @param     [in]    mode    MEMO_CONTENT_READ or MEMO_CONTENT_WRITE
+ *
+ * @return     This function returns a stream on success or NULL on failure.
+ *
+ * @remarks    A write stream stages the content on a connection of its own and replaces the stored
+ *             one in a single transaction in memo_content_close(). Other writes go on meanwhile;
+ *             memo_content_close() fails if the memo was deleted before it.
+ *
+ * @exception   None
+ *
+ * @see memo_content_read memo_content_write memo_content_close
+ *
+ * \par Sample code:
+ * \code
+ * ...
+ * char buf[4096];
+ * int n;
+ * memo_content_stream_t *s = memo_content_open(id, MEMO_CONTENT_READ);
+ * while ((n = memo_content_read(s, buf, sizeof(buf))) > 0) {
+ *     ...
+ * }
+ * memo_content_close(s);
+ * ...
+ * \endcode
+ */
+memo_content_stream_t *memo_content_open(int id, int mode);
+
+/**
+ * @brief      Read from content stream
+ *
+ * @return     Number of bytes read, 0 at the end of content or -1 on failure
+ */
+int memo_content_read(memo_content_stream_t *s, char *buf, int len);
+
+/**
+ * @brief      Append to content stream
+ *
+ * @return     Return 0 (Success) or -1 (Failed)
+ */
+int memo_content_write(memo_content_stream_t *s, const char *buf, int len);
+
+/**
+ * @brief      Close content stream, a write stream is committed here
+ *
+ * @return     Return 0 (Success) or -1 (Failed)
+ */
+int memo_content_close(memo_content_stream_t *s);
+
+/**
+ * @brief Flags of memo_snapshot_record
+ */
+enum {
+   MEMO_SNAPSHOT_FAVORITE = 0x1, /**< favorite memo */
+   MEMO_SNAPSHOT_DOODLE = 0x2, /**< memo has doodle */
+};
+
+/**
+ * @struct memo_snapshot_record
+ * @brief Fixed size record of a memo in the snapshot file
+ */
+struct memo_snapshot_record {
+    int32_t id; /**< index of memo record */
+    uint32_t flags; /**< MEMO_SNAPSHOT_FAVORITE, MEMO_SNAPSHOT_DOODLE */
+    uint32_t color; /**< background color */
+    uint32_t preview_offset; /**< offset of the preview in the string pool */
+    uint32_t preview_len; /**< length of the preview in bytes */
+    uint32_t reserved;
+    int64_t create_time; /**< create time stamp */
+    int64_t modi_time; /**< modify time stamp */
+};
+
+typedef struct memo_snapshot memo_snapshot_t;
+
+/**
+ *  This function makes the library publish a read-only snapshot of all memos after
+ *  changes are committed (see memo_end_trans).
+ *
+ *
+ * @brief      Enable snapshot publishing
+ *
+ * @param     [in]    path    snapshot file, NULL for the default path next to the db change marker
+ *
+ * @return     Return 0 (Success) or -1 (Failed)
+ *
+ * @remarks    Must be called after memo_init() by the process which writes memos.
+ *             The snapshot is written at once, then rebuilt by a background thread
+ *             200 ms after a commit, once for all the commits of that moment, and by memo_fini().
+ *
+ * @exception   None
+ *
+ * @see memo_snapshot_open
+ */
+int memo_snapshot_enable(const char *path);
+
+/**
+ *  This function maps a snapshot published by memo_snapshot_enable().
+ *  memo_init() is not needed, the snapshot is read without opening the db.
+ *
+ *
+ * @brief      Open snapshot
+ *
+ * @param     [in]    path    snapshot file, NULL for the default path
+ *
+ * @return     This function returns a snapshot on success or NULL on failure.
+ *
+ * @remarks    Records and previews point into the mapping and are valid until memo_snapshot_close().
+ *             The mapped file is never modified, call memo_snapshot_is_stale() to know
+ *             when a newer snapshot should be opened.
+ *
+ * @exception   None
+ *
+ * @see memo_snapshot_close
+ *
+ * \par Sample code:
+ * \code
+ * ...
+ * int i;
+ * const struct memo_snapshot_record *r;
+ * memo_snapshot_t *s = memo_snapshot_open(NULL);
+ * for (i = 0; i < memo_snapshot_count(s); i++) {
+ *     r = memo_snapshot_record(s, i);
+ *     printf("%d %s", r->id, memo_snapshot_preview(s, r));
+ * }
+ * memo_snapshot_close(s);
+ * ...
+ * \endcode
+ */
+memo_snapshot_t *memo_snapshot_open(const char *path);
+
+/**
+ * @brief      Unmap snapshot
+ */
+void memo_snapshot_close(memo_snapshot_t *s);
+
+/**
+ * @brief      Number of records in snapshot, ordered by create time descend
+ */
+int memo_snapshot_count(memo_snapshot_t *s);
+
+/**
+ * @brief      Sequence number of snapshot, the last modification stamp (modi_utime) of the db it shows
+ */
+unsigned long long memo_snapshot_seq(memo_snapshot_t *s);
+
+/**
+ * @brief      Record at index, or NULL if index is out of range
+ */
+const struct memo_snapshot_record *memo_snapshot_record(memo_snapshot_t *s, int index);
+
+/**
+ * @brief      Nul terminated preview (title) of record
+ */
+const char *memo_snapshot_preview(memo_snapshot_t *s, const struct memo_snapshot_record *r);
+
+/**
+ * @brief      Check whether a newer snapshot has been published
+ *
+ * @return     1 if stale, 0 if up to date
+ */
+int memo_snapshot_is_stale(memo_snapshot_t *s);
+
+/**
+ * @brief Operations measured by memo_get_stats
+ */
+typedef enum {
+    MEMO_STAT_INSERT, /**< memo_add_data */
+    MEMO_STAT_UPDATE, /**< memo_mod_data */
+    MEMO_STAT_DELETE, /**< memo_del_data */
+    MEMO_STAT_GET, /**< memo_get_data, memo_get_modified_time */
+    MEMO_STAT_LIST, /**< memo_get_all_data_list, memo_all_data, memo_get_indexes, memo_get_operation_list */
+    MEMO_STAT_SEARCH, /**< memo_search_data */
+    MEMO_STAT_COUNT, /**< memo_get_count */
+    MEMO_STAT_OPS,
+} MEMO_STAT_OP;
+
+/**
+ * @def MEMO_STAT_HIST_BUCKETS
+ * Number of latency histogram buckets, bucket 0 counts calls under 1 usec,
+ * bucket i counts calls in [2^(i-1), 2^i) usec and the last bucket counts all slower calls.
+ */
+#define MEMO_STAT_HIST_BUCKETS 20
+
+/**
+ * @struct memo_op_stats
+ * @brief Statistics of an operation
+ */
+struct memo_op_stats {
+    unsigned long long calls; /**< number of calls */
+    unsigned long long errors; /**< number of failed calls */
+    unsigned long long total_usec; /**< total latency */
+    unsigned long long max_usec; /**< worst latency */
+    unsigned long long rows; /**< rows returned */
+    unsigned long long bytes; /**< bytes of content and comment returned */
+    unsigned long long hist[MEMO_STAT_HIST_BUCKETS]; /**< latency histogram */
+};
+
+/**
+ * @struct memo_stats
+ * @brief Statistics of the library
+ */
+struct memo_stats {
+    struct memo_op_stats op[MEMO_STAT_OPS]; /**< per operation, indexed by MEMO_STAT_OP */
+    unsigned long long transactions; /**< committed changes (outermost memo_end_trans) */
+    unsigned long long notifications; /**< change notifications sent */
+    unsigned long long busy_waits; /**< times the db was found locked by another connection */
+    unsigned long long busy_retries; /**< retries after a backoff sleep */
+    unsigned long long busy_usec; /**< time slept waiting for locks */
+    unsigned long long busy_timeouts; /**< lock waits given up, the call failed */
+    int cache_hit; /**< sqlite page cache hits */
+    int cache_miss; /**< sqlite page cache misses */
+    int cache_used; /**< bytes of sqlite page cache */
+};
+
+/**
+ *  This function turns collection of statistics on or off, it is off by default.
+ *
+ *
+ * @brief      Enable statistics
+ *
+ * @param     [in]    enable    true to collect statistics
+ *
+ * @return     Return 0 (Success) or -1 (Failed)
+ *
+ * @remarks    While disabled, the cost in each call is a single branch.
+ *
+ * @exception   None
+ *
+ * @see memo_get_stats
+ */
+int memo_stats_enable(bool enable);
+
+/**
+ *  This function copies the statistics collected since memo_stats_enable or memo_reset_stats.
+ *
+ *
+ * @brief      Get statistics
+ *
+ * @param     [out]    stats    statistics
+ *
+ * @return     Return 0 (Success) or -1 (Failed)
+ *
+ * @remarks    None
+ *
+ * @exception   None
+ *
+ * \par Sample code:
+ * \code
+ * ...
+ * struct memo_stats st;
+ * memo_stats_enable(true);
+ * ...
+ * memo_get_stats(&st);
+ * printf("%llu inserts", st.op[MEMO_STAT_INSERT].calls);
+ * ...
+ * \endcode
+ */
+int memo_get_stats(struct memo_stats *stats);
+
+/**
+ * @brief      Clear statistics
+ */
+void memo_reset_stats(void);
+
+/**
+ * @brief      Log statistics through dlog every seconds, 0 disables the dump (default)
+ *
+ * @return     Return 0 (Success) or -1 (Failed)
+ *
+ * @remarks    The dump is opportunistic, it is written by the first measured call after
+ *             the interval, so an idle process logs nothing.
+ */
+int memo_stats_set_dump_interval(int seconds);
+
+/**
+ *  This function sets how long a call waits for the db locked by another process
+ *  (memo app, widget, sync daemon) before it fails. Default is 3000 ms.
+ *
+ * @brief      Set the busy timeout
+ *
+ * @param     [in]    timeout_ms    msec, 0 to fail at once
+ *
+ * @return     Return 0 (Success) or -1 (Failed)
+ *
+ * @remarks    The waits are counted in busy_waits, busy_usec and busy_timeouts of memo_stats.
+ *
+ * @exception   None
+ *
+ * @see memo_set_busy_backoff
+ */
+int memo_set_busy_timeout(int timeout_ms);
+
+/**
+ *  This function sets the sleeps between the retries of a locked db. The first retry
+ *  comes after min_delay_ms, each next one after twice as long, up to max_delay_ms.
+ *  Defaults are 1 and 64 ms.
+ *
+ * @brief      Set the busy backoff
+ *
+ * @param     [in]    min_delay_ms    first delay, at least 1
+ * @param     [in]    max_delay_ms    longest delay
+ *
+ * @return     Return 0 (Success) or -1 (Failed)
+ *
+ * @remarks    The delays are shortened by up to a half at random.
+ *
+ * @exception   None
+ *
+ * @see memo_set_busy_timeout
+ */
+int memo_set_busy_backoff(int min_delay_ms, int max_delay_ms);
+
+/**
+ * Size of the thumbnails returned by memo_get_thumbnail
+ */
+#define MEMO_THUMB_WIDTH    96
+#define MEMO_THUMB_HEIGHT   96
+
+/**
+ *  This function gets the thumbnail of a doodle memo, so list views do not need to
+ *  decode the image of doodle_path.
+ *
+ * @brief      Get the doodle thumbnail
+ *
+ * @param     [in]     id     the id of the memo record
+ * @param     [out]    buf    MEMO_THUMB_WIDTH x MEMO_THUMB_HEIGHT RGBA pixels, rows without padding
+ * @param     [out]    len    the length of buf in bytes
+ *
+ * @return     Return 0 (Success) or -1 (Failed)
+ *
+ * @remarks    Thumbnails are built when a memo with doodle_path is added or modified.
+ *             If the doodle file was written after the memo, the thumbnail is built by
+ *             the first call. The doodle is scaled to fit and centered on transparent
+ *             pixels. buf should be released with memo_free_thumbnail.
+ *
+ * @exception   None
+ *
+ * \par Sample code:
+ * \code
+ * ...
+ * unsigned char *pixels;
+ * int len;
+ * if (memo_get_thumbnail(id, &pixels, &len) == 0) {
+ *     draw_rgba(pixels, MEMO_THUMB_WIDTH, MEMO_THUMB_HEIGHT);
+ *     memo_free_thumbnail(pixels);
+ * }
+ * ...
+ * \endcode
+ */
+int memo_get_thumbnail(int id, unsigned char **buf, int *len);
+
+/**
+ * @brief      Release a thumbnail returned by memo_get_thumbnail
+ */
+void memo_free_thumbnail(unsigned char *buf);
+
+/**
+ * @brief Export formats of memo_export
+ */
+typedef enum {
+    MEMO_EXPORT_JSON_LINES = 0, /**< one JSON object per memo and line */
+    MEMO_EXPORT_BINARY = 1,     /**< compact little endian records */
+    MEMO_EXPORT_DOODLES = 0x100, /**< flag, include the doodle files */
+} MEMO_EXPORT_FORMAT;
+
+/**
+ *  This function writes all memos to fd without building the list in memory.
+ *
+ * @brief      Export memos
+ *
+ * @param     [in]    fd        file descriptor to write to
+ * @param     [in]    format    MEMO_EXPORT_JSON_LINES or MEMO_EXPORT_BINARY,
+ *                              optionally OR'ed with MEMO_EXPORT_DOODLES
+ *
+ * @return     Return 0 (Success) or -1 (Failed)
+ *
+ * @remarks    The memos are read from a consistent snapshot, writers in other
+ *             processes wait until the export is done. Memory use does not depend
+ *             on the number of memos. See memo_export_set_threads and memo_backup.
+ *
+ * @exception   None
+ *
+ * \par Sample code:
+ * \code
+ * ...
+ * int fd = open("/opt/usr/media/memo.jsonl", O_WRONLY | O_CREAT | O_TRUNC, 0644);
+ * memo_export(fd, MEMO_EXPORT_JSON_LINES | MEMO_EXPORT_DOODLES);
+ * close(fd);
+ * ...
+ * \endcode
+ */
+int memo_export(int fd, int format);
+
+/**
+ * @brief      Number of threads memo_export splits the id range across, 1 (default) to 8
+ *
+ * @return     Return 0 (Success) or -1 (Failed)
+ */
+int memo_export_set_threads(int threads);
+
+/**
+ *  This function copies the memo db to another file with the SQLite online backup API.
+ *
+ * @brief      Hot backup of the memo db
+ *
+ * @param     [in]    dest    path of the copy
+ *
+ * @return     Return 0 (Success) or -1 (Failed)
+ *
+ * @remarks    The db is copied a few pages at a time, writers are not blocked for
+ *             the whole copy. dest is replaced only when the copy is complete.
+ *             It fails when the db stays locked longer than the busy timeout,
+ *             see memo_set_busy_timeout.
+ *
+ * @exception   None
+ */
+int memo_backup(const char *dest);
+
+/**
+ * @brief What memo_import does with a memo whose id is already used by a memo
+ */
+typedef enum {
+    MEMO_IMPORT_SKIP = 0,       /**< keep the existing memo */
+    MEMO_IMPORT_REPLACE,        /**< overwrite the existing memo */
+    MEMO_IMPORT_KEEP_NEWER,     /**< overwrite it if the imported one was modified later */
+    MEMO_IMPORT_ADD_NEW,        /**< add the imported one with a new id */
+} MEMO_IMPORT_POLICY;
+
+/**
+ * @brief Progress of memo_import
+ */
+struct memo_import_progress {
+    int processed;          /**< memos read from the archive */
+    int inserted;           /**< memos added */
+    int replaced;           /**< existing memos overwritten */
+    int skipped;            /**< duplicates and conflicts left alone */
+    int failed;             /**< unreadable records */
+    long long bytes_read;   /**< bytes read from the archive */
+    long long bytes_total;  /**< size of the archive, -1 if unknown (e.g. a pipe) */
+};
+
+typedef void (*memo_import_progress_cb)(const struct memo_import_progress *progress, void *user_data);
+
+/**
+ *  This function reads an archive written by memo_export and adds its memos.
+ *
+ * @brief      Import memos
+ *
+ * @param     [in]    fd        file descriptor to read from, either format of memo_export
+ * @param     [in]    policy    what to do when the id of a memo is already used
+ * @param     [in]    cb        called after every batch of memos and at the end, may be NULL
+ * @param     [in]    user_data passed to cb
+ *
+ * @return     the number of added and overwritten memos or -1 (Failed)
+ *
+ * @remarks    Memos already in the db (same content, comment and doodle) are skipped
+ *             whatever the policy.
+ *             Ids of the archive are kept when they were never used in this db.
+ *             Memos are written in batches of 1000, a failure keeps the batches
+ *             already written. The change callback is called once at the end.
+ *             Doodle files of the archive are written only when a directory is set
+ *             with memo_import_set_doodle_dir.
+ *
+ * @exception   None
+ *
+ * \par Sample code:
+ * \code
+ * ...
+ * int fd = open("/opt/usr/media/memo.jsonl", O_RDONLY);
+ * memo_import(fd, MEMO_IMPORT_KEEP_NEWER, NULL, NULL);
+ * close(fd);
+ * ...
+ * \endcode
+ */
+int memo_import(int fd, MEMO_IMPORT_POLICY policy, memo_import_progress_cb cb, void *user_data);
+
+/**
+ * @brief      Directory memo_import writes doodle files to, NULL to drop them (default)
+ *
+ * @return     Return 0 (Success) or -1 (Failed)
+ */
+int memo_import_set_doodle_dir(const char *dir);
+
+/**
+ *  This function adds md unless a memo with the same content, comment and doodle_path exists.
+ *
+ * @brief      Insert a data to DB if it is not there yet
+ *
+ * @param     [in]  md   a pointer to  struct memo_data*
+ *
+ * @return      Return id of the new memo, 0 if the memo exists (md->id is set to it) or -1 (Failed)
+ *
+ * @remarks     The memos are compared with a 64 bit hash kept in the db, so the check is
+ *              an index lookup. The check and the insert are atomic, also across processes.
+ *
+ * @exception   None
+ *
+ * @see memo_add_data
+ */
+int memo_add_data_if_absent(struct memo_data *md);
+
+/**
+ * @brief      Get the ids of the memos with the same content, comment and doodle_path as memo id
+ *
+ * @param     [out] ids   the ids, lowest first, memo id itself is not included
+ * @param     [in]  len   size of ids
+ *
+ * @return      Return the number of ids (Success) or -1 (Failed)
+ */
+int memo_get_duplicates(int id, int *ids, int len);
+
+typedef void (*memo_duplicate_cb_t) (int id, int original, void *user_data);
+
+/**
+ *  This function finds every memo identical to an older one.
+ *
+ * @brief      Sweep the db for duplicates
+ *
+ * @param     [in]  cb         called with the duplicate and the lowest id of its group
+ * @param     [in]  user_data  passed to cb
+ *
+ * @return      Return the number of duplicates (Success) or -1 (Failed)
+ *
+ * @remarks     cb may delete memos.
+ *
+ * @exception   None
+ *
+ * \par Sample code:
+ * \code
+ * static void _dup(int id, int original, void *user_data)
+ * {
+ *     memo_del_data(id);
+ * }
+ * ...
+ * memo_foreach_duplicate(_dup, NULL);
+ * ...
+ * \endcode
+ */
+int memo_foreach_duplicate(memo_duplicate_cb_t cb, void *user_data);
+
+/**
+ *  This function gets the modify time stamp of a memo in microseconds.
+ *
+ * @brief      Get the microsecond modify time of a record
+ *
+ * @param     [in] id   memo id, or 0 for the latest stamp of the db
+ *
+ * @return     the stamp, 0 for an empty db or -1 (Failed)
+ *
+ * @remarks    Every add, update and delete gets a stamp greater than any before it
+ *             in the same db, also within one second or when the clock steps back.
+ *             Memos written by older versions have whole second stamps (seconds * 1000000),
+ *             so all stamps compare correctly.
+ *
+ * @exception   None
+ *
+ * @see memo_get_operation_list_since
+ */
+int64_t memo_get_modified_utime(int id);
+
+/**
+ * @struct memo_probe
+ * @brief State of a memo returned by memo_probe_many
+ */
+struct memo_probe {
+    int id; /**< memo id */
+    bool exists; /**< the memo exists and is not deleted */
+    bool deleted; /**< the memo is deleted, its id is not reused */
+    int64_t modi_utime; /**< stamp of the last change (the delete for a deleted memo), see memo_get_modified_utime */
+};
+
+/**
+ *  This function tells whether a memo exists and how recent it is, without reading it,
+ *  e.g. to check whether a cached copy is still valid.
+ *
+ * @brief      Probe a memo
+ *
+ * @param     [in]  id          memo id
+ * @param     [out] exists      NULL, or true if the memo exists and is not deleted
+ * @param     [out] modi_utime  NULL, or the stamp of its last change, 0 if there is no such memo
+ * @param     [out] deleted     NULL, or true if the memo is deleted
+ *
+ * @return     0 (Success) or -1 (Failed), a missing memo is not a failure
+ *
+ * @remarks    The statement is prepared once per connection.
+ *
+ * @exception   None
+ *
+ * @see memo_probe_many
+ */
+int memo_probe(int id, bool *exists, int64_t *modi_utime, bool *deleted);
+
+/**
+ *  This function probes n memos in one read transaction, e.g. the rows of a list page.
+ *
+ * @brief      Probe several memos
+ *
+ * @param     [in]  ids     memo ids
+ * @param     [in]  n       number of ids
+ * @param     [out] probes  n entries, entry i is filled for ids[i]
+ *
+ * @return     0 (Success) or -1 (Failed)
+ *
+ * @exception   None
+ *
+ * \par Sample code:
+ * \code
+ * ...
+ * struct memo_probe p[20];
+ * memo_probe_many(ids, n, p);
+ * for (i = 0; i < n; i++) {
+ *     if (!p[i].exists || p[i].modi_utime != cache[i].modi_utime) {
+ *         ... reload ...
+ *     }
+ * }
+ * ...
+ * \endcode
+ */
+int memo_probe_many(const int *ids, int n, struct memo_probe *probes);
+
+/**
+ *  This function gets the memos added, updated or deleted after a microsecond stamp.
+ *
+ * @brief      Get operation list since a stamp of memo_get_modified_utime
+ *
+ * @param     [in] ustamp   modify stamp in microseconds
+ *
+ * @return     operation list or NULL, free it with memo_free_operation_list
+ *
+ * @remarks    Keep memo_get_modified_utime(0) before reading the changes and pass it the
+ *             next time, so no change is missed or reported twice.
+ *
+ * @exception   None
+ *
+ * \par Sample code:
+ * \code
+ * ...
+ * int64_t next = memo_get_modified_utime(0);
+ * struct memo_operation_list *l = memo_get_operation_list_since(last);
+ * ...
+ * memo_free_operation_list(l);
+ * last = next;
+ * ...
+ * \endcode
+ */
+struct memo_operation_list *memo_get_operation_list_since(int64_t ustamp);
+
+/**
+ *  This function calls cb for a page of the memos matching filter.
+ *
+ * @brief      Filtered and sorted memo list
+ *
+ * @param     [in] limit     the number of memos, -1 for all
+ * @param     [in] offset    the number of memos to skip
+ * @param     [in] sort      sort type
+ * @param     [in] filter    filter, NULL for all memos
+ * @param     [in] cb        called for each memo, md is valid during the call only
+ * @param     [in] user_data passed to cb
+ *
+ * @return     Return 0 (Success) or -1 (Failed)
+ *
+ * @remarks    Favorites and doodles sorted by create time, a color sorted by create time
+ *             and any filter sorted by modify time are read from an index, so a page
+ *             costs the same whatever the number of memos.
+ *
+ * @exception   None
+ *
+ * \par Sample code:
+ * \code
+ * ...
+ * struct memo_filter filter = { MEMO_FILTER_FAVORITE, 0, 0 };
+ * memo_all_data_filtered(20, 0, MEMO_SORT_CREATE_TIME, &filter, _favorite_cb, NULL);
+ * memo_all_data_filtered(20, 0, MEMO_SORT_MODI_TIME, NULL, _recent_cb, NULL);
+ * ...
+ * \endcode
+ */
+int memo_all_data_filtered(int limit, int offset, MEMO_SORT_TYPE sort, const struct memo_filter *filter,
+    memo_data_iterate_cb_t cb, void *user_data);
+
+/**
+ * @brief      memo_search_data restricted to the memos matching filter
+ */
+int memo_search_data_filtered(const char *search_str, int limit, int offset, MEMO_SORT_TYPE sort,
+    const struct memo_filter *filter, memo_data_iterate_cb_t cb, void *user_data);
+
+/**
+ * @brief      Ids of the memos matching filter, in sort order
+ *
+ * @return     Return the number of ids (Success) or -1 (Failed)
+ */
+int memo_get_indexes_filtered(int *aIndex, int len, MEMO_SORT_TYPE sort, const struct memo_filter *filter);
+
+/**
+ * @brief      Number of the memos matching filter
+ *
+ * @return     Return 0 (Success) or -1 (Failed)
+ */
+int memo_get_count_filtered(const struct memo_filter *filter, int *count);
+
+typedef struct memo_search_session memo_search_session_t;
+
+/**
+ *  This function opens a search session for a search bar. The session keeps the memos
+ *  matching the last search string, and a search string which contains the last one
+ *  (the user typed one more character) only re-checks those memos.
+ *
+ * @brief      Open search session
+ *
+ * @return     This function returns a session on success or NULL on failure.
+ *
+ * @remarks    Any add, modify or delete, in this process or another, makes the next
+ *             search start over, so the results are always those of memo_search_data.
+ *             Close the session before memo_fini().
+ *
+ * @exception   None
+ *
+ * @see memo_search_session_data memo_search_session_close
+ *
+ * \par Sample code:
+ * \code
+ * ...
+ * memo_search_session_t *s = memo_search_session_open();
+ * memo_search_session_data(s, "a", 20, 0, MEMO_SORT_CREATE_TIME, _result_cb, NULL);
+ * memo_search_session_data(s, "ab", 20, 0, MEMO_SORT_CREATE_TIME, _result_cb, NULL);
+ * memo_search_session_close(s);
+ * ...
+ * \endcode
+ */
+memo_search_session_t *memo_search_session_open(void);
+
+/**
+ * @brief      memo_search_data within a search session
+ *
+ * @return     Return 0 (Success) or -1 (Failed)
+ */
+int memo_search_session_data(memo_search_session_t *s, const char *search_str, int limit, int offset,
+    MEMO_SORT_TYPE sort, memo_data_iterate_cb_t cb, void *user_data);
+
+/**
+ * @brief      Close search session
+ */
+void memo_search_session_close(memo_search_session_t *s);
+
+/**
+ *  This function sets the locale of the title order (MEMO_SORT_TITLE) and rebuilds
+ *  the stored collation keys of every memo when it changes. The locale is recorded in
+ *  the db, memo_init keeps using it whatever the locale of the process.
+ *
+ * @brief      Set title collation locale
+ *
+ * @param     [in] locale    ICU locale id such as "ko_KR", NULL for the default locale
+ *
+ * @return     Return 0 (Success) or -1 (Failed)
+ *
+ * @remarks    Titles sort by their first 64 characters. Call it when the display
+ *             language changes, it is not to be called while other threads use the library.
+ *             Other processes with the db open keep the previous locale until their next memo_init.
+ *             A db without a recorded locale takes the one of the process which first opens it.
+ *
+ * @exception   None
+ *
+ * \par Sample code:
+ * \code
+ * ...
+ * memo_set_collation_locale("ko_KR");
+ * memo_all_data_filtered(20, 0, MEMO_SORT_TITLE_ASC, NULL, _title_cb, NULL);
+ * ...
+ * \endcode
+ */
+int memo_set_collation_locale(const char *locale);
+
+/**
+ *  This function is memo_search_data split over threads, each searching a range of
+ *  the memos on its own read-only connection. The page is merged from the results of
+ *  every range and cb is called on the calling thread.
+ *
+ * @brief      Parallel search
+ *
+ * @param     [in] threads   number of threads, 1 to 8
+ *
+ * @return     Return 0 (Success) or -1 (Failed)
+ *
+ * @remarks    Worth it for large databases (100k memos) on multi-core devices, every
+ *             call opens its connections. Writers wait until the search is done.
+ *             Memos of equal sort value come in id order.
+ *
+ * @exception   None
+ *
+ * @see memo_search_data
+ *
+ * \par Sample code:
+ * \code
+ * ...
+ * memo_search_data_parallel("meeting", 20, 0, MEMO_SORT_CREATE_TIME, 4, _result_cb, NULL);
+ * ...
+ * \endcode
+ */
+int memo_search_data_parallel(const char *search_str, int limit, int offset, MEMO_SORT_TYPE sort,
+    int threads, memo_data_iterate_cb_t cb, void *user_data);
+
 /* Ugh, the following APIs are under testing and provides no guarantee.
   * If you want to use, please contact with canjiang.lu@samsung.com.
   */
@@ -10,6 +10,10 @@ BuildRequires:  pkgconfig(dlog)
 BuildRequires:  pkgconfig(heynoti)
 BuildRequires:  pkgconfig(db-util)
 BuildRequires:  pkgconfig(vconf)
+BuildRequires:  pkgconfig(zlib)
+BuildRequires:  pkgconfig(libpng)
+BuildRequires:  pkgconfig(icu-uc)
+BuildRequires:  pkgconfig(icu-i18n)
 
 BuildRequires:  cmake
 Requires(post): /usr/bin/sqlite3
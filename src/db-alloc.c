@@ -0,0 +1,176 @@
+/*
+*
+* Copyright 2012  Samsung Electronics Co., Ltd
+*
+* Licensed under the Flora License, Version 1.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.tizenopensource.org/license
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+
+/*
+ * Allocator of the library, the libc one unless memo_set_allocator installed hooks.
+ *
+ * SQLite can be routed through the hooks as well. Its allocator needs the size of each
+ * block, which is kept in a header of SQ_HEADER bytes in front of it.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <sqlite3.h>
+
+#include "memo-log.h"
+#include "db-alloc.h"
+
+#define SQ_HEADER 8 /* keeps the 8 byte alignment sqlite expects */
+
+static memo_malloc_fn hook_malloc = NULL;
+static memo_free_fn hook_free = NULL;
+static memo_realloc_fn hook_realloc = NULL;
+static void *hook_ctx = NULL;
+static int sqlite_routed = 0;
+
+void *db_malloc(size_t size)
+{
+    return hook_malloc ? hook_malloc(size, hook_ctx) : malloc(size);
+}
+
+void *db_calloc(size_t nmemb, size_t size)
+{
+    void *p;
+
+    if (hook_malloc == NULL) {
+        return calloc(nmemb, size);
+    }
+    if (size != 0 && nmemb > SIZE_MAX / size) {
+        return NULL;
+    }
+    p = hook_malloc(nmemb * size, hook_ctx);
+    if (p != NULL) {
+        memset(p, 0, nmemb * size);
+    }
+    return p;
+}
+
+void *db_realloc(void *ptr, size_t size)
+{
+    return hook_realloc ? hook_realloc(ptr, size, hook_ctx) : realloc(ptr, size);
+}
+
+void db_free(void *ptr)
+{
+    if (hook_free) {
+        if (ptr != NULL) {
+            hook_free(ptr, hook_ctx);
+        }
+    } else {
+        free(ptr);
+    }
+}
+
+char *db_strdup(const char *s)
+{
+    return db_strndup(s, strlen(s));
+}
+
+char *db_strndup(const char *s, size_t n)
+{
+    char *d;
+
+    n = strnlen(s, n);
+    d = (char *)db_malloc(n + 1);
+    if (d != NULL) {
+        memcpy(d, s, n);
+        d[n] = '\0';
+    }
+    return d;
+}
+
+static void *_sq_malloc(int n)
+{
+    int64_t *p = (int64_t *)db_malloc((size_t)n + SQ_HEADER);
+
+    if (p == NULL) {
+        return NULL;
+    }
+    p[0] = n;
+    return (char *)p + SQ_HEADER;
+}
+
+static void _sq_free(void *p)
+{
+    if (p != NULL) {
+        db_free((char *)p - SQ_HEADER);
+    }
+}
+
+static void *_sq_realloc(void *p, int n)
+{
+    int64_t *q = (int64_t *)db_realloc((char *)p - SQ_HEADER, (size_t)n + SQ_HEADER);
+
+    if (q == NULL) {
+        return NULL;
+    }
+    q[0] = n;
+    return (char *)q + SQ_HEADER;
+}
+
+static int _sq_size(void *p)
+{
+    return p ? (int)*(int64_t *)((char *)p - SQ_HEADER) : 0;
+}
+
+static int _sq_roundup(int n)
+{
+    return (n + 7) & ~7;
+}
+
+static int _sq_init(void *data)
+{
+    return SQLITE_OK;
+}
+
+static void _sq_shutdown(void *data)
+{
+}
+
+static const sqlite3_mem_methods sq_methods = {
+    _sq_malloc, _sq_free, _sq_realloc, _sq_size, _sq_roundup, _sq_init, _sq_shutdown, NULL,
+};
+
+/*
+ * Install the hooks, all three or none for libc. No memory of the previous allocator may be
+ * live. With sqlite, sqlite must not be initialized yet, sqlite3_config fails otherwise.
+ */
+int db_alloc_set(memo_malloc_fn malloc_fn, memo_free_fn free_fn, memo_realloc_fn realloc_fn,
+        void *ctx, bool sqlite)
+{
+    int all = malloc_fn && free_fn && realloc_fn;
+    int rc;
+
+    retvm_if(!all && (malloc_fn || free_fn || realloc_fn), -1, "Give all allocator functions or none");
+    retvm_if(sqlite && !all, -1, "No allocator for sqlite");
+
+    if (sqlite) {
+        rc = sqlite3_config(SQLITE_CONFIG_MALLOC, &sq_methods);
+        retvm_if(rc != SQLITE_OK, -1, "Can't set the allocator of sqlite : %d, it is initialized", rc);
+        sqlite_routed = 1;
+    } else {
+        /* sqlite allocates through db_malloc, it can not switch allocators under it */
+        retvm_if(sqlite_routed, -1, "sqlite uses the hooks");
+    }
+    hook_malloc = malloc_fn;
+    hook_free = free_fn;
+    hook_realloc = realloc_fn;
+    hook_ctx = ctx;
+    return 0;
+}
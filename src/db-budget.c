@@ -0,0 +1,83 @@
+/*
+*
+* Copyright 2012  Samsung Electronics Co., Ltd
+*
+* Licensed under the Flora License, Version 1.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.tizenopensource.org/license
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+
+/*
+ * Memory budget for low RAM devices, see memo_set_memory_budget.
+ *
+ * The heap limits are process wide settings of sqlite. Page cache and lookaside are set
+ * on every connection the library opens, by db_budget_apply right after the open, as
+ * lookaside can not be changed once the connection has used it.
+ */
+
+#include <string.h>
+#include <sqlite3.h>
+
+#include "memo-log.h"
+#include "db-budget.h"
+
+static struct memo_memory_budget budget;
+
+int db_budget_set(const struct memo_memory_budget *b)
+{
+    struct memo_memory_budget none;
+
+    if (b == NULL) {
+        memset(&none, 0, sizeof(none));
+        b = &none;
+    }
+    retvm_if(b->soft_heap_limit < 0 || b->hard_heap_limit < 0 || b->cache_size_kb < 0
+            || b->lookaside_slot_size < 0 || b->lookaside_slots < 0 || b->list_limit < 0,
+            -1, "Invalid memory budget");
+    retvm_if(b->hard_heap_limit > 0 && b->soft_heap_limit > b->hard_heap_limit, -1,
+            "Soft heap limit above the hard one");
+#if SQLITE_VERSION_NUMBER >= 3031000
+    sqlite3_hard_heap_limit64(b->hard_heap_limit);
+#else
+    retvm_if(b->hard_heap_limit > 0, -1, "No hard heap limit in sqlite %s", sqlite3_libversion());
+#endif
+    sqlite3_soft_heap_limit64(b->soft_heap_limit);
+    budget = *b;
+    return 0;
+}
+
+int db_budget_apply(sqlite3 *db)
+{
+    char query[64];
+    int rc = SQLITE_OK;
+
+    retvm_if(db == NULL, -1, "DB handler is null");
+    if (budget.lookaside_slot_size > 0 && budget.lookaside_slots > 0) {
+        /* sqlite allocates the slots, sized down to a multiple of 8 */
+        rc = sqlite3_db_config(db, SQLITE_DBCONFIG_LOOKASIDE, NULL,
+                budget.lookaside_slot_size, budget.lookaside_slots);
+        warn_if(rc != SQLITE_OK, "Can't configure lookaside : %d", rc);
+    }
+    if (budget.cache_size_kb > 0) {
+        /* negative : in KiB instead of pages */
+        snprintf(query, sizeof(query), "PRAGMA cache_size = -%d", budget.cache_size_kb);
+        rc = sqlite3_exec(db, query, NULL, NULL, NULL);
+        retvm_if(rc != SQLITE_OK, -1, "SQL error : %s", sqlite3_errmsg(db));
+    }
+    return 0;
+}
+
+/* whether a list of bytes is past the budget, the caller then gives up on it */
+int db_budget_list_over(size_t bytes)
+{
+    return budget.list_limit > 0 && bytes > (size_t)budget.list_limit;
+}
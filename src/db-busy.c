@@ -0,0 +1,119 @@
+/*
+*
+* Copyright 2012  Samsung Electronics Co., Ltd
+*
+* Licensed under the Flora License, Version 1.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.tizenopensource.org/license
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+
+/*
+ * Waiting for the locks of the other processes of the db (memo app, widget, sync daemon).
+ *
+ * sqlite calls _busy when a lock is held by another connection. It sleeps with an
+ * exponential backoff, from min_delay up to max_delay, and gives up when the delays
+ * add up to the timeout; the statement then fails with SQLITE_BUSY. The sleeps are
+ * jittered, so processes waiting for the same lock do not retry in lockstep.
+ *
+ * The settings are shared by every connection of the process and read at each wait.
+ * sqlite only calls the handler where waiting can not deadlock, which is why the
+ * writers start their transactions with BEGIN IMMEDIATE.
+ */
+
+#include <time.h>
+#include <sqlite3.h>
+
+#include "memo-log.h"
+#include "db-busy.h"
+#include "db-stats.h"
+
+static int busy_timeout = BUSY_TIMEOUT_DEFAULT;
+static int min_delay = BUSY_DELAY_MIN_DEFAULT;
+static int max_delay = BUSY_DELAY_MAX_DEFAULT;
+
+/* msec to sleep before retry count + 1 */
+static int _delay(int count, int lo, int hi)
+{
+    int d = lo;
+
+    while (count-- > 0 && d < hi) {
+        d <<= 1;
+    }
+    return d < hi ? d : hi;
+}
+
+static int _busy(void *data, int count)
+{
+    int timeout = busy_timeout;
+    int lo = min_delay;
+    int hi = max_delay;
+    int waited = 0;
+    int i, d;
+    unsigned long long start, usec;
+    struct timespec ts;
+
+    for (i = 0; i < count && waited < timeout; i++) {
+        waited += _delay(i, lo, hi);
+    }
+    if (waited >= timeout) {
+        ERR("DB is locked, gave up after %d ms", waited);
+        STAT_BUSY(count == 0, 0, 1);
+        return 0;
+    }
+
+    d = _delay(count, lo, hi);
+    if (d > timeout - waited) {
+        d = timeout - waited;
+    }
+    start = db_stats_now();
+    usec = (unsigned long long)d * 500 + start % ((unsigned long long)d * 500 + 1);
+    ts.tv_sec = usec / 1000000;
+    ts.tv_nsec = (usec % 1000000) * 1000;
+    nanosleep(&ts, NULL);
+    STAT_BUSY(count == 0, db_stats_now() - start, 0);
+    return 1;
+}
+
+/**
+ * @brief     Sleep before retry count + 1 of a busy call which sqlite does not retry
+ *            itself (sqlite3_backup_step), with the backoff and timeout of the handler
+ *
+ * @return    1 to retry, 0 when the timeout is used up
+ */
+int db_busy_wait(int count)
+{
+    return _busy(NULL, count);
+}
+
+int db_busy_register(sqlite3 *db)
+{
+    retvm_if(db == NULL, -1, "DB handler is null");
+    retvm_if(sqlite3_busy_handler(db, _busy, NULL) != SQLITE_OK, -1,
+            "SQL error : %s", sqlite3_errmsg(db));
+    return 0;
+}
+
+int db_busy_set_timeout(int timeout_ms)
+{
+    retvm_if(timeout_ms < 0, -1, "Invalid busy timeout : %d", timeout_ms);
+    busy_timeout = timeout_ms;
+    return 0;
+}
+
+int db_busy_set_backoff(int min_delay_ms, int max_delay_ms)
+{
+    retvm_if(min_delay_ms < 1 || max_delay_ms < min_delay_ms, -1,
+            "Invalid backoff : %d - %d ms", min_delay_ms, max_delay_ms);
+    min_delay = min_delay_ms;
+    max_delay = max_delay_ms;
+    return 0;
+}
@@ -0,0 +1,497 @@
+/*
+*
+* Copyright 2012  Samsung Electronics Co., Ltd
+*
+* Licensed under the Flora License, Version 1.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.tizenopensource.org/license
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+
+/*
+ * Large memo storage.
+ *
+ * memo.content keeps the first MEMO_DB_MAX_CONTENT_LEN bytes (cut on an UTF-8 boundary)
+ * so list and search queries stay small. The rest of the body is split into
+ * MEMO_DB_CHUNK_LEN pieces stored in memo_chunk, ordered by seq.
+ *
+ * A write stream has a connection of its own. It stages the chunks in a temp table there
+ * and moves them into memo_chunk in one short transaction on close, so other writers
+ * are not held off while the stream is open.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sqlite3.h>
+
+#include "memo-log.h"
+#include "memo-db.h"
+#include "db-helper.h"
+#include "db-compress.h"
+#include "db-chunk.h"
+#include "db-hash.h"
+#include "db-busy.h"
+#include "db-budget.h"
+#include "db-collate.h"
+#include "db-alloc.h"
+
+#define PEND_CAPACITY (MEMO_DB_CHUNK_LEN + MEMO_DB_MAX_CONTENT_LEN)
+
+#define CREATE_STAGE_TABLE " \
+create temp table memo_stage ( \
+memo_id INTEGER, \
+seq INTEGER, \
+packed INTEGER, \
+data BLOB, \
+PRIMARY KEY (memo_id, seq) \
+)"
+
+struct memo_content_stream {
+    sqlite3 *db; /* with MEMO_CONTENT_WRITE, the own connection of the stream */
+    int id;
+    int mode;
+    int failed;
+
+    /* MEMO_CONTENT_READ */
+    sqlite3_stmt *stmt;
+    char *cur; /* piece being read, head first then each chunk */
+    int cur_len;
+    int cur_pos;
+    int eof;
+
+    /* MEMO_CONTENT_WRITE */
+    char *head; /* preview, written to memo.content on close */
+    char *pend; /* bytes not stored yet */
+    int pend_len;
+    int seq;
+    struct db_hash hash; /* of everything written, for content_hash */
+    uint32_t len;
+};
+
+static int _exec(sqlite3 *db, const char *query)
+{
+    char *errmsg = NULL;
+
+    if (sqlite3_exec(db, query, NULL, 0, &errmsg) != SQLITE_OK) {
+        ERR("SQL error: %s [%s]", errmsg, query);
+        sqlite3_free(errmsg);
+        return -1;
+    }
+    return 0;
+}
+
+/* table is memo_chunk or memo_stage */
+static int _chunk_put(sqlite3 *db, const char *table, int id, int seq, const char *data, int len)
+{
+    int rc;
+    sqlite3_stmt *stmt = NULL;
+    unsigned char *packed = NULL;
+    int plen = 0;
+    int threshold = db_compress_get_threshold();
+    char query[128];
+
+    if (threshold > 0 && len >= threshold) {
+        packed = db_compress_pack(data, len, &plen);
+    }
+
+    snprintf(query, sizeof(query), "insert into %s (memo_id, seq, packed, data) values (?, ?, ?, ?)", table);
+    rc = sqlite3_prepare_v2(db, query, -1, &stmt, NULL);
+    if (rc != SQLITE_OK) {
+        ERR("SQL error : %s", sqlite3_errmsg(db));
+        db_free(packed);
+        return -1;
+    }
+    sqlite3_bind_int(stmt, 1, id);
+    sqlite3_bind_int(stmt, 2, seq);
+    sqlite3_bind_int(stmt, 3, packed != NULL);
+    if (packed != NULL) {
+        sqlite3_bind_blob(stmt, 4, packed, plen, db_free);
+    } else {
+        sqlite3_bind_blob(stmt, 4, data, len, SQLITE_STATIC);
+    }
+
+    rc = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+    retvm_if(rc != SQLITE_DONE, -1, "Can't store chunk %d of memo %d : %s", seq, id, sqlite3_errmsg(db));
+    return 0;
+}
+
+/* returns the plain bytes of the current chunk row, *len receives the length */
+static char *_chunk_get(sqlite3_stmt *stmt, int *len)
+{
+    const void *data = sqlite3_column_blob(stmt, 1);
+    int bytes = sqlite3_column_bytes(stmt, 1);
+    char *p;
+
+    if (sqlite3_column_int(stmt, 0)) {
+        p = db_decompress(data, bytes);
+        retvm_if(p == NULL, NULL, "Corrupt chunk");
+        *len = strlen(p);
+        return p;
+    }
+
+    p = (char *)db_malloc(bytes + 1);
+    retv_if(p == NULL, NULL);
+    if (bytes > 0) {
+        memcpy(p, data, bytes);
+    }
+    p[bytes] = '\0';
+    *len = bytes;
+    return p;
+}
+
+static sqlite3_stmt *_chunk_select(sqlite3 *db, int id)
+{
+    sqlite3_stmt *stmt = NULL;
+
+    if (sqlite3_prepare_v2(db, "select packed, data from memo_chunk where memo_id = ? order by seq",
+                -1, &stmt, NULL) != SQLITE_OK) {
+        ERR("SQL error : %s", sqlite3_errmsg(db));
+        sqlite3_finalize(stmt);
+        return NULL;
+    }
+    sqlite3_bind_int(stmt, 1, id);
+    return stmt;
+}
+
+int db_chunk_clear(sqlite3 *db, int id)
+{
+    char query[128];
+
+    retvm_if(db == NULL, -1, "DB handler is null");
+
+    snprintf(query, sizeof(query), "delete from memo_chunk where memo_id = %d", id);
+    return _exec(db, query);
+}
+
+/**
+ * @brief     Store the tail of a memo body, replacing the chunks stored before
+ *
+ * @remarks   Should be called in the transaction which writes memo.content
+ */
+int db_chunk_store(sqlite3 *db, int id, const char *tail, int len)
+{
+    int seq = 0;
+    int n;
+
+    retv_if(db_chunk_clear(db, id) == -1, -1);
+
+    while (len > 0) {
+        n = len > MEMO_DB_CHUNK_LEN ? MEMO_DB_CHUNK_LEN : len;
+        retv_if(_chunk_put(db, "memo_chunk", id, seq++, tail, n) == -1, -1);
+        tail += n;
+        len -= n;
+    }
+    return 0;
+}
+
+/**
+ * @brief     Append the stored chunks of memo id to head
+ *
+ * @return    the full body (head is reallocated) or NULL on error (head is freed)
+ */
+char *db_chunk_join(sqlite3 *db, int id, char *head)
+{
+    sqlite3_stmt *stmt;
+    char *body = head;
+    char *piece, *t;
+    int len, plen;
+
+    stmt = _chunk_select(db, id);
+    retv_if(stmt == NULL, head);
+
+    len = head ? strlen(head) : 0;
+    while (sqlite3_step(stmt) == SQLITE_ROW) {
+        piece = _chunk_get(stmt, &plen);
+        if (piece == NULL) {
+            break;
+        }
+        t = (char *)db_realloc(body, len + plen + 1);
+        if (t == NULL) {
+            ERR("realloc failed, memo %d is incomplete", id);
+            db_free(piece);
+            db_free(body);
+            sqlite3_finalize(stmt);
+            return NULL;
+        }
+        body = t;
+        memcpy(body + len, piece, plen);
+        len += plen;
+        body[len] = '\0';
+        db_free(piece);
+    }
+    sqlite3_finalize(stmt);
+    return body;
+}
+
+static char *_get_head(sqlite3 *db, int id, int *exist)
+{
+    sqlite3_stmt *stmt = NULL;
+    char *head = NULL;
+    const char *text;
+
+    *exist = 0;
+    if (sqlite3_prepare_v2(db, "select " MEMO_UNPACK_FUNC "(content) from memo where id = ? and delete_time = -1",
+                -1, &stmt, NULL) != SQLITE_OK) {
+        ERR("SQL error : %s", sqlite3_errmsg(db));
+        sqlite3_finalize(stmt);
+        return NULL;
+    }
+    sqlite3_bind_int(stmt, 1, id);
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        *exist = 1;
+        text = (const char *)sqlite3_column_text(stmt, 0);
+        head = db_strdup(text ? text : "");
+    }
+    sqlite3_finalize(stmt);
+    return head;
+}
+
+/* connection of a write stream, with the functions the schema uses */
+static sqlite3 *_open_writer(sqlite3 *main_db)
+{
+    sqlite3 *db = NULL;
+    const char *path = sqlite3_db_filename(main_db, "main");
+
+    retvm_if(path == NULL || path[0] == '\0', NULL, "No file behind the connection");
+    if (sqlite3_open_v2(path, &db, SQLITE_OPEN_READWRITE, NULL) != SQLITE_OK) {
+        ERR("Can't open %s : %s", path, sqlite3_errmsg(db));
+        sqlite3_close(db);
+        return NULL;
+    }
+    if (db_budget_apply(db) == -1 || db_busy_register(db) == -1 || db_compress_register(db) == -1
+            || db_collate_register(db) == -1 || _exec(db, CREATE_STAGE_TABLE) == -1) {
+        sqlite3_close(db);
+        return NULL;
+    }
+    return db;
+}
+
+memo_content_stream_t *db_content_open(sqlite3 *db, int id, int mode)
+{
+    memo_content_stream_t *s;
+    int exist = 0;
+
+    retvm_if(db == NULL, NULL, "DB handler is null");
+    retvm_if(mode != MEMO_CONTENT_READ && mode != MEMO_CONTENT_WRITE, NULL, "Invalid mode %d", mode);
+
+    s = (memo_content_stream_t *)db_calloc(1, sizeof(memo_content_stream_t));
+    retv_if(s == NULL, NULL);
+    s->db = db;
+    s->id = id;
+    s->mode = mode;
+
+    if (mode == MEMO_CONTENT_READ) {
+        s->cur = _get_head(db, id, &exist);
+        if (!exist || s->cur == NULL) {
+            ERR("Memo %d does not exist", id);
+            db_free(s->cur);
+            db_free(s);
+            return NULL;
+        }
+        s->cur_len = strlen(s->cur);
+        s->stmt = _chunk_select(db, id);
+        if (s->stmt == NULL) {
+            db_free(s->cur);
+            db_free(s);
+            return NULL;
+        }
+        return s;
+    }
+
+    s->pend = (char *)db_malloc(PEND_CAPACITY + 1);
+    if (s->pend == NULL) {
+        db_free(s);
+        return NULL;
+    }
+    db_hash_init(&s->hash, 0);
+    db_free(_get_head(db, id, &exist));
+    s->db = exist ? _open_writer(db) : NULL;
+    if (s->db == NULL) {
+        ERR("Can't write memo %d", id);
+        db_free(s->pend);
+        db_free(s);
+        return NULL;
+    }
+    return s;
+}
+
+int db_content_read(memo_content_stream_t *s, char *buf, int len)
+{
+    int total = 0;
+    int n;
+
+    retvm_if(s == NULL || s->mode != MEMO_CONTENT_READ, -1, "Invalid stream");
+    retvm_if(buf == NULL || len < 0, -1, "Invalid buffer");
+
+    while (total < len && !s->eof) {
+        if (s->cur == NULL || s->cur_pos == s->cur_len) {
+            db_free(s->cur);
+            s->cur = NULL;
+            if (sqlite3_step(s->stmt) != SQLITE_ROW) {
+                s->eof = 1; /* end of body, stepping again would restart the statement */
+                break;
+            }
+            s->cur = _chunk_get(s->stmt, &s->cur_len);
+            s->cur_pos = 0;
+            retv_if(s->cur == NULL, -1);
+            continue;
+        }
+        n = s->cur_len - s->cur_pos;
+        if (n > len - total) {
+            n = len - total;
+        }
+        memcpy(buf + total, s->cur + s->cur_pos, n);
+        s->cur_pos += n;
+        total += n;
+    }
+    return total;
+}
+
+static void _pend_consume(memo_content_stream_t *s, int n)
+{
+    memmove(s->pend, s->pend + n, s->pend_len - n);
+    s->pend_len -= n;
+    s->pend[s->pend_len] = '\0';
+}
+
+int db_content_write(memo_content_stream_t *s, const char *buf, int len)
+{
+    int n, cut;
+
+    retvm_if(s == NULL || s->mode != MEMO_CONTENT_WRITE, -1, "Invalid stream");
+    retvm_if(buf == NULL || len < 0, -1, "Invalid buffer");
+    retv_if(s->failed, -1);
+
+    db_hash_update(&s->hash, buf, len);
+    s->len += len;
+
+    while (len > 0) {
+        n = PEND_CAPACITY - s->pend_len;
+        if (n > len) {
+            n = len;
+        }
+        memcpy(s->pend + s->pend_len, buf, n);
+        s->pend_len += n;
+        s->pend[s->pend_len] = '\0';
+        buf += n;
+        len -= n;
+
+        if (s->head == NULL && s->pend_len > MEMO_DB_MAX_CONTENT_LEN) {
+            cut = db_content_preview_len(s->pend);
+            s->head = db_strndup(s->pend, cut);
+            if (s->head == NULL) {
+                s->failed = 1;
+                return -1;
+            }
+            _pend_consume(s, cut);
+        }
+        while (s->head != NULL && s->pend_len >= MEMO_DB_CHUNK_LEN) {
+            if (_chunk_put(s->db, "memo_stage", s->id, s->seq++, s->pend, MEMO_DB_CHUNK_LEN) == -1) {
+                s->failed = 1;
+                return -1;
+            }
+            _pend_consume(s, MEMO_DB_CHUNK_LEN);
+        }
+    }
+    return 0;
+}
+
+/* content_hash of the written content with the stored comment and doodle_path */
+static int _content_hash(memo_content_stream_t *s, int64_t *hash)
+{
+    sqlite3_stmt *stmt = NULL;
+    int rc;
+
+    rc = sqlite3_prepare_v2(s->db, "select " MEMO_UNPACK_FUNC "(comment), doodle_path from memo where id = ?",
+            -1, &stmt, NULL);
+    retvm_if(rc != SQLITE_OK, -1, "SQL error : %s", sqlite3_errmsg(s->db));
+    sqlite3_bind_int(stmt, 1, s->id);
+    rc = sqlite3_step(stmt);
+    if (rc == SQLITE_ROW) {
+        *hash = db_hash_memo_finish(&s->hash, s->len, (const char *)sqlite3_column_text(stmt, 0),
+                (const char *)sqlite3_column_text(stmt, 1));
+    }
+    sqlite3_finalize(stmt);
+    return rc == SQLITE_ROW ? 0 : -1;
+}
+
+/* replace the content by the staged one, in one transaction */
+static int _content_commit(memo_content_stream_t *s)
+{
+    char *query = NULL;
+    char move[192];
+    int64_t hash;
+    int exist = 0;
+    int rc;
+
+    if (s->head == NULL) {
+        s->head = db_strndup(s->pend, s->pend_len);
+        retv_if(s->head == NULL, -1);
+    } else if (s->pend_len > 0) {
+        retv_if(_chunk_put(s->db, "memo_stage", s->id, s->seq++, s->pend, s->pend_len) == -1, -1);
+    }
+    snprintf(move, sizeof(move), "insert into memo_chunk (memo_id, seq, packed, data) "
+            "select memo_id, seq, packed, data from memo_stage where memo_id = %d", s->id);
+
+    memo_begin_trans();
+    rc = _exec(s->db, "BEGIN IMMEDIATE");
+    if (rc == 0) { /* deleted while the stream was open */
+        db_free(_get_head(s->db, s->id, &exist));
+        rc = exist ? 0 : -1;
+        warn_if(!exist, "Memo %d was deleted", s->id);
+    }
+    if (rc == 0) {
+        rc = db_chunk_clear(s->db, s->id);
+    }
+    if (rc == 0) {
+        rc = _exec(s->db, move);
+    }
+    if (rc == 0) {
+        rc = _content_hash(s, &hash);
+    }
+    if (rc == 0) {
+        query = db_make_update_query(s->id, KEY_CONTENT, s->head, KEY_CONTENT_HASH, &hash, KEY_INPUT_END);
+        rc = query == NULL ? -1 : _exec(s->db, query);
+    }
+    if (rc == 0) {
+        rc = db_collate_update_key(s->db, s->id);
+    }
+    if (rc == 0) {
+        rc = _exec(s->db, "COMMIT");
+    }
+    if (rc == -1) {
+        _exec(s->db, "ROLLBACK");
+    }
+    memo_end_trans();
+    db_free(query);
+    return rc;
+}
+
+int db_content_close(memo_content_stream_t *s)
+{
+    int rc = 0;
+
+    retvm_if(s == NULL, -1, "Invalid stream");
+
+    if (s->mode == MEMO_CONTENT_READ) {
+        sqlite3_finalize(s->stmt);
+        db_free(s->cur);
+    } else {
+        rc = s->failed ? -1 : _content_commit(s);
+        sqlite3_close(s->db); /* drops memo_stage */
+        db_free(s->head);
+        db_free(s->pend);
+    }
+    db_free(s);
+    return rc;
+}
@@ -0,0 +1,431 @@
+/*
+*
+* Copyright 2012  Samsung Electronics Co., Ltd
+*
+* Licensed under the Flora License, Version 1.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.tizenopensource.org/license
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unicode/ucol.h>
+#include <unicode/uloc.h>
+#include <unicode/unorm2.h>
+#include <unicode/ustring.h>
+#include <unicode/uchar.h>
+#include <unicode/utf8.h>
+
+#include "memo-log.h"
+#include "db-schema.h"
+#include "db-collate.h"
+#include "db-alloc.h"
+
+/*
+ * Locale aware ordering and matching, with ICU.
+ *
+ * Titles are sorted by sort_key, the ICU collation key of their first characters, set by
+ * every write of the library (db_collate_update_key, see MEMO_SORT_KEY_EXP). Keys compare as plain bytes, so the
+ * title order comes straight from the memo_live_title index. Keys of another locale or
+ * ICU version do not compare, so the collator of the keys is recorded in memo_meta and
+ * every process keeps making keys with it, whatever its own locale (db_collate_load).
+ * The keys are rebuilt only when memo_set_collation_locale asks for another collator
+ * (db_collate_refresh). The collator is opened when a key or comparison first needs it.
+ *
+ * Search folds the needle and the text to NFC + full case folding when the needle has
+ * letters outside ASCII, see db-match.c.
+ */
+static pthread_mutex_t collator_lock = PTHREAD_MUTEX_INITIALIZER;
+static UCollator *collator = NULL;
+static char collator_locale[ULOC_FULLNAME_CAPACITY]; /* "" for the default locale */
+static int locale_requested; /* by db_collate_set_locale, applied by the next refresh */
+static char collator_id[ULOC_FULLNAME_CAPACITY + U_MAX_VERSION_STRING_LENGTH + 2];
+static char stored_id[sizeof(collator_id)]; /* collator of the stored keys, "" if unknown */
+
+/* the caller holds collator_lock */
+static int _open(void)
+{
+    UErrorCode status = U_ZERO_ERROR;
+    UVersionInfo version;
+    char version_str[U_MAX_VERSION_STRING_LENGTH];
+    const char *locale = collator_locale[0] ? collator_locale : uloc_getDefault();
+    const char *actual;
+    UCollator *c;
+
+    /* LANG=C, POSIX order is byte order, which is what the sort keys are to replace */
+    if (collator_locale[0] == '\0' && strncmp(locale, "en_US_POSIX", 11) == 0) {
+        locale = "";
+    }
+
+    c = ucol_open(locale, &status);
+    retvm_if(U_FAILURE(status), -1, "Can't open collator of %s : %s", locale, u_errorName(status));
+    ucol_setAttribute(c, UCOL_NORMALIZATION_MODE, UCOL_ON, &status);
+
+    status = U_ZERO_ERROR;
+    actual = ucol_getLocaleByType(c, ULOC_ACTUAL_LOCALE, &status);
+    ucol_getVersion(c, version);
+    u_versionToString(version, version_str);
+    snprintf(collator_id, sizeof(collator_id), "%s@%s",
+            U_SUCCESS(status) && actual && *actual ? actual : "root", version_str);
+    warn_if(!locale_requested && stored_id[0] && strcmp(stored_id, collator_id) != 0,
+            "Keys of %s, collator %s, see memo_set_collation_locale", stored_id, collator_id);
+
+    if (collator != NULL) {
+        ucol_close(collator);
+    }
+    collator = c;
+    return 0;
+}
+
+static UCollator *_collator(void)
+{
+    UCollator *c;
+
+    pthread_mutex_lock(&collator_lock);
+    if (collator == NULL) {
+        _open();
+    }
+    c = collator;
+    pthread_mutex_unlock(&collator_lock);
+    return c;
+}
+
+/**
+ * @brief     Use the collator of locale ("ko_KR"), NULL for the default locale
+ *
+ * @remarks   Not to be called while other threads use the library,
+ *            db_collate_refresh rebuilds the stored keys.
+ */
+int db_collate_set_locale(const char *locale)
+{
+    int rc;
+
+    retvm_if(locale && strlen(locale) >= sizeof(collator_locale), -1, "Invalid locale : %s", locale);
+    pthread_mutex_lock(&collator_lock);
+    snprintf(collator_locale, sizeof(collator_locale), "%s", locale ? locale : "");
+    locale_requested = 1;
+    rc = _open();
+    pthread_mutex_unlock(&collator_lock);
+    return rc;
+}
+
+/* text as UTF-16, in buf when it fits cap units or else malloc'ed */
+static UChar *_to_utf16(const char *text, int len, UChar *buf, int32_t cap, int32_t *out_len)
+{
+    UErrorCode status = U_ZERO_ERROR;
+    UChar *out = buf;
+
+    u_strFromUTF8WithSub(out, cap, out_len, text, len, 0xFFFD, NULL, &status);
+    if (status == U_BUFFER_OVERFLOW_ERROR) {
+        out = (UChar *)db_malloc(sizeof(UChar) * (*out_len + 1));
+        retv_if(out == NULL, NULL);
+        status = U_ZERO_ERROR;
+        u_strFromUTF8WithSub(out, *out_len + 1, out_len, text, len, 0xFFFD, NULL, &status);
+    }
+    if (U_FAILURE(status)) {
+        if (out != buf) {
+            db_free(out);
+        }
+        return NULL;
+    }
+    return out;
+}
+
+/* memo_sort_key(text) : collation key of text, without its terminating 0 */
+static void _sort_key_func(sqlite3_context *ctx, int argc, sqlite3_value **argv)
+{
+    UChar buf[256];
+    uint8_t key[512];
+    uint8_t *big = NULL;
+    UChar *text;
+    int32_t len = 0;
+    int32_t size;
+    UCollator *c;
+
+    if (sqlite3_value_type(argv[0]) == SQLITE_NULL) {
+        return;
+    }
+
+    c = _collator();
+    text = _to_utf16((const char *)sqlite3_value_text(argv[0]), sqlite3_value_bytes(argv[0]),
+            buf, sizeof(buf) / sizeof(buf[0]), &len);
+    if (c == NULL || text == NULL) { /* byte order, rather than no order */
+        sqlite3_result_blob(ctx, sqlite3_value_text(argv[0]), sqlite3_value_bytes(argv[0]), SQLITE_TRANSIENT);
+        if (text != buf) {
+            db_free(text);
+        }
+        return;
+    }
+
+    size = ucol_getSortKey(c, text, len, key, sizeof(key));
+    if (size > (int32_t)sizeof(key)) {
+        big = (uint8_t *)db_malloc(size);
+        if (big != NULL) {
+            size = ucol_getSortKey(c, text, len, big, size);
+        }
+    }
+    if (text != buf) {
+        db_free(text);
+    }
+    if (size <= 0 || (size > (int32_t)sizeof(key) && big == NULL)) {
+        sqlite3_result_error_nomem(ctx);
+        return;
+    }
+    sqlite3_result_blob(ctx, big ? big : key, size - 1, SQLITE_TRANSIENT);
+    db_free(big);
+}
+
+/* COLLATE memo_locale */
+static int _collate(void *arg, int len1, const void *s1, int len2, const void *s2)
+{
+    UErrorCode status = U_ZERO_ERROR;
+    UCollator *c = _collator();
+    UCollationResult r;
+    int rc;
+
+    if (c != NULL) {
+        r = ucol_strcollUTF8(c, (const char *)s1, len1, (const char *)s2, len2, &status);
+        if (U_SUCCESS(status)) {
+            return r == UCOL_LESS ? -1 : (r == UCOL_GREATER ? 1 : 0);
+        }
+    }
+    rc = memcmp(s1, s2, len1 < len2 ? len1 : len2);
+    return rc ? rc : len1 - len2;
+}
+
+/**
+ * @brief     Whether matching text needs db_collate_fold, that is text has a character
+ *            outside ASCII which has case or combines
+ */
+int db_collate_need_fold(const char *text, int len)
+{
+    int32_t i = 0;
+    UChar32 c;
+
+    while (i < len) {
+        U8_NEXT(text, i, len, c);
+        if (c >= 0x80 && (u_hasBinaryProperty(c, UCHAR_CASED)
+                    || u_hasBinaryProperty(c, UCHAR_CHANGES_WHEN_CASEFOLDED)
+                    || u_getCombiningClass(c) != 0)) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief     NFC of the case folding of text, as a malloc'ed UTF-8 string
+ */
+char *db_collate_fold(const char *text, int len, int *out_len)
+{
+    UErrorCode status = U_ZERO_ERROR;
+    const UNormalizer2 *nfc = unorm2_getNFCInstance(&status);
+    UChar buf[256];
+    UChar *src, *folded = NULL, *norm = NULL;
+    int32_t n = 0, cap;
+    char *out = NULL;
+
+    retv_if(U_FAILURE(status) || text == NULL, NULL);
+    src = _to_utf16(text, len, buf, sizeof(buf) / sizeof(buf[0]), &n);
+    retv_if(src == NULL, NULL);
+
+    /* folding grows a character to 3 at most */
+    cap = n * 3 + 1;
+    folded = (UChar *)db_malloc(sizeof(UChar) * cap);
+    if (folded != NULL) {
+        n = u_strFoldCase(folded, cap, src, n, U_FOLD_CASE_DEFAULT, &status);
+    }
+    if (folded != NULL && U_SUCCESS(status)) {
+        cap = n * 3 + 1;
+        norm = (UChar *)db_malloc(sizeof(UChar) * cap);
+        if (norm != NULL) {
+            n = unorm2_normalize(nfc, folded, n, norm, cap, &status);
+        }
+    }
+    if (norm != NULL && U_SUCCESS(status)) {
+        cap = n * 3 + 1; /* a UTF-16 unit is 3 UTF-8 bytes at most */
+        out = (char *)db_malloc(cap);
+        if (out != NULL) {
+            u_strToUTF8WithSub(out, cap, out_len, norm, n, 0xFFFD, NULL, &status);
+            if (U_FAILURE(status)) {
+                db_free(out);
+                out = NULL;
+            }
+        }
+    }
+
+    if (src != buf) {
+        db_free(src);
+    }
+    db_free(folded);
+    db_free(norm);
+    return out;
+}
+
+int db_collate_register(sqlite3 *db)
+{
+    int rc;
+
+    rc = sqlite3_create_function(db, MEMO_SORT_KEY_FUNC, 1, SQLITE_UTF8 | SQLITE_DETERMINISTIC,
+            NULL, _sort_key_func, NULL, NULL);
+    retvm_if(rc != SQLITE_OK, -1, "Can't register %s : %s", MEMO_SORT_KEY_FUNC, sqlite3_errmsg(db));
+    rc = sqlite3_create_collation(db, MEMO_COLLATION, SQLITE_UTF8, NULL, _collate);
+    retvm_if(rc != SQLITE_OK, -1, "Can't register %s : %s", MEMO_COLLATION, sqlite3_errmsg(db));
+    return 0;
+}
+
+/* keys of live memos added by a connection which does not set them */
+static int _fill_keys(sqlite3 *db)
+{
+    sqlite3_stmt *stmt = NULL;
+    int rc;
+
+    rc = sqlite3_prepare_v2(db, "select 1 from memo where sort_key is null and delete_time = -1 "
+            "and (content is not null or comment is not null) limit 1", -1, &stmt, NULL);
+    retvm_if(rc != SQLITE_OK, -1, "SQL error : %s", sqlite3_errmsg(db));
+    rc = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+    retv_if(rc != SQLITE_ROW, 0);
+    rc = sqlite3_exec(db, "update memo set sort_key = " MEMO_SORT_KEY_EXP " where sort_key is null "
+            "and delete_time = -1", NULL, NULL, NULL);
+    retvm_if(rc != SQLITE_OK, -1, "SQL error : %s", sqlite3_errmsg(db));
+    return 0;
+}
+
+/* value of 'collation' in memo_meta into id, "" when there is none */
+static int _stored(sqlite3 *db, char *id, int size)
+{
+    sqlite3_stmt *stmt = NULL;
+    int rc;
+
+    id[0] = '\0';
+    rc = sqlite3_prepare_v2(db, "select value from memo_meta where key = 'collation'", -1, &stmt, NULL);
+    retvm_if(rc != SQLITE_OK, -1, "SQL error : %s", sqlite3_errmsg(db));
+    if (sqlite3_step(stmt) == SQLITE_ROW && sqlite3_column_text(stmt, 0) != NULL) {
+        snprintf(id, size, "%s", (const char *)sqlite3_column_text(stmt, 0));
+    }
+    sqlite3_finalize(stmt);
+    return 0;
+}
+
+/**
+ * @brief     Make keys with the collator recorded in memo_meta, at db_init
+ *
+ * @return    0 or -1 (Failed)
+ *
+ * @remarks   The collator is not opened unless keys are missing. A db without a recorded
+ *            collator, or a locale set by db_collate_set_locale before, goes through
+ *            db_collate_refresh instead.
+ */
+int db_collate_load(sqlite3 *db)
+{
+    char id[sizeof(collator_id)];
+    char *at;
+
+    retvm_if(db == NULL, -1, "DB handler is null");
+    retv_if(_stored(db, id, sizeof(id)) == -1, -1);
+    if (locale_requested || id[0] == '\0') {
+        return db_collate_refresh(db) == -1 ? -1 : 0;
+    }
+
+    /* "ko@58.2" : keys of the collator of locale ko, ICU collation version 58.2 */
+    at = strchr(id, '@');
+    if (at != NULL) {
+        *at = '\0';
+    }
+    retvm_if(strlen(id) >= sizeof(collator_locale), -1, "Invalid collation : %s", id);
+    pthread_mutex_lock(&collator_lock);
+    if (strcmp(collator_locale, id) != 0) {
+        memcpy(collator_locale, id, strlen(id) + 1);
+        if (collator != NULL) {
+            ucol_close(collator);
+            collator = NULL;
+        }
+    }
+    if (at != NULL) {
+        *at = '@';
+    }
+    snprintf(stored_id, sizeof(stored_id), "%s", id);
+    pthread_mutex_unlock(&collator_lock);
+    return _fill_keys(db);
+}
+
+/**
+ * @brief     Rebuild every sort_key when the collator changed since they were made
+ *
+ * @return    1 when the keys were rebuilt, 0 when they are current or -1 (Failed)
+ */
+int db_collate_refresh(sqlite3 *db)
+{
+    sqlite3_stmt *stmt = NULL;
+    char id[sizeof(collator_id)];
+    char stored[sizeof(collator_id)];
+    int rc;
+
+    retvm_if(db == NULL, -1, "DB handler is null");
+    retvm_if(_collator() == NULL, -1, "No collator");
+    pthread_mutex_lock(&collator_lock);
+    snprintf(id, sizeof(id), "%s", collator_id);
+    pthread_mutex_unlock(&collator_lock);
+
+    retv_if(_stored(db, stored, sizeof(stored)) == -1, -1);
+    if (strcmp(stored, id) == 0) {
+        locale_requested = 0;
+        snprintf(stored_id, sizeof(stored_id), "%s", id);
+        return _fill_keys(db);
+    }
+
+    DBG("sort keys of %s", id);
+    rc = sqlite3_exec(db, "BEGIN IMMEDIATE; update memo set sort_key = " MEMO_SORT_KEY_EXP, NULL, NULL, NULL);
+    if (rc == SQLITE_OK) {
+        rc = sqlite3_prepare_v2(db, "insert or replace into memo_meta (key, value) values ('collation', ?)",
+                -1, &stmt, NULL);
+    }
+    if (rc == SQLITE_OK) {
+        sqlite3_bind_text(stmt, 1, id, -1, SQLITE_STATIC);
+        rc = sqlite3_step(stmt) == SQLITE_DONE ? SQLITE_OK : SQLITE_ERROR;
+        sqlite3_finalize(stmt);
+    }
+    if (rc == SQLITE_OK) {
+        rc = sqlite3_exec(db, "COMMIT", NULL, NULL, NULL);
+    }
+    if (rc != SQLITE_OK) {
+        ERR("SQL error : %s", sqlite3_errmsg(db));
+        sqlite3_exec(db, "ROLLBACK", NULL, NULL, NULL);
+        return -1;
+    }
+    locale_requested = 0;
+    snprintf(stored_id, sizeof(stored_id), "%s", id);
+    return 1;
+}
+
+/**
+ * @brief     Set the sort_key of memo id from its stored content and comment
+ *
+ * @remarks   Should be called in the transaction which writes content or comment
+ */
+int db_collate_update_key(sqlite3 *db, int id)
+{
+    sqlite3_stmt *stmt = NULL;
+    int rc;
+
+    retvm_if(db == NULL, -1, "DB handler is null");
+    rc = sqlite3_prepare_v2(db, "update memo set sort_key = " MEMO_SORT_KEY_EXP " where id = ?", -1, &stmt, NULL);
+    retvm_if(rc != SQLITE_OK, -1, "SQL error : %s", sqlite3_errmsg(db));
+    sqlite3_bind_int(stmt, 1, id);
+    rc = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+    retvm_if(rc != SQLITE_DONE, -1, "SQL error : %s", sqlite3_errmsg(db));
+    return 0;
+}
@@ -0,0 +1,299 @@
+/*
+*
+* Copyright 2012  Samsung Electronics Co., Ltd
+*
+* Licensed under the Flora License, Version 1.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.tizenopensource.org/license
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+
+#include "memo-log.h"
+#include "db-compress.h"
+#include "db-alloc.h"
+
+/*
+ * Packed column layout (stored as BLOB in the TEXT columns):
+ *   [0..1] magic "MZ"
+ *   [2]    format version, PACK_VERSION_DICT1 = zlib stream with dictionary v1
+ *   [3]    reserved
+ *   [4..7] length of the plain text, little endian
+ *   [8..]  zlib stream
+ * Plain columns are still stored as TEXT, so old rows need no migration.
+ */
+#define PACK_MAGIC_0        'M'
+#define PACK_MAGIC_1        'Z'
+#define PACK_VERSION_DICT1  1
+#define PACK_HEADER_LEN     8
+
+/* hard limit of a single packed value, protects inflate from corrupt headers */
+#define PACK_MAX_PLAIN_LEN  (64 * 1024 * 1024)
+
+/*
+ * Preset dictionary, built from frequent substrings of memo text.
+ * zlib prefers the most frequent strings at the end of the dictionary.
+ * Never change it in place: add a new PACK_VERSION instead, old rows depend on it.
+ */
+static const char pack_dict_v1[] =
+    "meeting schedule tomorrow today morning afternoon evening weekend "
+    "Monday Tuesday Wednesday Thursday Friday Saturday Sunday "
+    "January February March April May June July August September October November December "
+    "password account address phone number email birthday anniversary "
+    "shopping list buy milk bread eggs coffee water "
+    "https://www. http://www. .com .net .org "
+    "\xEC\x98\xA4\xEB\x8A\x98 \xEB\x82\xB4\xEC\x9D\xBC \xEC\x95\xBD\xEC\x86\x8D "
+    "\xED\x9A\x8C\xEC\x9D\x98 \xEC\x8B\x9C\xEA\xB0\x84 \xEC\xA0\x84\xED\x99\x94 "
+    "\xEC\x9E\x85\xEB\x8B\x88\xEB\x8B\xA4. \xED\x95\xA9\xEB\x8B\x88\xEB\x8B\xA4. "
+    "that this with from have will your about there which would their "
+    " the  and  to  of  for  in  is  on  at ";
+
+static int pack_threshold = 0; /* 0 : compression disabled */
+
+void db_compress_set_threshold(int threshold)
+{
+    pack_threshold = threshold > 0 ? threshold : 0;
+}
+
+int db_compress_get_threshold(void)
+{
+    return pack_threshold;
+}
+
+/* the state of zlib (about 256 KiB for deflate) comes from the library allocator too */
+static voidpf _zalloc(voidpf opaque, uInt items, uInt size)
+{
+    return db_malloc((size_t)items * size);
+}
+
+static void _zfree(voidpf opaque, voidpf ptr)
+{
+    db_free(ptr);
+}
+
+static unsigned char *_pack(const char *input, int len, int *out_len)
+{
+    z_stream zs;
+    uLong bound;
+    unsigned char *buf;
+    int rc;
+
+    memset(&zs, 0, sizeof(zs));
+    zs.zalloc = _zalloc;
+    zs.zfree = _zfree;
+    if (deflateInit(&zs, Z_BEST_COMPRESSION) != Z_OK) {
+        return NULL;
+    }
+    if (deflateSetDictionary(&zs, (const Bytef *)pack_dict_v1, sizeof(pack_dict_v1) - 1) != Z_OK) {
+        deflateEnd(&zs);
+        return NULL;
+    }
+
+    bound = deflateBound(&zs, len);
+    buf = (unsigned char *)db_malloc(PACK_HEADER_LEN + bound);
+    if (buf == NULL) {
+        deflateEnd(&zs);
+        return NULL;
+    }
+
+    buf[0] = PACK_MAGIC_0;
+    buf[1] = PACK_MAGIC_1;
+    buf[2] = PACK_VERSION_DICT1;
+    buf[3] = 0;
+    buf[4] = len & 0xff;
+    buf[5] = (len >> 8) & 0xff;
+    buf[6] = (len >> 16) & 0xff;
+    buf[7] = (len >> 24) & 0xff;
+
+    zs.next_in = (Bytef *)input;
+    zs.avail_in = len;
+    zs.next_out = buf + PACK_HEADER_LEN;
+    zs.avail_out = bound;
+    rc = deflate(&zs, Z_FINISH);
+    if (rc != Z_STREAM_END) {
+        ERR("deflate failed : %d", rc);
+        deflateEnd(&zs);
+        db_free(buf);
+        return NULL;
+    }
+    *out_len = PACK_HEADER_LEN + zs.total_out;
+    deflateEnd(&zs);
+    return buf;
+}
+
+static int _is_packed(const unsigned char *blob, int len)
+{
+    return (blob != NULL && len > PACK_HEADER_LEN
+            && blob[0] == PACK_MAGIC_0 && blob[1] == PACK_MAGIC_1
+            && blob[2] == PACK_VERSION_DICT1);
+}
+
+/**
+ * db_compress_pack
+ *
+ * @brief Pack input regardless of the threshold
+ *
+ * @return   Pointer to the packed value, or NULL if packing fails or does not save space.
+ * The return value should be freed by caller.
+ */
+unsigned char *db_compress_pack(const char *input, int len, int *out_len)
+{
+    unsigned char *packed;
+
+    retv_if(input == NULL || out_len == NULL, NULL);
+
+    packed = _pack(input, len, out_len);
+    if (packed != NULL && *out_len >= len) { /* incompressible, keep plain */
+        db_free(packed);
+        return NULL;
+    }
+    return packed;
+}
+
+/**
+ * db_compress_make_constant
+ *
+ * @brief Make a sqlite blob constant (X'...') holding the packed input
+ *
+ * @param   [in] input The original string
+ *
+ * @return   Pointer to blob constant, or NULL if compression is disabled, the input is
+ * below the threshold or packing does not save space. The return value should be freed by caller.
+ */
+char *db_compress_make_constant(const char *input)
+{
+    static const char hex[] = "0123456789ABCDEF";
+    unsigned char *packed;
+    char *p;
+    int len, plen = 0;
+    int i, j = 0;
+
+    if (input == NULL || pack_threshold == 0) {
+        return NULL;
+    }
+
+    len = strlen(input);
+    if (len < pack_threshold) {
+        return NULL;
+    }
+
+    packed = db_compress_pack(input, len, &plen);
+    if (packed == NULL) {
+        return NULL;
+    }
+
+    p = (char *)db_malloc(plen * 2 + 4);
+    if (p == NULL) {
+        db_free(packed);
+        return NULL;
+    }
+    p[j++] = 'X';
+    p[j++] = '\'';
+    for (i = 0; i < plen; i++) {
+        p[j++] = hex[packed[i] >> 4];
+        p[j++] = hex[packed[i] & 0x0f];
+    }
+    p[j++] = '\'';
+    p[j] = '\0';
+
+    db_free(packed);
+    return p;
+}
+
+/**
+ * db_decompress
+ *
+ * @brief Unpack a column value written by db_compress_make_constant
+ *
+ * @return   Pointer to the nul terminated plain text or NULL if the blob is not packed or corrupt.
+ * The return value should be freed by caller.
+ */
+char *db_decompress(const void *blob, int len)
+{
+    const unsigned char *b = (const unsigned char *)blob;
+    z_stream zs;
+    unsigned int plain_len;
+    char *out;
+    int rc;
+
+    if (!_is_packed(b, len)) {
+        return NULL;
+    }
+
+    plain_len = b[4] | (b[5] << 8) | (b[6] << 16) | ((unsigned int)b[7] << 24);
+    retvm_if(plain_len > PACK_MAX_PLAIN_LEN, NULL, "Invalid packed length %u", plain_len);
+
+    out = (char *)db_malloc(plain_len + 1);
+    retv_if(out == NULL, NULL);
+
+    memset(&zs, 0, sizeof(zs));
+    zs.zalloc = _zalloc;
+    zs.zfree = _zfree;
+    if (inflateInit(&zs) != Z_OK) {
+        db_free(out);
+        return NULL;
+    }
+    zs.next_in = (Bytef *)(b + PACK_HEADER_LEN);
+    zs.avail_in = len - PACK_HEADER_LEN;
+    zs.next_out = (Bytef *)out;
+    zs.avail_out = plain_len;
+
+    rc = inflate(&zs, Z_FINISH);
+    if (rc == Z_NEED_DICT) {
+        rc = inflateSetDictionary(&zs, (const Bytef *)pack_dict_v1, sizeof(pack_dict_v1) - 1);
+        if (rc == Z_OK) {
+            rc = inflate(&zs, Z_FINISH);
+        }
+    }
+    if (rc != Z_STREAM_END || zs.total_out != plain_len) {
+        ERR("inflate failed : %d", rc);
+        inflateEnd(&zs);
+        db_free(out);
+        return NULL;
+    }
+    inflateEnd(&zs);
+
+    out[plain_len] = '\0';
+    return out;
+}
+
+/* memo_unpack(x) : returns the plain text of x, plain values are passed through untouched */
+static void _unpack_func(sqlite3_context *ctx, int argc, sqlite3_value **argv)
+{
+    sqlite3_value *v = argv[0];
+    char *plain;
+
+    if (sqlite3_value_type(v) != SQLITE_BLOB) {
+        sqlite3_result_value(ctx, v);
+        return;
+    }
+
+    plain = db_decompress(sqlite3_value_blob(v), sqlite3_value_bytes(v));
+    if (plain == NULL) {
+        sqlite3_result_value(ctx, v);
+        return;
+    }
+    sqlite3_result_text(ctx, plain, -1, db_free);
+}
+
+int db_compress_register(sqlite3 *db)
+{
+    int rc;
+
+    rc = sqlite3_create_function(db, MEMO_UNPACK_FUNC, 1, SQLITE_UTF8 | SQLITE_DETERMINISTIC,
+            NULL, _unpack_func, NULL, NULL);
+    retvm_if(rc != SQLITE_OK, -1, "Can't register %s : %s", MEMO_UNPACK_FUNC, sqlite3_errmsg(db));
+    return 0;
+}
@@ -0,0 +1,349 @@
+/*
+*
+* Copyright 2012  Samsung Electronics Co., Ltd
+*
+* Licensed under the Flora License, Version 1.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.tizenopensource.org/license
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+
+/*
+ * Doodle files are owned by the memo rows which refer to them in doodle_path.
+ * Files of deleted memos are queued here after the tombstone is committed and
+ * unlinked by a reaper thread, so callers never wait for the file system.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <limits.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "memo-log.h"
+#include "db-doodle.h"
+#include "db-alloc.h"
+
+struct doodle_job {
+    char *path;
+    struct doodle_job *next;
+};
+
+static pthread_mutex_t reaper_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t reaper_work = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t reaper_idle = PTHREAD_COND_INITIALIZER;
+static pthread_t reaper_thread;
+static int reaper_running = 0;
+static int reaper_stop = 0;
+static int reaper_busy = 0;
+static struct doodle_job *queue_head = NULL;
+static struct doodle_job *queue_tail = NULL;
+
+static void _unlink(const char *path)
+{
+    if (unlink(path) == -1 && errno != ENOENT) {
+        ERR("Can't remove doodle %s : %d", path, errno);
+    }
+}
+
+static void *_reaper(void *data)
+{
+    struct doodle_job *jobs, *j;
+
+    pthread_mutex_lock(&reaper_lock);
+    while (1) {
+        while (queue_head == NULL && !reaper_stop) {
+            pthread_cond_broadcast(&reaper_idle);
+            pthread_cond_wait(&reaper_work, &reaper_lock);
+        }
+        if (queue_head == NULL) {
+            break;
+        }
+
+        /* take the whole queue, unlink without holding the lock */
+        jobs = queue_head;
+        queue_head = queue_tail = NULL;
+        reaper_busy = 1;
+        pthread_mutex_unlock(&reaper_lock);
+
+        while (jobs) {
+            j = jobs;
+            jobs = jobs->next;
+            _unlink(j->path);
+            db_free(j->path);
+            db_free(j);
+        }
+
+        pthread_mutex_lock(&reaper_lock);
+        reaper_busy = 0;
+    }
+    pthread_cond_broadcast(&reaper_idle);
+    pthread_mutex_unlock(&reaper_lock);
+    return NULL;
+}
+
+/**
+ * @brief     Queue a doodle file for removal, the queue takes the ownership of path
+ *
+ * @return    Return 0 (Success) or -1 (Failed)
+ */
+int db_doodle_queue(char *path)
+{
+    struct doodle_job *j;
+
+    retv_if(path == NULL, -1);
+    if (path[0] != '/') {
+        ERR("Ignore relative doodle path %s", path);
+        db_free(path);
+        return -1;
+    }
+
+    j = (struct doodle_job *)db_calloc(1, sizeof(struct doodle_job));
+    if (j == NULL) {
+        _unlink(path);
+        db_free(path);
+        return 0;
+    }
+    j->path = path;
+
+    pthread_mutex_lock(&reaper_lock);
+    if (!reaper_running) {
+        if (pthread_create(&reaper_thread, NULL, _reaper, NULL) != 0) {
+            pthread_mutex_unlock(&reaper_lock);
+            ERR("Can't start doodle reaper, remove %s now", path);
+            _unlink(path);
+            db_free(path);
+            db_free(j);
+            return 0;
+        }
+        reaper_running = 1;
+    }
+    if (queue_tail) {
+        queue_tail->next = j;
+    } else {
+        queue_head = j;
+    }
+    queue_tail = j;
+    pthread_cond_signal(&reaper_work);
+    pthread_mutex_unlock(&reaper_lock);
+    return 0;
+}
+
+/**
+ * @brief     Wait until all queued doodle files are removed
+ */
+void db_doodle_flush(void)
+{
+    pthread_mutex_lock(&reaper_lock);
+    while (reaper_running && (queue_head != NULL || reaper_busy)) {
+        pthread_cond_wait(&reaper_idle, &reaper_lock);
+    }
+    pthread_mutex_unlock(&reaper_lock);
+}
+
+/**
+ * @brief     Remove the queued files and stop the reaper thread
+ */
+void db_doodle_stop(void)
+{
+    pthread_mutex_lock(&reaper_lock);
+    if (!reaper_running) {
+        pthread_mutex_unlock(&reaper_lock);
+        return;
+    }
+    reaper_stop = 1;
+    pthread_cond_signal(&reaper_work);
+    pthread_mutex_unlock(&reaper_lock);
+
+    pthread_join(reaper_thread, NULL);
+
+    pthread_mutex_lock(&reaper_lock);
+    reaper_running = 0;
+    reaper_stop = 0;
+    pthread_mutex_unlock(&reaper_lock);
+}
+
+char *db_doodle_path_to_release(sqlite3 *db, int id)
+{
+    sqlite3_stmt *stmt = NULL;
+    char *path = NULL;
+    int rc;
+
+    retv_if(db == NULL, NULL);
+
+    rc = sqlite3_prepare_v2(db, "select m.doodle_path from memo m where m.id = ? "
+            "and m.doodle_path is not null and m.doodle_path != '' "
+            "and not exists (select 1 from memo o where o.doodle_path = m.doodle_path "
+            "and o.id != m.id and o.delete_time = -1)", -1, &stmt, NULL);
+    retvm_if(rc != SQLITE_OK, NULL, "SQL error : %s", sqlite3_errmsg(db));
+    sqlite3_bind_int(stmt, 1, id);
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        path = db_strdup((const char *)sqlite3_column_text(stmt, 0));
+    }
+    sqlite3_finalize(stmt);
+    return path;
+}
+
+/* a file, whatever the path it is named by */
+struct file_key {
+    dev_t dev;
+    ino_t ino;
+};
+
+static int _cmp_file(const void *a, const void *b)
+{
+    const struct file_key *x = (const struct file_key *)a;
+    const struct file_key *y = (const struct file_key *)b;
+
+    if (x->dev != y->dev) {
+        return x->dev < y->dev ? -1 : 1;
+    }
+    return x->ino < y->ino ? -1 : (x->ino > y->ino ? 1 : 0);
+}
+
+/* sorted files of the doodle_path of the live memos, returns the count or -1 */
+static int _live_files(sqlite3 *db, struct file_key **out)
+{
+    sqlite3_stmt *stmt = NULL;
+    struct file_key *files = NULL, *t;
+    struct stat st;
+    const char *path;
+    int n = 0, capacity = 0;
+    int rc;
+
+    *out = NULL;
+    if (sqlite3_prepare_v2(db, "select distinct doodle_path from memo "
+                "where delete_time = -1 and doodle_path is not null and doodle_path != ''",
+                -1, &stmt, NULL) != SQLITE_OK) {
+        ERR("SQL error : %s", sqlite3_errmsg(db));
+        return -1;
+    }
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        path = (const char *)sqlite3_column_text(stmt, 0);
+        if (stat(path, &st) == -1) {
+            if (errno == ENOENT || errno == ENOTDIR) {
+                continue;
+            }
+            ERR("Can't stat doodle %s : %d", path, errno);
+            goto error;
+        }
+        if (n == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            t = (struct file_key *)db_realloc(files, capacity * sizeof(struct file_key));
+            if (t == NULL) {
+                goto error;
+            }
+            files = t;
+        }
+        files[n].dev = st.st_dev;
+        files[n].ino = st.st_ino;
+        n++;
+    }
+    if (rc != SQLITE_DONE) {
+        ERR("SQL error : %s", sqlite3_errmsg(db));
+        goto error;
+    }
+    sqlite3_finalize(stmt);
+
+    if (n > 0) {
+        qsort(files, n, sizeof(struct file_key), _cmp_file);
+    }
+    *out = files;
+    return n;
+
+error:
+    sqlite3_finalize(stmt);
+    db_free(files);
+    return -1;
+}
+
+/**
+ * @brief     Queue the files of dir which no live memo refers to
+ *
+ * @remarks   Files named <id>.png of a live memo are kept, older memo apps
+ *            stored doodles that way without filling doodle_path.
+ *            Files are compared by device and inode, a doodle_path spelled another
+ *            way (symbolic link, "..", double slash) or a hard link keeps its file.
+ *
+ * @return    the number of queued files or -1 (Failed)
+ */
+int db_doodle_scan_orphans(sqlite3 *db, const char *dir)
+{
+    sqlite3_stmt *stmt = NULL;
+    struct file_key *files = NULL;
+    struct file_key key;
+    int n_files;
+    DIR *d;
+    struct dirent *ent;
+    struct stat st;
+    char path[PATH_MAX];
+    char *end;
+    long id;
+    int queued = 0;
+    time_t limit = time(NULL) - DOODLE_ORPHAN_GRACE;
+
+    retvm_if(db == NULL || dir == NULL || dir[0] != '/', -1, "Invalid argument");
+
+    d = opendir(dir);
+    retvm_if(d == NULL, -1, "Can't open %s", dir);
+
+    /* never guess: without the list of live files nothing is an orphan */
+    n_files = _live_files(db, &files);
+    if (n_files == -1) {
+        closedir(d);
+        return -1;
+    }
+    if (sqlite3_prepare_v2(db, "select 1 from memo where id = ? and delete_time = -1",
+                -1, &stmt, NULL) != SQLITE_OK) {
+        ERR("SQL error : %s", sqlite3_errmsg(db));
+        queued = -1;
+        goto out;
+    }
+
+    while ((ent = readdir(d)) != NULL) {
+        if (ent->d_name[0] == '.') {
+            continue;
+        }
+        snprintf(path, sizeof(path), "%s/%s", dir, ent->d_name);
+        if (lstat(path, &st) == -1 || !S_ISREG(st.st_mode) || st.st_mtime > limit) {
+            continue;
+        }
+        key.dev = st.st_dev;
+        key.ino = st.st_ino;
+        if (n_files > 0 && bsearch(&key, files, n_files, sizeof(struct file_key), _cmp_file)) {
+            continue;
+        }
+
+        id = strtol(ent->d_name, &end, 10);
+        if (id > 0 && strcmp(end, ".png") == 0) {
+            sqlite3_reset(stmt);
+            sqlite3_bind_int(stmt, 1, id);
+            if (sqlite3_step(stmt) == SQLITE_ROW) {
+                continue;
+            }
+        }
+
+        if (db_doodle_queue(db_strdup(path)) == 0) {
+            queued++;
+        }
+    }
+
+out:
+    sqlite3_finalize(stmt);
+    closedir(d);
+    db_free(files);
+    return queued;
+}
@@ -0,0 +1,571 @@
+/*
+*
+* Copyright 2012  Samsung Electronics Co., Ltd
+*
+* Licensed under the Flora License, Version 1.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.tizenopensource.org/license
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+
+/*
+ * Streaming export and hot backup.
+ *
+ * Export reads from its own connections, one per thread, each in a read
+ * transaction opened before any row is read. With the rollback journal a
+ * writer can't commit while those shared locks are held, so all threads see
+ * the same state. A thread handles a range of ids and writes to a temp file,
+ * the ranges are appended to fd in order; memory stays at one memo per thread.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#include "memo-log.h"
+#include "memo-db.h"
+#include "db-helper.h"
+#include "db-compress.h"
+#include "db-chunk.h"
+#include "db-export.h"
+#include "db-match.h"
+#include "db-busy.h"
+#include "db-alloc.h"
+#include "db-budget.h"
+
+#define EXPORT_BUF_LEN      (64 * 1024)
+#define BACKUP_STEP_PAGES   64
+
+struct export_out {
+    int fd;
+    int err;
+    size_t n;
+    char buf[EXPORT_BUF_LEN];
+};
+
+struct export_job {
+    sqlite3 *db;
+    int format;
+    int lo, hi; /* ids in [lo, hi] */
+    FILE *tmp;
+    int rc;
+    pthread_t thread;
+};
+
+static void _flush(struct export_out *o)
+{
+    const char *p = o->buf;
+    ssize_t w;
+
+    while (o->n > 0 && !o->err) {
+        w = write(o->fd, p, o->n);
+        if (w < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            o->err = 1;
+            break;
+        }
+        p += w;
+        o->n -= w;
+    }
+    o->n = 0;
+}
+
+static void _put(struct export_out *o, const void *data, size_t len)
+{
+    size_t room;
+    const char *p = (const char *)data;
+
+    while (len > 0 && !o->err) {
+        room = EXPORT_BUF_LEN - o->n;
+        if (room == 0) {
+            _flush(o);
+            continue;
+        }
+        if (room > len) {
+            room = len;
+        }
+        memcpy(o->buf + o->n, p, room);
+        o->n += room;
+        p += room;
+        len -= room;
+    }
+}
+
+static void _puts(struct export_out *o, const char *s)
+{
+    _put(o, s, strlen(s));
+}
+
+static void _put_u32(struct export_out *o, uint32_t v)
+{
+    unsigned char b[4];
+
+    b[0] = v;
+    b[1] = v >> 8;
+    b[2] = v >> 16;
+    b[3] = v >> 24;
+    _put(o, b, 4);
+}
+
+static void _put_u64(struct export_out *o, uint64_t v)
+{
+    _put_u32(o, (uint32_t)v);
+    _put_u32(o, (uint32_t)(v >> 32));
+}
+
+static void _put_str(struct export_out *o, const char *s, uint32_t len)
+{
+    if (s == NULL) {
+        _put_u32(o, EXPORT_NULL_LEN);
+        return;
+    }
+    _put_u32(o, len);
+    _put(o, s, len);
+}
+
+static void _put_json_str(struct export_out *o, const char *s)
+{
+    const unsigned char *p, *start;
+    char esc[8];
+
+    if (s == NULL) {
+        _puts(o, "null");
+        return;
+    }
+
+    _put(o, "\"", 1);
+    for (p = start = (const unsigned char *)s; *p; p++) {
+        if (*p >= 0x20 && *p != '"' && *p != '\\') {
+            continue;
+        }
+        _put(o, start, p - start);
+        switch (*p) {
+        case '"':
+            _puts(o, "\\\"");
+            break;
+        case '\\':
+            _puts(o, "\\\\");
+            break;
+        case '\n':
+            _puts(o, "\\n");
+            break;
+        case '\r':
+            _puts(o, "\\r");
+            break;
+        case '\t':
+            _puts(o, "\\t");
+            break;
+        default:
+            snprintf(esc, sizeof(esc), "\\u%04x", *p);
+            _puts(o, esc);
+            break;
+        }
+        start = p + 1;
+    }
+    _put(o, start, p - start);
+    _put(o, "\"", 1);
+}
+
+static void _put_base64(struct export_out *o, const unsigned char *data, size_t len)
+{
+    static const char tbl[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    char q[4];
+    uint32_t v;
+    size_t i;
+
+    _put(o, "\"", 1);
+    for (i = 0; i + 2 < len; i += 3) {
+        v = (data[i] << 16) | (data[i + 1] << 8) | data[i + 2];
+        q[0] = tbl[(v >> 18) & 0x3f];
+        q[1] = tbl[(v >> 12) & 0x3f];
+        q[2] = tbl[(v >> 6) & 0x3f];
+        q[3] = tbl[v & 0x3f];
+        _put(o, q, 4);
+    }
+    if (i < len) {
+        v = data[i] << 16;
+        if (i + 1 < len) {
+            v |= data[i + 1] << 8;
+        }
+        q[0] = tbl[(v >> 18) & 0x3f];
+        q[1] = tbl[(v >> 12) & 0x3f];
+        q[2] = i + 1 < len ? tbl[(v >> 6) & 0x3f] : '=';
+        q[3] = '=';
+        _put(o, q, 4);
+    }
+    _put(o, "\"", 1);
+}
+
+static unsigned char *_read_file(const char *path, size_t *len)
+{
+    struct stat st;
+    unsigned char *data;
+    ssize_t n;
+    size_t done = 0;
+    int fd;
+
+    if (path == NULL || path[0] != '/') {
+        return NULL;
+    }
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode) || st.st_size > EXPORT_MAX_DOODLE) {
+        close(fd);
+        return NULL;
+    }
+    data = (unsigned char *)db_malloc(st.st_size + 1);
+    while (data && done < (size_t)st.st_size) {
+        n = read(fd, data + done, st.st_size - done);
+        if (n <= 0) {
+            break;
+        }
+        done += n;
+    }
+    close(fd);
+    *len = done;
+    return data;
+}
+
+static void _write_row(struct export_out *o, sqlite3 *db, sqlite3_stmt *stmt, int format)
+{
+    char num[160];
+    const char *content;
+    char *joined = NULL;
+    const char *comment, *doodle_path;
+    unsigned char *doodle = NULL;
+    size_t doodle_len = 0;
+    int id = sqlite3_column_int(stmt, 0);
+    uint32_t content_len, comment_len, path_len;
+
+    content = (const char *)sqlite3_column_text(stmt, 9);
+    if (content != NULL && strlen(content) >= MEMO_DB_MAX_CONTENT_LEN - 3) {
+        /* a full preview may have chunks */
+        joined = db_chunk_join(db, id, db_strdup(content));
+        if (joined != NULL) {
+            content = joined;
+        }
+    }
+    comment = (const char *)sqlite3_column_text(stmt, 10);
+    doodle_path = (const char *)sqlite3_column_text(stmt, 11);
+    if (format & MEMO_EXPORT_DOODLES) {
+        doodle = _read_file(doodle_path, &doodle_len);
+    }
+
+    if ((format & 0xff) == MEMO_EXPORT_BINARY) {
+        content_len = content ? strlen(content) : 0;
+        comment_len = comment ? strlen(comment) : 0;
+        path_len = doodle_path ? strlen(doodle_path) : 0;
+
+        _put_u32(o, EXPORT_FIXED_LEN + 16 + content_len + comment_len + path_len + doodle_len);
+        _put_u32(o, id);
+        _put_u64(o, sqlite3_column_int64(stmt, 1));
+        _put_u64(o, sqlite3_column_int64(stmt, 2));
+        _put_u32(o, sqlite3_column_int(stmt, 3));
+        _put_u32(o, sqlite3_column_int(stmt, 4));
+        _put_u32(o, sqlite3_column_int(stmt, 5));
+        _put_u32(o, sqlite3_column_int(stmt, 6));
+        _put_u32(o, sqlite3_column_int(stmt, 7));
+        _put_u32(o, (uint32_t)sqlite3_column_int64(stmt, 8));
+        _put_str(o, content, content_len);
+        _put_str(o, comment, comment_len);
+        _put_str(o, doodle_path, path_len);
+        _put_str(o, (const char *)doodle, doodle_len);
+    } else {
+        snprintf(num, sizeof(num), "{\"id\":%d,\"create_time\":%lld,\"modi_time\":%lld,"
+                "\"doodle\":%d,\"color\":%d,\"favorite\":%d,\"font_respect\":%d,"
+                "\"font_size\":%d,\"font_color\":%u,\"content\":",
+                id, sqlite3_column_int64(stmt, 1), sqlite3_column_int64(stmt, 2),
+                sqlite3_column_int(stmt, 3), sqlite3_column_int(stmt, 4),
+                sqlite3_column_int(stmt, 5), sqlite3_column_int(stmt, 6),
+                sqlite3_column_int(stmt, 7), (uint32_t)sqlite3_column_int64(stmt, 8));
+        _puts(o, num);
+        _put_json_str(o, content);
+        _puts(o, ",\"comment\":");
+        _put_json_str(o, comment);
+        _puts(o, ",\"doodle_path\":");
+        _put_json_str(o, doodle_path);
+        if (doodle != NULL) {
+            _puts(o, ",\"doodle_data\":");
+            _put_base64(o, doodle, doodle_len);
+        }
+        _puts(o, "}\n");
+    }
+
+    db_free(joined);
+    db_free(doodle);
+}
+
+static int _export_range(sqlite3 *db, struct export_out *o, int format, int lo, int hi)
+{
+    sqlite3_stmt *stmt = NULL;
+    int rc;
+
+    rc = sqlite3_prepare_v2(db, "select id, create_time, modi_time, doodle, color, favorite, "
+            "font_respect, font_size, font_color, " MEMO_UNPACK_FUNC "(content), "
+            MEMO_UNPACK_FUNC "(comment), doodle_path "
+            "from memo where delete_time = -1 and id >= ? and id <= ? order by id", -1, &stmt, NULL);
+    retvm_if(rc != SQLITE_OK, -1, "SQL error : %s", sqlite3_errmsg(db));
+    sqlite3_bind_int(stmt, 1, lo);
+    sqlite3_bind_int(stmt, 2, hi);
+
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW && !o->err) {
+        _write_row(o, db, stmt, format);
+    }
+    sqlite3_finalize(stmt);
+    _flush(o);
+    retvm_if(rc != SQLITE_DONE && !o->err, -1, "SQL error : %s", sqlite3_errmsg(db));
+    return o->err ? -1 : 0;
+}
+
+static void *_export_thread(void *data)
+{
+    struct export_job *job = (struct export_job *)data;
+    struct export_out *o;
+
+    job->rc = -1;
+    o = (struct export_out *)db_calloc(1, sizeof(struct export_out));
+    retv_if(o == NULL, NULL);
+    o->fd = fileno(job->tmp);
+    job->rc = _export_range(job->db, o, job->format, job->lo, job->hi);
+    db_free(o);
+    return NULL;
+}
+
+/*
+ * Read-only connection in a read transaction. While it is open no writer can commit,
+ * so every connection opened this way sees the same data. Also used by db-psearch.c.
+ */
+sqlite3 *db_export_open_reader(const char *path)
+{
+    sqlite3 *db = NULL;
+
+    if (sqlite3_open_v2(path, &db, SQLITE_OPEN_READONLY, NULL) != SQLITE_OK) {
+        ERR("Can't open %s : %s", path, sqlite3_errmsg(db));
+        sqlite3_close(db);
+        return NULL;
+    }
+    if (db_budget_apply(db) == -1 || db_busy_register(db) == -1 || db_compress_register(db) == -1 || db_match_register(db) == -1
+            || sqlite3_exec(db, "BEGIN; select count(*) from sqlite_master", NULL, NULL, NULL) != SQLITE_OK) {
+        ERR("Can't start export : %s", sqlite3_errmsg(db));
+        sqlite3_close(db);
+        return NULL;
+    }
+    return db;
+}
+
+void db_export_close_reader(sqlite3 *db)
+{
+    if (db) {
+        sqlite3_exec(db, "COMMIT", NULL, NULL, NULL);
+        sqlite3_close(db);
+    }
+}
+
+static int _append(struct export_out *o, FILE *tmp)
+{
+    char buf[EXPORT_BUF_LEN];
+    ssize_t n;
+    int fd = fileno(tmp);
+
+    retv_if(lseek(fd, 0, SEEK_SET) == -1, -1);
+    while ((n = read(fd, buf, sizeof(buf))) > 0) {
+        _put(o, buf, n);
+    }
+    return n < 0 || o->err ? -1 : 0;
+}
+
+/**
+ * @brief     Write the live memos to fd
+ *
+ * @return    Return 0 (Success) or -1 (Failed)
+ */
+int db_export(sqlite3 *db, int fd, int format, int threads)
+{
+    struct export_out *o;
+    struct export_job jobs[EXPORT_MAX_THREADS];
+    sqlite3_stmt *stmt = NULL;
+    const char *path;
+    int lo = 0, hi = -1, count = 0;
+    int i, step, rc = 0;
+    unsigned char header[8];
+
+    retvm_if(db == NULL, -1, "DB handler is null");
+    retvm_if(fd < 0, -1, "Invalid fd");
+    retvm_if((format & 0xff) != MEMO_EXPORT_JSON_LINES && (format & 0xff) != MEMO_EXPORT_BINARY,
+            -1, "Invalid format : %x", format);
+
+    path = sqlite3_db_filename(db, "main");
+    retvm_if(path == NULL || path[0] == '\0', -1, "Export needs a db file");
+    if (threads < 1) {
+        threads = 1;
+    } else if (threads > EXPORT_MAX_THREADS) {
+        threads = EXPORT_MAX_THREADS;
+    }
+
+    o = (struct export_out *)db_calloc(1, sizeof(struct export_out));
+    retvm_if(o == NULL, -1, "calloc failed");
+    o->fd = fd;
+
+    /* all read transactions are opened before the first row is read */
+    memset(jobs, 0, sizeof(jobs));
+    for (i = 0; i < threads; i++) {
+        jobs[i].db = db_export_open_reader(path);
+        if (jobs[i].db == NULL) {
+            rc = -1;
+            goto out;
+        }
+    }
+
+    if (sqlite3_prepare_v2(jobs[0].db, "select min(id), max(id), count(*) from memo "
+                "where delete_time = -1", -1, &stmt, NULL) == SQLITE_OK
+            && sqlite3_step(stmt) == SQLITE_ROW) {
+        lo = sqlite3_column_int(stmt, 0);
+        hi = sqlite3_column_int(stmt, 1);
+        count = sqlite3_column_int(stmt, 2);
+    }
+    sqlite3_finalize(stmt);
+    if (threads > count) {
+        threads = count > 0 ? count : 1;
+    }
+
+    if ((format & 0xff) == MEMO_EXPORT_BINARY) {
+        memcpy(header, EXPORT_MAGIC, 4);
+        header[4] = EXPORT_VERSION;
+        header[5] = (format & MEMO_EXPORT_DOODLES) ? 1 : 0;
+        header[6] = header[7] = 0;
+        _put(o, header, sizeof(header));
+    }
+
+    if (count == 0) {
+        /* nothing to read */
+    } else if (threads == 1) {
+        rc = _export_range(jobs[0].db, o, format, lo, hi);
+    } else {
+        step = (hi - lo) / threads + 1;
+        for (i = 0; i < threads; i++) {
+            jobs[i].format = format;
+            jobs[i].lo = lo + i * step;
+            jobs[i].hi = i == threads - 1 ? hi : lo + (i + 1) * step - 1;
+            jobs[i].tmp = tmpfile();
+            jobs[i].rc = -1;
+            if (jobs[i].tmp == NULL
+                    || pthread_create(&jobs[i].thread, NULL, _export_thread, &jobs[i]) != 0) {
+                ERR("Can't start export thread %d", i);
+                if (jobs[i].tmp) {
+                    fclose(jobs[i].tmp);
+                    jobs[i].tmp = NULL;
+                }
+                rc = -1;
+                break;
+            }
+        }
+        threads = i;
+        for (i = 0; i < threads; i++) {
+            pthread_join(jobs[i].thread, NULL);
+        }
+        for (i = 0; i < threads && rc == 0; i++) {
+            rc = jobs[i].rc == 0 ? _append(o, jobs[i].tmp) : -1;
+        }
+    }
+
+    if (rc == 0 && (format & 0xff) == MEMO_EXPORT_BINARY) {
+        _put_u32(o, 0);
+    }
+    _flush(o);
+    if (o->err) {
+        ERR("Can't write export : %d", errno);
+        rc = -1;
+    }
+
+out:
+    for (i = 0; i < EXPORT_MAX_THREADS; i++) {
+        if (jobs[i].tmp) {
+            fclose(jobs[i].tmp);
+        }
+        db_export_close_reader(jobs[i].db);
+    }
+    db_free(o);
+    return rc;
+}
+
+/**
+ * @brief     Copy the db to dest with the online backup API
+ *
+ * @remarks   The source is locked for BACKUP_STEP_PAGES pages at a time, writers
+ *            can commit in between; the copy restarts if another connection does.
+ *            A source locked longer than the busy timeout fails the copy.
+ *            dest is replaced only when the copy is complete.
+ *
+ * @return    Return 0 (Success) or -1 (Failed)
+ */
+int db_backup(sqlite3 *db, const char *dest)
+{
+    sqlite3 *out = NULL;
+    sqlite3_backup *b;
+    char tmp[PATH_MAX];
+    int busy = 0;
+    int rc, fd;
+
+    retvm_if(db == NULL, -1, "DB handler is null");
+    retvm_if(dest == NULL, -1, "Invalid path");
+    retvm_if(snprintf(tmp, sizeof(tmp), "%s.XXXXXX", dest) >= (int)sizeof(tmp), -1, "Too long path %s", dest);
+
+    /* an empty file is an empty db to sqlite */
+    fd = mkstemp(tmp);
+    retvm_if(fd < 0, -1, "Can't create %s : %d", tmp, errno);
+    close(fd);
+    rc = sqlite3_open(tmp, &out);
+    if (rc != SQLITE_OK) {
+        ERR("Can't open %s : %s", tmp, sqlite3_errmsg(out));
+        sqlite3_close(out);
+        unlink(tmp);
+        return -1;
+    }
+
+    b = sqlite3_backup_init(out, "main", db, "main");
+    if (b == NULL) {
+        ERR("Can't start backup : %s", sqlite3_errmsg(out));
+        sqlite3_close(out);
+        unlink(tmp);
+        return -1;
+    }
+    do {
+        rc = sqlite3_backup_step(b, BACKUP_STEP_PAGES);
+        if (rc == SQLITE_BUSY || rc == SQLITE_LOCKED) {
+            if (!db_busy_wait(busy++)) {
+                break;
+            }
+        } else {
+            busy = 0;
+        }
+    } while (rc == SQLITE_OK || rc == SQLITE_BUSY || rc == SQLITE_LOCKED);
+    if (sqlite3_backup_finish(b) != SQLITE_OK && rc == SQLITE_DONE) {
+        rc = sqlite3_errcode(out);
+    }
+    sqlite3_close(out);
+
+    if (rc != SQLITE_DONE || rename(tmp, dest) == -1) {
+        ERR("Backup to %s failed : %d", dest, rc);
+        unlink(tmp);
+        return -1;
+    }
+    return 0;
+}
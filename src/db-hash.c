@@ -0,0 +1,193 @@
+/*
+*
+* Copyright 2012  Samsung Electronics Co., Ltd
+*
+* Licensed under the Flora License, Version 1.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.tizenopensource.org/license
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+
+/*
+ * xxHash64 (https://github.com/Cyan4973/xxHash, BSD 2-Clause), enough of it
+ * for the content_hash column.
+ */
+
+#include <string.h>
+
+#include "db-hash.h"
+
+#define P1 0x9E3779B185EBCA87ULL
+#define P2 0xC2B2AE3D27D4EB4FULL
+#define P3 0x165667B19E3779F9ULL
+#define P4 0x85EBCA77C2B2AE63ULL
+#define P5 0x27D4EB2F165667C5ULL
+
+#define ROTL(x, r) (((x) << (r)) | ((x) >> (64 - (r))))
+
+static uint64_t _read64(const unsigned char *p)
+{
+    return (uint64_t)p[0] | ((uint64_t)p[1] << 8) | ((uint64_t)p[2] << 16) | ((uint64_t)p[3] << 24)
+        | ((uint64_t)p[4] << 32) | ((uint64_t)p[5] << 40) | ((uint64_t)p[6] << 48) | ((uint64_t)p[7] << 56);
+}
+
+static uint32_t _read32(const unsigned char *p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t _round(uint64_t acc, uint64_t input)
+{
+    acc += input * P2;
+    acc = ROTL(acc, 31);
+    return acc * P1;
+}
+
+static uint64_t _merge(uint64_t acc, uint64_t val)
+{
+    acc ^= _round(0, val);
+    return acc * P1 + P4;
+}
+
+static void _stripe(uint64_t *v, const unsigned char *p)
+{
+    v[0] = _round(v[0], _read64(p));
+    v[1] = _round(v[1], _read64(p + 8));
+    v[2] = _round(v[2], _read64(p + 16));
+    v[3] = _round(v[3], _read64(p + 24));
+}
+
+void db_hash_init(struct db_hash *h, uint64_t seed)
+{
+    memset(h, 0, sizeof(*h));
+    h->v[0] = seed + P1 + P2;
+    h->v[1] = seed + P2;
+    h->v[2] = seed;
+    h->v[3] = seed - P1;
+}
+
+void db_hash_update(struct db_hash *h, const void *data, size_t len)
+{
+    const unsigned char *p = (const unsigned char *)data;
+    const unsigned char *end = p + len;
+    size_t n;
+
+    h->total_len += len;
+
+    if (h->memsize + len < 32) {
+        memcpy(h->mem + h->memsize, p, len);
+        h->memsize += len;
+        return;
+    }
+    if (h->memsize) {
+        n = 32 - h->memsize;
+        memcpy(h->mem + h->memsize, p, n);
+        _stripe(h->v, h->mem);
+        p += n;
+        h->memsize = 0;
+    }
+    while (end - p >= 32) {
+        _stripe(h->v, p);
+        p += 32;
+    }
+    if (p < end) {
+        memcpy(h->mem, p, end - p);
+        h->memsize = end - p;
+    }
+}
+
+uint64_t db_hash_digest(const struct db_hash *h)
+{
+    const unsigned char *p = h->mem;
+    const unsigned char *end = p + h->memsize;
+    uint64_t acc;
+
+    if (h->total_len >= 32) {
+        acc = ROTL(h->v[0], 1) + ROTL(h->v[1], 7) + ROTL(h->v[2], 12) + ROTL(h->v[3], 18);
+        acc = _merge(acc, h->v[0]);
+        acc = _merge(acc, h->v[1]);
+        acc = _merge(acc, h->v[2]);
+        acc = _merge(acc, h->v[3]);
+    } else {
+        acc = h->v[2] + P5; /* the seed */
+    }
+    acc += h->total_len;
+
+    while (end - p >= 8) {
+        acc ^= _round(0, _read64(p));
+        acc = ROTL(acc, 27) * P1 + P4;
+        p += 8;
+    }
+    if (end - p >= 4) {
+        acc ^= (uint64_t)_read32(p) * P1;
+        acc = ROTL(acc, 23) * P2 + P3;
+        p += 4;
+    }
+    while (p < end) {
+        acc ^= *p * P5;
+        acc = ROTL(acc, 11) * P1;
+        p++;
+    }
+
+    acc ^= acc >> 33;
+    acc *= P2;
+    acc ^= acc >> 29;
+    acc *= P3;
+    acc ^= acc >> 32;
+    return acc;
+}
+
+/*
+ * Each field is its bytes, then the length and a presence byte, so NULL and ""
+ * differ and the content can be hashed as it is written.
+ */
+static void _end_field(struct db_hash *h, const char *s, uint32_t len)
+{
+    unsigned char tail[5];
+
+    tail[0] = len & 0xff;
+    tail[1] = (len >> 8) & 0xff;
+    tail[2] = (len >> 16) & 0xff;
+    tail[3] = (len >> 24) & 0xff;
+    tail[4] = s != NULL;
+    if (s != NULL) {
+        db_hash_update(h, tail, sizeof(tail));
+    } else {
+        db_hash_update(h, tail + 4, 1);
+    }
+}
+
+static void _field(struct db_hash *h, const char *s)
+{
+    uint32_t len = s ? strlen(s) : 0;
+
+    db_hash_update(h, s, len);
+    _end_field(h, s, len);
+}
+
+int64_t db_hash_memo_finish(struct db_hash *h, uint32_t len, const char *comment, const char *doodle_path)
+{
+    _end_field(h, "", len);
+    _field(h, comment);
+    _field(h, doodle_path);
+    return (int64_t)db_hash_digest(h);
+}
+
+int64_t db_hash_memo(const char *content, const char *comment, const char *doodle_path)
+{
+    struct db_hash h;
+
+    db_hash_init(&h, 0);
+    _field(&h, content);
+    _field(&h, comment);
+    _field(&h, doodle_path);
+    return (int64_t)db_hash_digest(&h);
+}
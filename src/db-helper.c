@@ -20,10 +20,14 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include <assert.h>
 #include <string.h>
+#include <time.h>
 #include "db-helper.h"
+#include "db-compress.h"
 #include "memo-db.h"
+#include "db-alloc.h"
 
 #define SINGLE_QUOTO '\''
 #define sncat(to, size, from) \
@@ -45,12 +49,23 @@ struct column_t columns[] = {
     {"font_color",      "%d"},  /*  6 - KEY_FONT_COLOR */
     {"comment",         "%s"},  /*  7 - KEY_COMMENT */
     {"doodle_path",     "%s"},  /*  8 - KEY_DOODLE_PATH */
-    {"create_time",     "%d"},  /*  9 - KEY_CREATE_TIME */
-    {"modi_time",       "%d"},  /* 10 - KEY_MODI_TIME */
-    {"delete_time",     "%d"},  /* 11 - KEY_DELETE_TIME */
+    {"create_time",     "%lld"}, /*  9 - KEY_CREATE_TIME */
+    {"modi_time",       "%lld"}, /* 10 - KEY_MODI_TIME */
+    {"delete_time",     "%lld"}, /* 11 - KEY_DELETE_TIME */
     {"written_time",    "%s"},  /* 12 - KEY_WRITTEN_TIME */
+    {"content_hash",    "%lld"}, /* 13 - KEY_CONTENT_HASH */
+    {"create_utime",    "%lld"}, /* 14 - KEY_CREATE_UTIME */
+    {"modi_utime",      "%lld"}, /* 15 - KEY_MODI_UTIME */
 };
 
+int64_t db_now_utime(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
 void string_append_printf(char *str, char *fmt, ...)
 {
     va_list args;
@@ -60,6 +75,33 @@ void string_append_printf(char *str, char *fmt, ...)
     va_end(args);
 }
 
+/*
+ * @decription
+ *   Length of the preview part of content, at most MEMO_DB_MAX_CONTENT_LEN bytes
+ *   and never splitting an UTF-8 sequence.
+ *
+ * @param[in]   content
+ * @return      preview length in bytes
+ */
+int db_content_preview_len(const char *content)
+{
+    int len;
+
+    if (content == NULL) { return 0; }
+
+    len = strlen(content);
+    if (len <= MEMO_DB_MAX_CONTENT_LEN) {
+        return len;
+    }
+
+    len = MEMO_DB_MAX_CONTENT_LEN;
+    /* step back over continuation bytes (10xxxxxx) to the lead byte of the cut character */
+    while (len > 0 && ((unsigned char)content[len] & 0xC0) == 0x80) {
+        len--;
+    }
+    return len;
+}
+
 /*
  * @decription
  *   Limit the maximum content length.
@@ -71,10 +113,7 @@ char *db_content_truncate(char *content)
 {
     if (content == NULL) { return NULL; }
 
-    if (strlen(content) > MEMO_DB_MAX_CONTENT_LEN)
-    {
-        content[MEMO_DB_MAX_CONTENT_LEN] = '\0';
-    }
+    content[db_content_preview_len(content)] = '\0';
     return content;
 }
 
@@ -86,14 +125,26 @@ char *db_parse_value(int key, void *val)
     bool is_string = (type[strlen(type) - 1] == 's' ? true : false);
 
     if (is_string) {
+        if (key == KEY_CONTENT || key == KEY_COMMENT) {
+            char *packed = db_compress_make_constant((const char *)val);
+            if (packed != NULL) {
+                return packed;
+            }
+        }
         return db_make_string_constant((const char *)val);
     } else {
         int len = 32;
-        char *buf = (char *)malloc(sizeof(char) * len);
+        char *buf = (char *)db_malloc(sizeof(char) * len);
         if (buf == NULL) {
             return NULL;
         }
-        snprintf(buf, len, type, val);
+        if (key == KEY_COLOR) { /* 0 is a color too */
+            snprintf(buf, len, "%d", (int)*(const unsigned int *)val);
+        } else if (strcmp(type, "%lld") == 0) { /* does not fit in a pointer on 32 bit targets */
+            snprintf(buf, len, type, (long long)*(const int64_t *)val);
+        } else {
+            snprintf(buf, len, type, val);
+        }
         return buf;
     }
 }
@@ -105,6 +156,18 @@ void db_key_value_array_append(struct key_value_t kv[], int total, int key1, voi
     kv[i].value = db_parse_value(key1, val1);
 }
 
+/* NEXT_UTIME_SQL for now, the same value for every key of one query */
+static void db_key_value_array_append_utime(struct key_value_t kv[], int total, int key, int64_t now)
+{
+    int len = 128;
+
+    kv[total].key = columns[key].name;
+    kv[total].value = (char *)db_malloc(len);
+    if (kv[total].value != NULL) {
+        snprintf(kv[total].value, len, NEXT_UTIME_SQL("%lld"), (long long)now);
+    }
+}
+
 int db_parse_key_value(struct key_value_t kv[], int key1, void *val1, va_list args)
 {
     int keyn = -1;
@@ -139,9 +202,15 @@ char *db_make_insert_query(int key1, void *val1, ...)
     count = db_parse_key_value(kv ,key1, val1, args);
     va_end(args);
 
-    db_key_value_array_append(kv, count++, KEY_CREATE_TIME, (void *)time(NULL));
-    db_key_value_array_append(kv, count++, KEY_MODI_TIME, (void *)time(NULL));
-    db_key_value_array_append(kv, count++, KEY_DELETE_TIME, (void *)-1);
+    int64_t utime = db_now_utime();
+    int64_t now = utime / 1000000;
+    int64_t deleted = -1;
+
+    db_key_value_array_append(kv, count++, KEY_CREATE_TIME, &now);
+    db_key_value_array_append(kv, count++, KEY_MODI_TIME, &now);
+    db_key_value_array_append(kv, count++, KEY_DELETE_TIME, &deleted);
+    db_key_value_array_append_utime(kv, count++, KEY_CREATE_UTIME, utime);
+    db_key_value_array_append_utime(kv, count++, KEY_MODI_UTIME, utime);
 
     /* BEGIN Generate SQL Query */
     /* INSERT INTO memo (key1, key2, ...) VALUES (val1, val2, ...) */
@@ -152,11 +221,11 @@ char *db_make_insert_query(int key1, void *val1, ...)
         len += strlen(kv[i].value);
     }
 
-    char *buf = (char *)malloc(len);
+    char *buf = (char *)db_malloc(len);
     if (buf == NULL) {
         for (i = 0; i < count; ++i) /* clean up */
         {
-            free(kv[i].value);
+            db_free(kv[i].value);
         }
         return NULL;
     }
@@ -178,7 +247,7 @@ char *db_make_insert_query(int key1, void *val1, ...)
 
     for (i = 0; i < count; ++i) /* clean up */
     {
-        free(kv[i].value);
+        db_free(kv[i].value);
     }
 
     return buf;
@@ -195,7 +264,11 @@ char *db_make_update_query(int id, int key1, void *val1, ...)
     count = db_parse_key_value(kv ,key1, val1, args);
     va_end(args);
 
-    db_key_value_array_append(kv, count++, KEY_MODI_TIME, (void *)time(NULL));
+    int64_t utime = db_now_utime();
+    int64_t now = utime / 1000000;
+
+    db_key_value_array_append(kv, count++, KEY_MODI_TIME, &now);
+    db_key_value_array_append_utime(kv, count++, KEY_MODI_UTIME, utime);
 
     /* BEGIN Generate SQL Query */
     /* UPDATE memo SET key1 = val1, key2 = val2, ... WHERE id = %d */
@@ -206,11 +279,11 @@ char *db_make_update_query(int id, int key1, void *val1, ...)
         len += strlen(kv[i].value);
     }
 
-    char *buf = (char *)malloc(len);
+    char *buf = (char *)db_malloc(len);
     if (buf == NULL) {
         for (i = 0; i < count; ++i) /* clean up */
         {
-            free(kv[i].value);
+            db_free(kv[i].value);
         }
         return NULL;
     }
@@ -228,7 +301,7 @@ char *db_make_update_query(int id, int key1, void *val1, ...)
 
     for (i = 0; i < count; ++i) /* clean up */
     {
-        free(kv[i].value);
+        db_free(kv[i].value);
     }
 
     return buf;
@@ -236,8 +309,10 @@ char *db_make_update_query(int id, int key1, void *val1, ...)
 
 char *db_make_delete_query(int id)
 {
+    int64_t now = time(NULL);
+
     return db_make_update_query(id,
-        KEY_DELETE_TIME, (void *)time(NULL),
+        KEY_DELETE_TIME, &now,
         KEY_INPUT_END);
 }
 
@@ -284,7 +359,7 @@ char *db_make_string_constant(const char *input)
     }
 
     int size = _string_constant_len(input);
-    char *p = (char *)calloc(1, size+1);
+    char *p = (char *)db_calloc(1, size+1);
     if (p == NULL) {
         return NULL;
     }
@@ -0,0 +1,900 @@
+/*
+*
+* Copyright 2012  Samsung Electronics Co., Ltd
+*
+* Licensed under the Flora License, Version 1.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.tizenopensource.org/license
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+
+/*
+ * Streaming import of the formats written by db-export.c.
+ *
+ * Records are parsed one at a time and written with prepared statements,
+ * IMPORT_BATCH memos per transaction. Change subscribers are notified once,
+ * when the whole archive is imported.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <stdint.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "memo-log.h"
+#include "memo-db.h"
+#include "db-schema.h"
+#include "db-helper.h"
+#include "db-compress.h"
+#include "db-chunk.h"
+#include "db-export.h"
+#include "db-import.h"
+#include "db-hash.h"
+#include "db-alloc.h"
+
+#define IMPORT_BUF_LEN (64 * 1024)
+
+struct import_in {
+    int fd;
+    int eof;
+    int err;
+    size_t pos, len;
+    long long bytes;
+    unsigned char buf[IMPORT_BUF_LEN];
+};
+
+struct import_rec {
+    int id;
+    long long create_time;
+    long long modi_time;
+    int doodle;
+    int color;
+    int favorite;
+    int font_respect;
+    int font_size;
+    unsigned int font_color;
+    char *content;
+    char *comment;
+    char *doodle_path;
+    unsigned char *doodle_data;
+    size_t doodle_len;
+};
+
+struct import_ctx {
+    sqlite3 *db;
+    MEMO_IMPORT_POLICY policy;
+    const char *doodle_dir;
+    time_t now;
+    sqlite3_stmt *find_id;
+    sqlite3_stmt *find_hash;
+    sqlite3_stmt *insert;
+    sqlite3_stmt *update;
+    struct memo_import_progress progress;
+};
+
+/******************************
+* input
+*******************************/
+static size_t _fill(struct import_in *in)
+{
+    ssize_t n;
+
+    if (in->pos < in->len) {
+        return in->len - in->pos;
+    }
+    if (in->eof) {
+        return 0;
+    }
+    do {
+        n = read(in->fd, in->buf, sizeof(in->buf));
+    } while (n < 0 && errno == EINTR);
+    in->pos = in->len = 0;
+    if (n <= 0) {
+        in->eof = 1;
+        if (n < 0) {
+            ERR("Can't read archive : %d", errno);
+            in->err = 1;
+        }
+        return 0;
+    }
+    in->len = n;
+    in->bytes += n;
+    return n;
+}
+
+static int _read_exact(struct import_in *in, void *dst, size_t n)
+{
+    unsigned char *q = (unsigned char *)dst;
+    size_t avail;
+
+    while (n > 0) {
+        avail = _fill(in);
+        if (avail == 0) {
+            return -1;
+        }
+        if (avail > n) {
+            avail = n;
+        }
+        memcpy(q, in->buf + in->pos, avail);
+        in->pos += avail;
+        q += avail;
+        n -= avail;
+    }
+    return 0;
+}
+
+/* next line without the newline in *line, grown as needed; -1 at the end or on error, which sets in->err */
+static long _read_line(struct import_in *in, char **line, size_t *cap)
+{
+    size_t n = 0, avail, chunk, size;
+    unsigned char *nl;
+    char *t;
+
+    while ((avail = _fill(in)) > 0) {
+        nl = (unsigned char *)memchr(in->buf + in->pos, '\n', avail);
+        chunk = nl ? (size_t)(nl - (in->buf + in->pos)) : avail;
+        if (n + chunk + 1 > *cap) {
+            size = *cap ? *cap * 2 : 4096;
+            while (size < n + chunk + 1) {
+                size *= 2;
+            }
+            if (size > IMPORT_MAX_RECORD) {
+                ERR("Line is too long");
+                in->err = 1;
+                return -1;
+            }
+            t = (char *)db_realloc(*line, size);
+            if (t == NULL) {
+                in->err = 1;
+                return -1;
+            }
+            *line = t;
+            *cap = size;
+        }
+        memcpy(*line + n, in->buf + in->pos, chunk);
+        n += chunk;
+        in->pos += chunk;
+        if (nl) {
+            in->pos++;
+            (*line)[n] = '\0';
+            return n;
+        }
+    }
+    if (n == 0) {
+        return -1;
+    }
+    (*line)[n] = '\0';
+    return n;
+}
+
+static void _rec_clear(struct import_rec *r)
+{
+    db_free(r->content);
+    db_free(r->comment);
+    db_free(r->doodle_path);
+    db_free(r->doodle_data);
+    memset(r, 0, sizeof(*r));
+    r->font_respect = 1;
+    r->font_size = 44;
+    r->font_color = 0xff000000;
+}
+
+/******************************
+* JSON lines
+*******************************/
+static const char *_ws(const char *p)
+{
+    while (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n') {
+        p++;
+    }
+    return p;
+}
+
+static int _hex4(const char *p)
+{
+    int i, c, v = 0;
+
+    for (i = 0; i < 4; i++) {
+        c = p[i];
+        if (c >= '0' && c <= '9') {
+            v = v * 16 + c - '0';
+        } else if (c >= 'a' && c <= 'f') {
+            v = v * 16 + c - 'a' + 10;
+        } else if (c >= 'A' && c <= 'F') {
+            v = v * 16 + c - 'A' + 10;
+        } else {
+            return -1;
+        }
+    }
+    return v;
+}
+
+static char *_utf8(char *q, unsigned int c)
+{
+    if (c < 0x80) {
+        *q++ = c;
+    } else if (c < 0x800) {
+        *q++ = 0xc0 | (c >> 6);
+        *q++ = 0x80 | (c & 0x3f);
+    } else if (c < 0x10000) {
+        *q++ = 0xe0 | (c >> 12);
+        *q++ = 0x80 | ((c >> 6) & 0x3f);
+        *q++ = 0x80 | (c & 0x3f);
+    } else {
+        *q++ = 0xf0 | (c >> 18);
+        *q++ = 0x80 | ((c >> 12) & 0x3f);
+        *q++ = 0x80 | ((c >> 6) & 0x3f);
+        *q++ = 0x80 | (c & 0x3f);
+    }
+    return q;
+}
+
+/* string at p, which points at the opening quote; returns the position after it */
+static const char *_json_str(const char *p, char **out)
+{
+    const char *e;
+    char *q;
+    int c, c2;
+
+    *out = NULL;
+    if (*p != '"') {
+        return NULL;
+    }
+    for (e = p + 1; *e && *e != '"'; e++) {
+        if (*e == '\\' && e[1]) {
+            e++;
+        }
+    }
+    if (*e != '"') {
+        return NULL;
+    }
+
+    /* unescaped text is never longer than escaped */
+    q = *out = (char *)db_malloc(e - p);
+    retv_if(q == NULL, NULL);
+    for (p = p + 1; p < e; p++) {
+        if (*p != '\\') {
+            *q++ = *p;
+            continue;
+        }
+        p++;
+        switch (*p) {
+        case 'n':
+            *q++ = '\n';
+            break;
+        case 'r':
+            *q++ = '\r';
+            break;
+        case 't':
+            *q++ = '\t';
+            break;
+        case 'b':
+            *q++ = '\b';
+            break;
+        case 'f':
+            *q++ = '\f';
+            break;
+        case 'u':
+            c = _hex4(p + 1);
+            if (c < 0) {
+                db_free(*out);
+                *out = NULL;
+                return NULL;
+            }
+            p += 4;
+            if (c >= 0xd800 && c < 0xdc00 && p[1] == '\\' && p[2] == 'u') {
+                c2 = _hex4(p + 3);
+                if (c2 >= 0xdc00 && c2 < 0xe000) {
+                    c = 0x10000 + ((c - 0xd800) << 10) + (c2 - 0xdc00);
+                    p += 6;
+                }
+            }
+            q = _utf8(q, c);
+            break;
+        default: /* '"', '\\' and '/' */
+            *q++ = *p;
+            break;
+        }
+    }
+    *q = '\0';
+    return e + 1;
+}
+
+static unsigned char *_base64_decode(const char *s, size_t *len)
+{
+    unsigned char *out, *q;
+    unsigned int v = 0;
+    int bits = 0, c;
+
+    out = q = (unsigned char *)db_malloc(strlen(s) / 4 * 3 + 3);
+    retv_if(out == NULL, NULL);
+    for (; *s && *s != '='; s++) {
+        if (*s >= 'A' && *s <= 'Z') {
+            c = *s - 'A';
+        } else if (*s >= 'a' && *s <= 'z') {
+            c = *s - 'a' + 26;
+        } else if (*s >= '0' && *s <= '9') {
+            c = *s - '0' + 52;
+        } else if (*s == '+') {
+            c = 62;
+        } else if (*s == '/') {
+            c = 63;
+        } else {
+            db_free(out);
+            return NULL;
+        }
+        v = (v << 6) | c;
+        bits += 6;
+        if (bits >= 8) {
+            bits -= 8;
+            *q++ = (v >> bits) & 0xff;
+        }
+    }
+    *len = q - out;
+    return out;
+}
+
+/* takes the ownership of val */
+static void _set_str(struct import_rec *r, const char *key, char *val)
+{
+    char **field = NULL;
+
+    if (strcmp(key, "content") == 0) {
+        field = &r->content;
+    } else if (strcmp(key, "comment") == 0) {
+        field = &r->comment;
+    } else if (strcmp(key, "doodle_path") == 0) {
+        field = &r->doodle_path;
+    } else if (strcmp(key, "doodle_data") == 0) {
+        db_free(r->doodle_data);
+        r->doodle_data = _base64_decode(val, &r->doodle_len);
+    }
+
+    if (field) {
+        db_free(*field);
+        *field = val;
+    } else {
+        db_free(val);
+    }
+}
+
+static void _set_num(struct import_rec *r, const char *key, long long val)
+{
+    if (strcmp(key, "id") == 0) {
+        r->id = val;
+    } else if (strcmp(key, "create_time") == 0) {
+        r->create_time = val;
+    } else if (strcmp(key, "modi_time") == 0) {
+        r->modi_time = val;
+    } else if (strcmp(key, "doodle") == 0) {
+        r->doodle = val;
+    } else if (strcmp(key, "color") == 0) {
+        r->color = val;
+    } else if (strcmp(key, "favorite") == 0) {
+        r->favorite = val;
+    } else if (strcmp(key, "font_respect") == 0) {
+        r->font_respect = val;
+    } else if (strcmp(key, "font_size") == 0) {
+        r->font_size = val;
+    } else if (strcmp(key, "font_color") == 0) {
+        r->font_color = (unsigned int)val;
+    }
+}
+
+/* flat object of strings, integers, booleans and nulls; unknown keys are ignored */
+static int _parse_json(const char *line, struct import_rec *r)
+{
+    const char *p = _ws(line);
+    char *key = NULL, *val = NULL, *end;
+    long long n;
+
+    if (*p != '{') {
+        return -1;
+    }
+    p = _ws(p + 1);
+    if (*p == '}') {
+        return 0;
+    }
+
+    while (1) {
+        p = _json_str(p, &key);
+        if (p == NULL) {
+            goto error;
+        }
+        p = _ws(p);
+        if (*p != ':') {
+            goto error;
+        }
+        p = _ws(p + 1);
+
+        if (*p == '"') {
+            p = _json_str(p, &val);
+            if (p == NULL) {
+                goto error;
+            }
+            _set_str(r, key, val);
+            val = NULL;
+        } else if (strncmp(p, "null", 4) == 0) {
+            p += 4;
+        } else if (strncmp(p, "true", 4) == 0) {
+            _set_num(r, key, 1);
+            p += 4;
+        } else if (strncmp(p, "false", 5) == 0) {
+            _set_num(r, key, 0);
+            p += 5;
+        } else {
+            n = strtoll(p, &end, 10);
+            if (end == p) {
+                goto error;
+            }
+            _set_num(r, key, n);
+            p = end;
+        }
+        db_free(key);
+        key = NULL;
+
+        p = _ws(p);
+        if (*p == ',') {
+            p = _ws(p + 1);
+        } else if (*p == '}') {
+            return 0;
+        } else {
+            goto error;
+        }
+    }
+
+error:
+    db_free(key);
+    db_free(val);
+    return -1;
+}
+
+/******************************
+* binary
+*******************************/
+static uint32_t _get_u32(const unsigned char *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static int _get_str(const unsigned char **p, const unsigned char *end, char **out, size_t *len)
+{
+    uint32_t n;
+
+    *out = NULL;
+    retv_if(end - *p < 4, -1);
+    n = _get_u32(*p);
+    *p += 4;
+    if (n == EXPORT_NULL_LEN) {
+        return 0;
+    }
+    retv_if((size_t)(end - *p) < n, -1);
+    *out = (char *)db_malloc(n + 1);
+    retv_if(*out == NULL, -1);
+    memcpy(*out, *p, n);
+    (*out)[n] = '\0';
+    *p += n;
+    if (len) {
+        *len = n;
+    }
+    return 0;
+}
+
+/* 1 : record read, 0 : end of the archive, -1 : corrupt */
+static int _read_binary(struct import_in *in, unsigned char **buf, size_t *cap, struct import_rec *r)
+{
+    unsigned char b[4];
+    const unsigned char *p, *end;
+    uint32_t len;
+    unsigned char *t;
+
+    retv_if(_read_exact(in, b, 4) == -1, -1);
+    len = _get_u32(b);
+    if (len == 0) {
+        return 0;
+    }
+    retvm_if(len < EXPORT_FIXED_LEN + 16 || len > IMPORT_MAX_RECORD, -1, "Invalid record length %u", len);
+    if (len > *cap) {
+        t = (unsigned char *)db_realloc(*buf, len);
+        retv_if(t == NULL, -1);
+        *buf = t;
+        *cap = len;
+    }
+    retv_if(_read_exact(in, *buf, len) == -1, -1);
+
+    p = *buf;
+    end = p + len;
+    r->id = (int)_get_u32(p);
+    r->create_time = (long long)(_get_u32(p + 4) | ((uint64_t)_get_u32(p + 8) << 32));
+    r->modi_time = (long long)(_get_u32(p + 12) | ((uint64_t)_get_u32(p + 16) << 32));
+    r->doodle = (int)_get_u32(p + 20);
+    r->color = (int)_get_u32(p + 24);
+    r->favorite = (int)_get_u32(p + 28);
+    r->font_respect = (int)_get_u32(p + 32);
+    r->font_size = (int)_get_u32(p + 36);
+    r->font_color = _get_u32(p + 40);
+    p += EXPORT_FIXED_LEN;
+
+    if (_get_str(&p, end, &r->content, NULL) == -1
+            || _get_str(&p, end, &r->comment, NULL) == -1
+            || _get_str(&p, end, &r->doodle_path, NULL) == -1
+            || _get_str(&p, end, (char **)&r->doodle_data, &r->doodle_len) == -1) {
+        ERR("Corrupt record %d", r->id);
+        return -1;
+    }
+    return 1;
+}
+
+/******************************
+* writing
+*******************************/
+/* packed under the rule of db_compress_make_constant, plain while compression is off */
+static void _bind_packed(sqlite3_stmt *stmt, int idx, const char *text, int len)
+{
+    unsigned char *packed = NULL;
+    int plen;
+    int threshold = db_compress_get_threshold();
+
+    if (text == NULL) {
+        sqlite3_bind_null(stmt, idx);
+        return;
+    }
+    if (threshold > 0 && len >= threshold) {
+        packed = db_compress_pack(text, len, &plen);
+    }
+    if (packed != NULL) {
+        sqlite3_bind_blob(stmt, idx, packed, plen, db_free);
+    } else {
+        sqlite3_bind_text(stmt, idx, text, len, SQLITE_STATIC);
+    }
+}
+
+/* file name the doodle of r is written as, NULL when it is not written */
+static const char *_doodle_base(struct import_ctx *ctx, struct import_rec *r)
+{
+    const char *base;
+
+    if (ctx->doodle_dir == NULL || r->doodle_data == NULL || r->doodle_path == NULL) {
+        return NULL;
+    }
+    base = strrchr(r->doodle_path, '/');
+    base = base ? base + 1 : r->doodle_path;
+    if (base[0] == '\0' || strcmp(base, ".") == 0 || strcmp(base, "..") == 0) {
+        return NULL;
+    }
+    return base;
+}
+
+/* write the doodle into doodle_dir without replacing any file, r->doodle_path is set to it */
+static void _store_doodle(struct import_ctx *ctx, struct import_rec *r)
+{
+    char tmp[PATH_MAX], dest[PATH_MAX];
+    const char *base = _doodle_base(ctx, r);
+    int fd, i, rc = -1;
+
+    if (base == NULL) {
+        return;
+    }
+
+    /* unique per call, so imports of other threads or processes into the same dir do not collide */
+    snprintf(tmp, sizeof(tmp), "%s/.import.XXXXXX", ctx->doodle_dir);
+    fd = mkstemp(tmp);
+    retm_if(fd < 0, "Can't create %s : %d", tmp, errno);
+    if (fchmod(fd, 0644) == 0 /* readable like doodles written by the app, mkstemp makes 0600 */
+            && write(fd, r->doodle_data, r->doodle_len) == (ssize_t)r->doodle_len) {
+        rc = 0;
+    }
+    close(fd);
+
+    /* link() fails on an existing name, so files of other memos are never replaced */
+    for (i = 0; rc == 0 && i < 100; i++) {
+        if (i == 0) {
+            snprintf(dest, sizeof(dest), "%s/%s", ctx->doodle_dir, base);
+        } else {
+            snprintf(dest, sizeof(dest), "%s/%d_%s", ctx->doodle_dir, i, base);
+        }
+        if (link(tmp, dest) == 0) {
+            db_free(r->doodle_path);
+            r->doodle_path = db_strdup(dest);
+            break;
+        }
+        if (errno != EEXIST) {
+            ERR("Can't create %s : %d", dest, errno);
+            break;
+        }
+    }
+    unlink(tmp);
+}
+
+/* id of a live memo with the same content, comment and doodle_path, 0 if none */
+static int _find_hash(struct import_ctx *ctx, int64_t hash)
+{
+    int id = 0;
+
+    sqlite3_reset(ctx->find_hash);
+    sqlite3_bind_int64(ctx->find_hash, 1, hash);
+    if (sqlite3_step(ctx->find_hash) == SQLITE_ROW) {
+        id = sqlite3_column_int(ctx->find_hash, 0);
+    }
+    sqlite3_reset(ctx->find_hash);
+    return id;
+}
+
+/* 1 : live, 0 : deleted, -1 : no such id */
+static int _find_id(struct import_ctx *ctx, int id, long long *modi_time)
+{
+    int state = -1;
+
+    sqlite3_reset(ctx->find_id);
+    sqlite3_bind_int(ctx->find_id, 1, id);
+    if (sqlite3_step(ctx->find_id) == SQLITE_ROW) {
+        *modi_time = sqlite3_column_int64(ctx->find_id, 0);
+        state = sqlite3_column_int64(ctx->find_id, 1) == -1;
+    }
+    sqlite3_reset(ctx->find_id);
+    return state;
+}
+
+/* 0 : done or skipped, -1 : db error */
+static int _import_rec(struct import_ctx *ctx, struct import_rec *r)
+{
+    sqlite3_stmt *stmt;
+    long long modi_time = 0;
+    int len = r->content ? strlen(r->content) : 0;
+    int preview_len = r->content ? db_content_preview_len(r->content) : 0;
+    char path[PATH_MAX];
+    const char *base = _doodle_base(ctx, r);
+    int64_t hash;
+    int state, replace = 0;
+    int id, rc;
+
+    /* the same memo is already there, e.g. an archive imported twice; compared with
+     * the path its doodle would be written to */
+    if (base) {
+        snprintf(path, sizeof(path), "%s/%s", ctx->doodle_dir, base);
+    }
+    hash = db_hash_memo(r->content, r->comment, base ? path : r->doodle_path);
+    if (_find_hash(ctx, hash) > 0) {
+        ctx->progress.skipped++;
+        return 0;
+    }
+
+    state = r->id > 0 ? _find_id(ctx, r->id, &modi_time) : -1;
+    if (state == 1) {
+        if (ctx->policy == MEMO_IMPORT_REPLACE) {
+            replace = 1;
+        } else if (ctx->policy == MEMO_IMPORT_KEEP_NEWER && r->modi_time > modi_time) {
+            replace = 1;
+        } else if (ctx->policy != MEMO_IMPORT_ADD_NEW) {
+            ctx->progress.skipped++;
+            return 0;
+        }
+    }
+
+    if (base) {
+        _store_doodle(ctx, r);
+        if (strcmp(r->doodle_path, path) != 0) { /* the name was taken */
+            hash = db_hash_memo(r->content, r->comment, r->doodle_path);
+        }
+    }
+
+    stmt = replace ? ctx->update : ctx->insert;
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+    _bind_packed(stmt, 1, r->content, preview_len);
+    sqlite3_bind_int64(stmt, 2, r->create_time > 0 ? r->create_time : ctx->now);
+    sqlite3_bind_int64(stmt, 3, ctx->now);
+    sqlite3_bind_int(stmt, 4, r->doodle);
+    sqlite3_bind_int(stmt, 5, r->color);
+    _bind_packed(stmt, 6, r->comment, r->comment ? strlen(r->comment) : 0);
+    sqlite3_bind_int(stmt, 7, r->favorite);
+    sqlite3_bind_int(stmt, 8, r->font_respect);
+    sqlite3_bind_int(stmt, 9, r->font_size);
+    sqlite3_bind_int64(stmt, 10, r->font_color);
+    if (r->doodle_path) {
+        sqlite3_bind_text(stmt, 11, r->doodle_path, -1, SQLITE_STATIC);
+    }
+    /* keep the id of the archive when it was never used here */
+    if (replace || (state == -1 && r->id > 0)) {
+        sqlite3_bind_int(stmt, 12, r->id);
+    }
+    sqlite3_bind_int64(stmt, 13, hash);
+    sqlite3_bind_int64(stmt, 14, db_now_utime());
+
+    rc = sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+    if (rc != SQLITE_DONE) {
+        ERR("Can't import memo %d : %s", r->id, sqlite3_errmsg(ctx->db));
+        return -1;
+    }
+
+    id = replace ? r->id : (int)sqlite3_last_insert_rowid(ctx->db);
+    if (replace || len > preview_len) {
+        retv_if(db_chunk_store(ctx->db, id, r->content + preview_len, len - preview_len) == -1, -1);
+    }
+
+    if (replace) {
+        ctx->progress.replaced++;
+    } else {
+        ctx->progress.inserted++;
+    }
+    return 0;
+}
+
+static int _prepare(struct import_ctx *ctx)
+{
+    sqlite3 *db = ctx->db;
+
+    if (sqlite3_prepare_v2(db, "select modi_time, delete_time from memo where id = ?",
+                -1, &ctx->find_id, NULL) != SQLITE_OK
+            || sqlite3_prepare_v2(db, "select id from memo where content_hash = ? and delete_time = -1 "
+                "limit 1", -1, &ctx->find_hash, NULL) != SQLITE_OK
+            || sqlite3_prepare_v2(db, "insert into memo (content, create_time, modi_time, delete_time, "
+                "doodle, color, comment, favorite, font_respect, font_size, font_color, doodle_path, id, "
+                "content_hash, create_utime, modi_utime, sort_key) values (?1, ?2, ?3, -1, ?4, ?5, ?6, ?7, "
+                "?8, ?9, ?10, ?11, ?12, ?13, ?2 * 1000000, " NEXT_UTIME_SQL("?14") ", "
+                MEMO_SORT_KEY_OF("?1", "?6") ")",
+                -1, &ctx->insert, NULL) != SQLITE_OK
+            || sqlite3_prepare_v2(db, "update memo set content = ?1, create_time = ?2, modi_time = ?3, "
+                "doodle = ?4, color = ?5, comment = ?6, favorite = ?7, font_respect = ?8, "
+                "font_size = ?9, font_color = ?10, doodle_path = ?11, content_hash = ?13, "
+                "create_utime = ?2 * 1000000, modi_utime = " NEXT_UTIME_SQL("?14") ", "
+                "sort_key = " MEMO_SORT_KEY_OF("?1", "?6") " where id = ?12",
+                -1, &ctx->update, NULL) != SQLITE_OK) {
+        ERR("SQL error : %s", sqlite3_errmsg(db));
+        return -1;
+    }
+    return 0;
+}
+
+static int _exec(sqlite3 *db, const char *query)
+{
+    char *errmsg = NULL;
+
+    if (sqlite3_exec(db, query, NULL, NULL, &errmsg) != SQLITE_OK) {
+        ERR("SQL error: %s", errmsg);
+        sqlite3_free(errmsg);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief     Import an archive written by db_export
+ *
+ * @return    the number of inserted and replaced memos or -1 (Failed)
+ */
+int db_import(sqlite3 *db, int fd, MEMO_IMPORT_POLICY policy, const char *doodle_dir,
+        memo_import_progress_cb cb, void *user_data)
+{
+    struct import_ctx ctx;
+    struct import_in *in;
+    struct import_rec r;
+    struct stat st;
+    char *line = NULL;
+    size_t cap = 0;
+    unsigned char *buf = NULL;
+    int binary = 0, in_batch = 0;
+    int rc = 0, more;
+
+    retvm_if(db == NULL, -1, "DB handler is null");
+    retvm_if(fd < 0, -1, "Invalid fd");
+    retvm_if(policy < MEMO_IMPORT_SKIP || policy > MEMO_IMPORT_ADD_NEW, -1, "Invalid policy : %d", policy);
+
+    in = (struct import_in *)db_calloc(1, sizeof(struct import_in));
+    retvm_if(in == NULL, -1, "calloc failed");
+    in->fd = fd;
+
+    memset(&ctx, 0, sizeof(ctx));
+    ctx.db = db;
+    ctx.policy = policy;
+    ctx.doodle_dir = doodle_dir;
+    ctx.now = time(NULL);
+    ctx.progress.bytes_total = (fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) ? st.st_size : -1;
+    memset(&r, 0, sizeof(r));
+    _rec_clear(&r);
+
+    if (_prepare(&ctx) == -1) {
+        rc = -1;
+        goto out;
+    }
+
+    if (_fill(in) >= 8 && memcmp(in->buf, EXPORT_MAGIC, 4) == 0) {
+        if (in->buf[4] != EXPORT_VERSION) {
+            ERR("Unknown archive version %d", in->buf[4]);
+            rc = -1;
+            goto out;
+        }
+        binary = 1;
+        in->pos = 8;
+    }
+
+    memo_begin_trans();
+    while (rc == 0) {
+        if (binary) {
+            more = _read_binary(in, &buf, &cap, &r);
+            if (more == -1) {
+                rc = -1;
+                break;
+            }
+        } else {
+            more = _read_line(in, &line, &cap) >= 0;
+            if (more && *_ws(line) == '\0') {
+                continue;
+            }
+            if (more && _parse_json(line, &r) == -1) {
+                ERR("Skip invalid line after %d memos", ctx.progress.processed);
+                ctx.progress.processed++;
+                ctx.progress.failed++;
+                _rec_clear(&r);
+                continue;
+            }
+        }
+        if (!more) {
+            break;
+        }
+
+        if (!in_batch) {
+            rc = _exec(db, "BEGIN IMMEDIATE");
+            if (rc == -1) {
+                break;
+            }
+            in_batch = 1;
+        }
+        rc = _import_rec(&ctx, &r);
+        ctx.progress.processed++;
+        _rec_clear(&r);
+
+        if (rc == 0 && ctx.progress.processed % IMPORT_BATCH == 0) {
+            rc = _exec(db, "COMMIT");
+            in_batch = 0;
+            ctx.progress.bytes_read = in->bytes;
+            if (rc == 0 && cb) {
+                cb(&ctx.progress, user_data);
+            }
+        }
+    }
+    if (in->err) {
+        rc = -1;
+    }
+    if (in_batch) {
+        if (rc == 0) {
+            rc = _exec(db, "COMMIT");
+        }
+        if (rc == -1) {
+            _exec(db, "ROLLBACK");
+        }
+    }
+    memo_end_trans();
+
+    ctx.progress.bytes_read = in->bytes;
+    if (cb) {
+        cb(&ctx.progress, user_data);
+    }
+
+out:
+    _rec_clear(&r);
+    sqlite3_finalize(ctx.find_id);
+    sqlite3_finalize(ctx.find_hash);
+    sqlite3_finalize(ctx.insert);
+    sqlite3_finalize(ctx.update);
+    db_free(line);
+    db_free(buf);
+    db_free(in);
+    retv_if(rc == -1, -1);
+    return ctx.progress.inserted + ctx.progress.replaced;
+}
@@ -0,0 +1,299 @@
+/*
+*
+* Copyright 2012  Samsung Electronics Co., Ltd
+*
+* Licensed under the Flora License, Version 1.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.tizenopensource.org/license
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+#include "memo-log.h"
+#include "db-match.h"
+#include "db-collate.h"
+#include "db-alloc.h"
+
+/*
+ * Substring search with the semantics of "text LIKE '%needle%'" : ASCII letters match
+ * either case, every other byte (UTF-8 included) must be equal. Each needle byte is kept
+ * as a value and a mask, (c | mask) == value. The mask is 0x20 for letters, which maps
+ * 'A' onto 'a' and nothing else onto 'a', and 0 for the other bytes.
+ *
+ * The vector paths test the first and the last needle byte at 16 positions at once and
+ * only compare the middle of the candidates (see "SIMD-friendly algorithms for substring
+ * searching", W. Mula).
+ *
+ * A needle with the LIKE wildcards % or _ is handed to sqlite3_strlike().
+ *
+ * A needle with cased letters outside ASCII ("É", "Ж") is folded, and so is every text
+ * that is not plain ASCII, see db_collate_fold. Other needles (Hangul for one) are
+ * matched byte for byte.
+ *
+ * So memo_contains() is exactly LIKE for needles without cased letters outside ASCII.
+ * For the others it matches a superset of LIKE: "é" also finds "É", "straße" finds
+ * "STRASSE", and a decomposed "e\u0301" finds the precomposed "é".
+ */
+struct db_match_needle {
+    int len;
+    int fold; /* match the folded text */
+    char *like; /* "%needle%" when needle has wildcards */
+    unsigned char *value;
+    unsigned char *mask;
+};
+
+struct db_match_needle *db_match_compile(const char *needle, int len)
+{
+    struct db_match_needle *n;
+    char *folded = NULL;
+    int fold = 0;
+    int i;
+
+    retv_if(needle == NULL, NULL);
+
+    if (memchr(needle, '%', len) == NULL && memchr(needle, '_', len) == NULL
+            && db_collate_need_fold(needle, len)) {
+        folded = db_collate_fold(needle, len, &len);
+        retv_if(folded == NULL, NULL);
+        needle = folded;
+        fold = 1;
+    }
+
+    n = (struct db_match_needle *)db_calloc(1, sizeof(struct db_match_needle) + len * 2);
+    if (n == NULL) {
+        db_free(folded);
+        return NULL;
+    }
+    n->len = len;
+    n->fold = fold;
+    n->value = (unsigned char *)(n + 1);
+    n->mask = n->value + len;
+    for (i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)needle[i];
+        if (c == '%' || c == '_') {
+            n->like = sqlite3_mprintf("%%%.*s%%", len, needle);
+            if (n->like == NULL) {
+                db_free(n);
+                return NULL;
+            }
+            break;
+        }
+        if ((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z')) {
+            n->value[i] = c | 0x20;
+            n->mask[i] = 0x20;
+        } else {
+            n->value[i] = c;
+        }
+    }
+    db_free(folded);
+    return n;
+}
+
+void db_match_free(struct db_match_needle *n)
+{
+    ret_if(n == NULL);
+    sqlite3_free(n->like);
+    db_free(n);
+}
+
+/* text[1..len-2] against the middle of the needle, the ends are already compared */
+static inline int _match_middle(const struct db_match_needle *n, const unsigned char *text)
+{
+    int i;
+
+    for (i = 1; i < n->len - 1; i++) {
+        if ((text[i] | n->mask[i]) != n->value[i]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static int _find_scalar(const struct db_match_needle *n, const unsigned char *text, int from, int len)
+{
+    const unsigned char first = n->value[0], first_mask = n->mask[0];
+    const unsigned char last = n->value[n->len - 1], last_mask = n->mask[n->len - 1];
+    int i;
+
+    for (i = from; i + n->len <= len; i++) {
+        if ((text[i] | first_mask) == first
+                && (text[i + n->len - 1] | last_mask) == last
+                && _match_middle(n, text + i)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+#if defined(__SSE2__)
+static int _find_vector(const struct db_match_needle *n, const unsigned char *text, int len, int *end)
+{
+    const __m128i first = _mm_set1_epi8((char)n->value[0]);
+    const __m128i first_mask = _mm_set1_epi8((char)n->mask[0]);
+    const __m128i last = _mm_set1_epi8((char)n->value[n->len - 1]);
+    const __m128i last_mask = _mm_set1_epi8((char)n->mask[n->len - 1]);
+    int i;
+
+    for (i = 0; i + n->len - 1 + 16 <= len; i += 16) {
+        __m128i a = _mm_loadu_si128((const __m128i *)(text + i));
+        __m128i b = _mm_loadu_si128((const __m128i *)(text + i + n->len - 1));
+        unsigned int bits = _mm_movemask_epi8(_mm_and_si128(
+                    _mm_cmpeq_epi8(_mm_or_si128(a, first_mask), first),
+                    _mm_cmpeq_epi8(_mm_or_si128(b, last_mask), last)));
+        while (bits) {
+            int pos = __builtin_ctz(bits);
+            if (_match_middle(n, text + i + pos)) {
+                return i + pos;
+            }
+            bits &= bits - 1;
+        }
+    }
+    *end = i;
+    return -1;
+}
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+static int _find_vector(const struct db_match_needle *n, const unsigned char *text, int len, int *end)
+{
+    const uint8x16_t first = vdupq_n_u8(n->value[0]);
+    const uint8x16_t first_mask = vdupq_n_u8(n->mask[0]);
+    const uint8x16_t last = vdupq_n_u8(n->value[n->len - 1]);
+    const uint8x16_t last_mask = vdupq_n_u8(n->mask[n->len - 1]);
+    int i;
+
+    for (i = 0; i + n->len - 1 + 16 <= len; i += 16) {
+        uint8x16_t a = vld1q_u8(text + i);
+        uint8x16_t b = vld1q_u8(text + i + n->len - 1);
+        uint8x16_t eq = vandq_u8(vceqq_u8(vorrq_u8(a, first_mask), first),
+                vceqq_u8(vorrq_u8(b, last_mask), last));
+        /* narrow to 4 bits per byte */
+        uint64_t bits = vget_lane_u64(vreinterpret_u64_u8(
+                    vshrn_n_u16(vreinterpretq_u16_u8(eq), 4)), 0);
+        while (bits) {
+            int pos = __builtin_ctzll(bits) >> 2;
+            if (_match_middle(n, text + i + pos)) {
+                return i + pos;
+            }
+            bits &= ~(0xfULL << (pos << 2));
+        }
+    }
+    *end = i;
+    return -1;
+}
+#else
+static int _find_vector(const struct db_match_needle *n, const unsigned char *text, int len, int *end)
+{
+    *end = 0;
+    return -1;
+}
+#endif
+
+static int _find(const struct db_match_needle *n, const unsigned char *text, int len)
+{
+    int end = 0;
+    int pos;
+
+    if (n->len == 0) {
+        return 0;
+    }
+    if (n->len > len) {
+        return -1;
+    }
+    pos = _find_vector(n, text, len, &end);
+    if (pos >= 0) {
+        return pos;
+    }
+    return _find_scalar(n, text, end, len);
+}
+
+static int _is_ascii(const unsigned char *text, int len)
+{
+    int i;
+
+    for (i = 0; i < len; i++) {
+        if (text[i] & 0x80) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/**
+ * @brief     Offset of the first match of n in text (in the folded text for a folded
+ *            needle), -1 when there is none
+ */
+int db_match_find(const struct db_match_needle *n, const char *text, int len)
+{
+    const unsigned char *t = (const unsigned char *)text;
+    char *folded;
+    int pos;
+
+    retv_if(n == NULL || text == NULL, -1);
+
+    if (n->like != NULL) {
+        return sqlite3_strlike(n->like, text, 0) == 0 ? 0 : -1;
+    }
+    if (n->fold && !_is_ascii(t, len)) {
+        folded = db_collate_fold(text, len, &len);
+        retv_if(folded == NULL, -1);
+        pos = _find(n, (const unsigned char *)folded, len);
+        db_free(folded);
+        return pos;
+    }
+    return _find(n, t, len);
+}
+
+/* memo_contains(text, needle), the compiled needle is kept for the statement */
+static void _contains_func(sqlite3_context *ctx, int argc, sqlite3_value **argv)
+{
+    struct db_match_needle *n;
+    const char *text;
+    int compiled = 0;
+
+    if (sqlite3_value_type(argv[0]) == SQLITE_NULL || sqlite3_value_type(argv[1]) == SQLITE_NULL) {
+        return; /* NULL, like LIKE */
+    }
+
+    n = (struct db_match_needle *)sqlite3_get_auxdata(ctx, 1);
+    if (n == NULL) {
+        const char *needle = (const char *)sqlite3_value_text(argv[1]);
+        n = db_match_compile(needle, sqlite3_value_bytes(argv[1]));
+        if (n == NULL) {
+            sqlite3_result_error_nomem(ctx);
+            return;
+        }
+        compiled = 1;
+    }
+
+    text = (const char *)sqlite3_value_text(argv[0]);
+    sqlite3_result_int(ctx, db_match_find(n, text, sqlite3_value_bytes(argv[0])) >= 0);
+
+    if (compiled) { /* frees n when it can not be kept */
+        sqlite3_set_auxdata(ctx, 1, n, (void (*)(void *))db_match_free);
+    }
+}
+
+int db_match_register(sqlite3 *db)
+{
+    int rc;
+
+    rc = sqlite3_create_function(db, MEMO_CONTAINS_FUNC, 2, SQLITE_UTF8 | SQLITE_DETERMINISTIC,
+            NULL, _contains_func, NULL, NULL);
+    retvm_if(rc != SQLITE_OK, -1, "Can't register %s : %s", MEMO_CONTAINS_FUNC, sqlite3_errmsg(db));
+    return 0;
+}
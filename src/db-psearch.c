@@ -0,0 +1,280 @@
+/*
+*
+* Copyright 2012  Samsung Electronics Co., Ltd
+*
+* Licensed under the Flora License, Version 1.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.tizenopensource.org/license
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#include "memo-log.h"
+#include "memo-db.h"
+#include "db-compress.h"
+#include "db-match.h"
+#include "db-stats.h"
+#include "db-export.h"
+#include "db-psearch.h"
+#include "db-alloc.h"
+
+/*
+ * Parallel search: the id range of the live memos is split into one shard per thread,
+ * each read by its own read-only connection (see db_export_open_reader, all of them are
+ * in a read transaction before the first row is read, so they see the same data).
+ * Every shard returns its own first offset + limit matches in sort order, which are
+ * merged here and the requested page is handed to the callback on the calling thread.
+ */
+
+struct psearch_row {
+    memo_data_t md;
+    int64_t key; /* sort value for the time orders */
+    void *blob; /* sort_key for the title orders */
+    int blob_len;
+};
+
+struct psearch_job {
+    pthread_t thread;
+    sqlite3 *db;
+    const char *query;
+    const char *search_str;
+    int lo;
+    int hi;
+    int rc;
+    struct psearch_row *rows;
+    int n_rows;
+};
+
+/* sort column and direction of each MEMO_SORT_TYPE */
+static const struct {
+    const char *column;
+    int desc;
+} sorts[MEMO_SORT_TYPES] = {
+    [MEMO_SORT_CREATE_TIME] = { "create_utime", 1 },
+    [MEMO_SORT_CREATE_TIME_ASC] = { "create_utime", 0 },
+    [MEMO_SORT_TITLE] = { "sort_key", 1 },
+    [MEMO_SORT_TITLE_ASC] = { "sort_key", 0 },
+    [MEMO_SORT_MODI_TIME] = { "modi_utime", 1 },
+    [MEMO_SORT_MODI_TIME_ASC] = { "modi_utime", 0 },
+};
+
+static char *_dup(const unsigned char *s)
+{
+    return s ? db_strdup((const char *)s) : NULL;
+}
+
+static void *_search_thread(void *data)
+{
+    struct psearch_job *job = (struct psearch_job *)data;
+    sqlite3_stmt *stmt = NULL;
+    struct psearch_row *r, *rows;
+    int cap = 0;
+    int rc;
+
+    job->rc = -1;
+    rc = sqlite3_prepare_v2(job->db, job->query, -1, &stmt, NULL);
+    retvm_if(rc != SQLITE_OK, NULL, "SQL error : %s", sqlite3_errmsg(job->db));
+    sqlite3_bind_text(stmt, 1, job->search_str, -1, SQLITE_STATIC);
+    sqlite3_bind_int(stmt, 2, job->lo);
+    sqlite3_bind_int(stmt, 3, job->hi);
+
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        if (job->n_rows == cap) {
+            cap = cap ? cap * 2 : 64;
+            rows = (struct psearch_row *)db_realloc(job->rows, sizeof(struct psearch_row) * cap);
+            if (rows == NULL) {
+                break;
+            }
+            job->rows = rows;
+        }
+        r = &job->rows[job->n_rows++];
+        memset(r, 0, sizeof(*r));
+        r->md.id = sqlite3_column_int(stmt, 0);
+        r->md.content = _dup(sqlite3_column_text(stmt, 1));
+        r->md.modi_time = sqlite3_column_int64(stmt, 2);
+        r->md.has_doodle = sqlite3_column_int(stmt, 3);
+        r->md.comment = _dup(sqlite3_column_text(stmt, 4));
+        r->md.font_respect = sqlite3_column_int(stmt, 5);
+        r->md.font_size = sqlite3_column_int(stmt, 6);
+        r->md.font_color = sqlite3_column_int(stmt, 7);
+        if (sqlite3_column_type(stmt, 8) == SQLITE_BLOB) {
+            r->blob_len = sqlite3_column_bytes(stmt, 8);
+            r->blob = db_malloc(r->blob_len);
+            if (r->blob != NULL) {
+                memcpy(r->blob, sqlite3_column_blob(stmt, 8), r->blob_len);
+            }
+        } else {
+            r->key = sqlite3_column_int64(stmt, 8);
+        }
+    }
+    sqlite3_finalize(stmt);
+    retvm_if(rc != SQLITE_DONE, NULL, "SQL error : %s", sqlite3_errmsg(job->db));
+    job->rc = 0;
+    return NULL;
+}
+
+/* order of the sort column then of the id, as in the shard queries */
+static int _cmp_row(MEMO_SORT_TYPE sort, const struct psearch_row *x, const struct psearch_row *y)
+{
+    int rc;
+
+    if (sort == MEMO_SORT_TITLE || sort == MEMO_SORT_TITLE_ASC) {
+        if (x->blob == NULL || y->blob == NULL) { /* NULL first, like sqlite */
+            rc = (x->blob != NULL) - (y->blob != NULL);
+        } else {
+            rc = memcmp(x->blob, y->blob, x->blob_len < y->blob_len ? x->blob_len : y->blob_len);
+            if (rc == 0) {
+                rc = x->blob_len - y->blob_len;
+            }
+        }
+    } else {
+        rc = x->key < y->key ? -1 : (x->key > y->key);
+    }
+    if (rc == 0) {
+        rc = x->md.id - y->md.id;
+    }
+    return sorts[sort].desc ? -rc : rc;
+}
+
+static void _free_rows(struct psearch_job *job)
+{
+    int i;
+
+    for (i = 0; i < job->n_rows; i++) {
+        db_free(job->rows[i].md.content);
+        db_free(job->rows[i].md.comment);
+        db_free(job->rows[i].blob);
+    }
+    db_free(job->rows);
+}
+
+/**
+ * @brief     memo_search_data over threads read connections, limit -1 for all matches
+ *
+ * @return    Return 0 (Success) or -1 (Failed)
+ */
+int db_search_parallel(sqlite3 *db, const char *search_str, int limit, int offset, MEMO_SORT_TYPE sort,
+        int threads, memo_data_iterate_cb_t cb, void *user_data)
+{
+    struct psearch_job jobs[PSEARCH_MAX_THREADS];
+    int heads[PSEARCH_MAX_THREADS] = { 0 };
+    sqlite3_stmt *stmt = NULL;
+    char query[1024];
+    const char *path;
+    int lo = 0, hi = -1;
+    int i, n, step, rc = 0;
+
+    retvm_if(db == NULL, -1, "DB handler is null");
+    retvm_if(search_str == NULL, -1, "search string is NULL");
+    retvm_if(cb == NULL, -1, "iterator callback is NULL");
+    retvm_if(offset < 0, -1, "Invalid offset");
+    if (sort < 0 || sort >= MEMO_SORT_TYPES) {
+        sort = MEMO_SORT_CREATE_TIME;
+    }
+    if (threads < 1) {
+        threads = 1;
+    } else if (threads > PSEARCH_MAX_THREADS) {
+        threads = PSEARCH_MAX_THREADS;
+    }
+    path = sqlite3_db_filename(db, "main");
+    retvm_if(path == NULL || path[0] == '\0', -1, "Parallel search needs a db file");
+
+    memset(jobs, 0, sizeof(jobs));
+    for (i = 0; i < threads; i++) {
+        jobs[i].db = db_export_open_reader(path);
+        if (jobs[i].db == NULL) {
+            rc = -1;
+            goto out;
+        }
+    }
+
+    if (sqlite3_prepare_v2(jobs[0].db, "select min(id), max(id) from memo where delete_time = -1",
+                -1, &stmt, NULL) == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW) {
+        lo = sqlite3_column_int(stmt, 0);
+        hi = sqlite3_column_int(stmt, 1);
+    }
+    sqlite3_finalize(stmt);
+    if (hi < lo) {
+        goto out; /* no memo */
+    }
+    if (threads > hi - lo + 1) {
+        threads = hi - lo + 1;
+    }
+
+    /* every shard may hold the whole page */
+    snprintf(query, sizeof(query),
+            "select id, " MEMO_UNPACK_FUNC "(content), modi_time, doodle, " MEMO_UNPACK_FUNC "(comment), "
+            "font_respect, font_size, font_color, %s from memo "
+            "where id between ?2 and ?3 and delete_time = -1 and " MEMO_CONTAINS_FUNC "(CASE WHEN comment "
+            "IS NOT NULL THEN " MEMO_UNPACK_FUNC "(comment) ELSE " MEMO_UNPACK_FUNC "(content) END, ?1) "
+            "order by %s %s, id %s limit %d",
+            sorts[sort].column, sorts[sort].column, sorts[sort].desc ? "DESC" : "ASC",
+            sorts[sort].desc ? "DESC" : "ASC", limit < 0 ? -1 : offset + limit);
+
+    step = (hi - lo) / threads + 1;
+    for (i = 0; i < threads; i++) {
+        jobs[i].query = query;
+        jobs[i].search_str = search_str;
+        jobs[i].lo = lo + i * step;
+        jobs[i].hi = i == threads - 1 ? hi : lo + (i + 1) * step - 1;
+        jobs[i].rc = -1;
+        if (i > 0 && pthread_create(&jobs[i].thread, NULL, _search_thread, &jobs[i]) != 0) {
+            ERR("Can't start search thread %d", i);
+            jobs[i].thread = 0;
+            rc = -1;
+        }
+    }
+    _search_thread(&jobs[0]); /* the calling thread takes the first shard */
+    for (i = 1; i < threads; i++) {
+        if (jobs[i].thread) {
+            pthread_join(jobs[i].thread, NULL);
+        }
+    }
+
+    for (i = 0; i < threads; i++) {
+        if (jobs[i].rc == -1) {
+            rc = -1;
+        }
+    }
+
+    /* merge the shards, each is already in sort order */
+    for (n = 0; rc == 0 && (limit < 0 || n < offset + limit); n++) {
+        struct psearch_row *best = NULL;
+        int from = -1;
+        for (i = 0; i < threads; i++) {
+            if (heads[i] < jobs[i].n_rows
+                    && (best == NULL || _cmp_row(sort, &jobs[i].rows[heads[i]], best) < 0)) {
+                best = &jobs[i].rows[heads[i]];
+                from = i;
+            }
+        }
+        if (best == NULL) {
+            break;
+        }
+        heads[from]++;
+        if (n >= offset) {
+            STAT_ROW(MEMO_STAT_SEARCH, &best->md);
+            cb(&best->md, user_data);
+        }
+    }
+
+out:
+    for (i = 0; i < PSEARCH_MAX_THREADS; i++) {
+        _free_rows(&jobs[i]);
+        db_export_close_reader(jobs[i].db);
+    }
+    return rc;
+}
@@ -0,0 +1,448 @@
+/*
+*
+* Copyright 2012  Samsung Electronics Co., Ltd
+*
+* Licensed under the Flora License, Version 1.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.tizenopensource.org/license
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+
+/*
+ * Read-only snapshot of the memo list for processes which only show ids, previews
+ * and time stamps (widgets, search indexers).
+ *
+ * File layout, host byte order:
+ *   struct snapshot_header
+ *   struct memo_snapshot_record[count]   ordered by create_time desc
+ *   string pool                          nul terminated previews
+ *
+ * The writer builds a temporary file next to <path>, syncs it and renames it over
+ * <path>, so a mapped snapshot is never modified; readers compare seq to notice a
+ * newer file. seq is the last modi_utime of the db, the same data gives the same seq
+ * whichever process writes it.
+ *
+ * Commits do not write the snapshot themselves: db_snapshot_request wakes a publisher
+ * thread which waits SNAPSHOT_DELAY_MS for more commits and writes one snapshot for all.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sqlite3.h>
+
+#include "memo-log.h"
+#include "memo-db.h"
+#include "db-compress.h"
+#include "db-snapshot.h"
+#include "db-alloc.h"
+
+#define SNAPSHOT_MAGIC      "MSNP"
+#define SNAPSHOT_VERSION    1
+
+/* preview length in characters, substr() of sqlite counts UTF-8 characters */
+#define SNAPSHOT_PREVIEW_CHARS  "64"
+
+/* commits within this delay share one snapshot */
+#define SNAPSHOT_DELAY_MS   200
+
+struct snapshot_header {
+    char magic[4];
+    uint32_t version;
+    uint64_t seq;
+    uint32_t count;
+    uint32_t record_size;
+    uint32_t pool_offset;
+    uint32_t pool_size;
+};
+
+struct memo_snapshot {
+    void *map;
+    size_t size;
+    const struct snapshot_header *hdr;
+    const struct memo_snapshot_record *records;
+    const char *pool;
+    char path[PATH_MAX];
+};
+
+static pthread_mutex_t publisher_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t publisher_work = PTHREAD_COND_INITIALIZER;
+static pthread_t publisher_thread;
+static int publisher_running = 0;
+static int publisher_stop = 0;
+static sqlite3 *pending_db = NULL;
+static char pending_path[PATH_MAX]; /* "" when no snapshot is pending */
+
+static int _read_header(int fd, struct snapshot_header *hdr)
+{
+    if (pread(fd, hdr, sizeof(*hdr), 0) != sizeof(*hdr)) {
+        return -1;
+    }
+    if (memcmp(hdr->magic, SNAPSHOT_MAGIC, sizeof(hdr->magic)) != 0
+            || hdr->version != SNAPSHOT_VERSION
+            || hdr->record_size != sizeof(struct memo_snapshot_record)) {
+        return -1;
+    }
+    return 0;
+}
+
+static uint64_t _current_seq(const char *path)
+{
+    struct snapshot_header hdr;
+    uint64_t seq = 0;
+    int fd;
+
+    fd = open(path, O_RDONLY);
+    if (fd >= 0) {
+        if (_read_header(fd, &hdr) == 0) {
+            seq = hdr.seq;
+        }
+        close(fd);
+    }
+    return seq;
+}
+
+static int _write_all(int fd, const void *buf, size_t len)
+{
+    const char *p = (const char *)buf;
+    ssize_t n;
+
+    while (len > 0) {
+        n = write(fd, p, len);
+        if (n < 0) {
+            return -1;
+        }
+        p += n;
+        len -= n;
+    }
+    return 0;
+}
+
+/**
+ * @brief     Write a new snapshot of all memos to path
+ *
+ * @return    Return 0 (Success) or -1 (Failed)
+ */
+int db_snapshot_publish(sqlite3 *db, const char *path)
+{
+    sqlite3_stmt *stmt = NULL;
+    struct snapshot_header hdr;
+    struct memo_snapshot_record *records = NULL, *r;
+    char *pool = NULL, *t;
+    int count = 0, capacity = 0;
+    size_t pool_size = 0, pool_capacity = 0;
+    const char *text;
+    int len, rc, fd;
+    sqlite3_int64 seq = 0;
+    char tmp[PATH_MAX];
+
+    retvm_if(db == NULL || path == NULL, -1, "Invalid argument");
+    retvm_if(snprintf(tmp, sizeof(tmp), "%s.XXXXXX", path) >= (int)sizeof(tmp), -1, "Too long path %s", path);
+
+    /* seq and records of the same read transaction */
+    rc = sqlite3_exec(db, "SAVEPOINT snapshot", NULL, NULL, NULL);
+    retvm_if(rc != SQLITE_OK, -1, "SQL error : %s", sqlite3_errmsg(db));
+    rc = sqlite3_prepare_v2(db, "select ifnull(max(modi_utime), 0) from memo", -1, &stmt, NULL);
+    if (rc == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW) {
+        seq = sqlite3_column_int64(stmt, 0);
+    } else {
+        ERR("SQL error : %s", sqlite3_errmsg(db));
+        goto error;
+    }
+    sqlite3_finalize(stmt);
+    stmt = NULL;
+
+    rc = sqlite3_prepare_v2(db, "select id, favorite, doodle, color, create_time, modi_time, "
+            "substr(CASE WHEN comment IS NOT NULL THEN " MEMO_UNPACK_FUNC "(comment) "
+            "ELSE " MEMO_UNPACK_FUNC "(content) END, 1, " SNAPSHOT_PREVIEW_CHARS ") "
+            "from memo where delete_time = -1 order by create_utime desc, id desc", -1, &stmt, NULL);
+    if (rc != SQLITE_OK) {
+        ERR("SQL error : %s", sqlite3_errmsg(db));
+        goto error;
+    }
+
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            r = (struct memo_snapshot_record *)db_realloc(records, capacity * sizeof(*records));
+            if (r == NULL) {
+                goto error;
+            }
+            records = r;
+        }
+        text = (const char *)sqlite3_column_text(stmt, 6);
+        len = text ? strlen(text) : 0;
+        if (pool_size + len + 1 > pool_capacity) {
+            pool_capacity = (pool_size + len + 1) * 2;
+            t = (char *)db_realloc(pool, pool_capacity);
+            if (t == NULL) {
+                goto error;
+            }
+            pool = t;
+        }
+
+        r = &records[count++];
+        memset(r, 0, sizeof(*r));
+        r->id = sqlite3_column_int(stmt, 0);
+        r->flags = (sqlite3_column_int(stmt, 1) ? MEMO_SNAPSHOT_FAVORITE : 0)
+            | (sqlite3_column_int(stmt, 2) ? MEMO_SNAPSHOT_DOODLE : 0);
+        r->color = sqlite3_column_int(stmt, 3);
+        r->create_time = sqlite3_column_int64(stmt, 4);
+        r->modi_time = sqlite3_column_int64(stmt, 5);
+        r->preview_offset = pool_size;
+        r->preview_len = len;
+        if (len > 0) {
+            memcpy(pool + pool_size, text, len);
+        }
+        pool_size += len;
+        pool[pool_size++] = '\0';
+    }
+    if (rc != SQLITE_DONE) {
+        ERR("SQL error : %s", sqlite3_errmsg(db));
+        goto error;
+    }
+    sqlite3_finalize(stmt);
+    stmt = NULL;
+    sqlite3_exec(db, "RELEASE snapshot", NULL, NULL, NULL);
+
+    memset(&hdr, 0, sizeof(hdr));
+    memcpy(hdr.magic, SNAPSHOT_MAGIC, sizeof(hdr.magic));
+    hdr.version = SNAPSHOT_VERSION;
+    hdr.seq = seq;
+    hdr.count = count;
+    hdr.record_size = sizeof(struct memo_snapshot_record);
+    hdr.pool_offset = sizeof(hdr) + count * sizeof(struct memo_snapshot_record);
+    hdr.pool_size = pool_size;
+
+    fd = mkstemp(tmp);
+    if (fd < 0) {
+        ERR("Can't create snapshot %s : %d", tmp, errno);
+        db_free(records);
+        db_free(pool);
+        return -1;
+    }
+    rc = fchmod(fd, 0640);
+    if (rc == 0) {
+        rc = _write_all(fd, &hdr, sizeof(hdr));
+    }
+    if (rc == 0 && count > 0) {
+        rc = _write_all(fd, records, count * sizeof(*records));
+    }
+    if (rc == 0 && pool_size > 0) {
+        rc = _write_all(fd, pool, pool_size);
+    }
+    /* the rename must not reach the disk before the data */
+    if (rc == 0) {
+        rc = fsync(fd);
+    }
+    if (close(fd) == -1) {
+        rc = -1;
+    }
+    if (rc == -1 || rename(tmp, path) == -1) {
+        ERR("Can't publish snapshot %s : %d", path, errno);
+        unlink(tmp);
+        db_free(records);
+        db_free(pool);
+        return -1;
+    }
+
+    db_free(records);
+    db_free(pool);
+    return 0;
+
+error:
+    sqlite3_finalize(stmt);
+    sqlite3_exec(db, "ROLLBACK TO snapshot; RELEASE snapshot", NULL, NULL, NULL);
+    db_free(records);
+    db_free(pool);
+    return -1;
+}
+
+static void *_publisher(void *data)
+{
+    struct timespec until;
+    char path[PATH_MAX];
+    sqlite3 *db;
+
+    pthread_mutex_lock(&publisher_lock);
+    while (1) {
+        while (pending_path[0] == '\0' && !publisher_stop) {
+            pthread_cond_wait(&publisher_work, &publisher_lock);
+        }
+        if (pending_path[0] == '\0') {
+            break;
+        }
+
+        /* let the commits of the next moment join this snapshot */
+        clock_gettime(CLOCK_REALTIME, &until);
+        until.tv_nsec += SNAPSHOT_DELAY_MS * 1000000L;
+        until.tv_sec += until.tv_nsec / 1000000000L;
+        until.tv_nsec %= 1000000000L;
+        while (!publisher_stop
+                && pthread_cond_timedwait(&publisher_work, &publisher_lock, &until) != ETIMEDOUT) {
+        }
+
+        db = pending_db;
+        memcpy(path, pending_path, sizeof(path));
+        pending_path[0] = '\0';
+        pthread_mutex_unlock(&publisher_lock);
+
+        db_snapshot_publish(db, path);
+
+        pthread_mutex_lock(&publisher_lock);
+    }
+    pthread_mutex_unlock(&publisher_lock);
+    return NULL;
+}
+
+/**
+ * @brief     Publish a snapshot of db to path shortly, after a commit
+ *
+ * @return    Return 0 (Success) or -1 (Failed)
+ *
+ * @remarks   db must stay open until db_snapshot_stop
+ */
+int db_snapshot_request(sqlite3 *db, const char *path)
+{
+    retvm_if(db == NULL || path == NULL, -1, "Invalid argument");
+    retvm_if(strlen(path) >= sizeof(pending_path), -1, "Too long path %s", path);
+
+    pthread_mutex_lock(&publisher_lock);
+    if (!publisher_running) {
+        if (pthread_create(&publisher_thread, NULL, _publisher, NULL) != 0) {
+            pthread_mutex_unlock(&publisher_lock);
+            ERR("Can't start snapshot publisher, publish %s now", path);
+            return db_snapshot_publish(db, path);
+        }
+        publisher_running = 1;
+    }
+    pending_db = db;
+    memcpy(pending_path, path, strlen(path) + 1);
+    pthread_cond_signal(&publisher_work);
+    pthread_mutex_unlock(&publisher_lock);
+    return 0;
+}
+
+/**
+ * @brief     Publish the pending snapshot at once and stop the publisher thread
+ */
+void db_snapshot_stop(void)
+{
+    pthread_mutex_lock(&publisher_lock);
+    if (!publisher_running) {
+        pthread_mutex_unlock(&publisher_lock);
+        return;
+    }
+    publisher_stop = 1;
+    pthread_cond_signal(&publisher_work);
+    pthread_mutex_unlock(&publisher_lock);
+
+    pthread_join(publisher_thread, NULL);
+
+    pthread_mutex_lock(&publisher_lock);
+    publisher_running = 0;
+    publisher_stop = 0;
+    pending_db = NULL;
+    pthread_mutex_unlock(&publisher_lock);
+}
+
+memo_snapshot_t *db_snapshot_open(const char *path)
+{
+    memo_snapshot_t *s;
+    struct stat st;
+    int fd;
+
+    retvm_if(path == NULL, NULL, "Invalid path");
+
+    fd = open(path, O_RDONLY);
+    retvm_if(fd < 0, NULL, "Can't open snapshot %s", path);
+    if (fstat(fd, &st) == -1 || st.st_size < (off_t)sizeof(struct snapshot_header)) {
+        close(fd);
+        return NULL;
+    }
+
+    s = (memo_snapshot_t *)db_calloc(1, sizeof(memo_snapshot_t));
+    if (s == NULL) {
+        close(fd);
+        return NULL;
+    }
+    s->size = st.st_size;
+    s->map = mmap(NULL, s->size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (s->map == MAP_FAILED) {
+        ERR("Can't map snapshot %s", path);
+        db_free(s);
+        return NULL;
+    }
+
+    s->hdr = (const struct snapshot_header *)s->map;
+    if (memcmp(s->hdr->magic, SNAPSHOT_MAGIC, sizeof(s->hdr->magic)) != 0
+            || s->hdr->version != SNAPSHOT_VERSION
+            || s->hdr->record_size != sizeof(struct memo_snapshot_record)
+            || s->hdr->pool_offset != sizeof(struct snapshot_header) + (size_t)s->hdr->count * sizeof(struct memo_snapshot_record)
+            || (size_t)s->hdr->pool_offset + s->hdr->pool_size > s->size) {
+        ERR("Invalid snapshot %s", path);
+        db_snapshot_close(s);
+        return NULL;
+    }
+    s->records = (const struct memo_snapshot_record *)((const char *)s->map + sizeof(struct snapshot_header));
+    s->pool = (const char *)s->map + s->hdr->pool_offset;
+    snprintf(s->path, sizeof(s->path), "%s", path);
+    return s;
+}
+
+void db_snapshot_close(memo_snapshot_t *s)
+{
+    ret_if(s == NULL);
+
+    munmap(s->map, s->size);
+    db_free(s);
+}
+
+int db_snapshot_count(memo_snapshot_t *s)
+{
+    retv_if(s == NULL, -1);
+    return s->hdr->count;
+}
+
+unsigned long long db_snapshot_seq(memo_snapshot_t *s)
+{
+    retv_if(s == NULL, 0);
+    return s->hdr->seq;
+}
+
+const struct memo_snapshot_record *db_snapshot_record(memo_snapshot_t *s, int index)
+{
+    retv_if(s == NULL, NULL);
+    retv_if(index < 0 || index >= (int)s->hdr->count, NULL);
+    return &s->records[index];
+}
+
+const char *db_snapshot_preview(memo_snapshot_t *s, const struct memo_snapshot_record *r)
+{
+    retv_if(s == NULL || r == NULL, NULL);
+    retv_if((size_t)r->preview_offset + r->preview_len >= s->hdr->pool_size, NULL);
+    return s->pool + r->preview_offset;
+}
+
+int db_snapshot_is_stale(memo_snapshot_t *s)
+{
+    retv_if(s == NULL, 1);
+    return _current_seq(s->path) != s->hdr->seq;
+}
@@ -0,0 +1,212 @@
+/*
+*
+* Copyright 2012  Samsung Electronics Co., Ltd
+*
+* Licensed under the Flora License, Version 1.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.tizenopensource.org/license
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sqlite3.h>
+
+#include "memo-log.h"
+#include "memo-db.h"
+#include "db-stats.h"
+
+int db_stats_enabled = 0;
+
+/* counters are updated by any thread calling the library */
+static pthread_mutex_t stats_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct memo_stats stats;
+static int dump_interval = 0; /* seconds, 0 : never */
+static unsigned long long last_dump = 0;
+
+static const char *op_names[MEMO_STAT_OPS] = {
+    "insert", "update", "delete", "get", "list", "search", "count",
+};
+
+/* monotonic time in usec */
+unsigned long long db_stats_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int _bucket(unsigned long long usec)
+{
+    int b = 0;
+
+    while (usec > 0 && b < MEMO_STAT_HIST_BUCKETS - 1) {
+        usec >>= 1;
+        b++;
+    }
+    return b;
+}
+
+/* logs a copy, not to hold stats_lock while logging */
+static void _dump(const struct memo_stats *stats)
+{
+    int i;
+    const struct memo_op_stats *o;
+
+    for (i = 0; i < MEMO_STAT_OPS; i++) {
+        o = &stats->op[i];
+        if (o->calls == 0) {
+            continue;
+        }
+        INFO("[stats] %s calls %llu errors %llu avg %lluus max %lluus rows %llu bytes %llu",
+                op_names[i], o->calls, o->errors, o->total_usec / o->calls, o->max_usec, o->rows, o->bytes);
+    }
+    INFO("[stats] transactions %llu notifications %llu", stats->transactions, stats->notifications);
+    if (stats->busy_waits > 0) {
+        INFO("[stats] lock waits %llu retries %llu waited %lluus timeouts %llu",
+                stats->busy_waits, stats->busy_retries, stats->busy_usec, stats->busy_timeouts);
+    }
+}
+
+/**
+ * @remarks   The dump is written by the first call after the interval, an idle
+ *            process logs nothing
+ */
+void db_stats_op(MEMO_STAT_OP op, unsigned long long start, int failed)
+{
+    unsigned long long now, usec;
+    struct memo_op_stats *o;
+    struct memo_stats copy;
+    int dump = 0;
+
+    ret_if(op < 0 || op >= MEMO_STAT_OPS);
+    ret_if(start == 0); /* enabled during the call */
+
+    now = db_stats_now();
+    usec = now - start;
+    pthread_mutex_lock(&stats_lock);
+    o = &stats.op[op];
+    o->calls++;
+    if (failed) {
+        o->errors++;
+    }
+    o->total_usec += usec;
+    if (usec > o->max_usec) {
+        o->max_usec = usec;
+    }
+    o->hist[_bucket(usec)]++;
+
+    if (dump_interval > 0 && now - last_dump >= (unsigned long long)dump_interval * 1000000) {
+        last_dump = now;
+        copy = stats;
+        dump = 1;
+    }
+    pthread_mutex_unlock(&stats_lock);
+
+    if (dump) {
+        _dump(&copy);
+    }
+}
+
+void db_stats_rows(MEMO_STAT_OP op, int rows, unsigned long long bytes)
+{
+    ret_if(op < 0 || op >= MEMO_STAT_OPS);
+
+    pthread_mutex_lock(&stats_lock);
+    stats.op[op].rows += rows;
+    stats.op[op].bytes += bytes;
+    pthread_mutex_unlock(&stats_lock);
+}
+
+void db_stats_trans(int notified)
+{
+    if (!db_stats_enabled) {
+        return;
+    }
+    pthread_mutex_lock(&stats_lock);
+    stats.transactions++;
+    if (notified) {
+        stats.notifications++;
+    }
+    pthread_mutex_unlock(&stats_lock);
+}
+
+/* called by the busy handler for each retry, first is set for the first one of a lock wait */
+void db_stats_busy(int first, unsigned long long usec, int timed_out)
+{
+    pthread_mutex_lock(&stats_lock);
+    if (first) {
+        stats.busy_waits++;
+    }
+    if (timed_out) {
+        stats.busy_timeouts++;
+    } else {
+        stats.busy_retries++;
+        stats.busy_usec += usec;
+    }
+    pthread_mutex_unlock(&stats_lock);
+}
+
+void db_stats_enable(int enable)
+{
+    pthread_mutex_lock(&stats_lock);
+    db_stats_enabled = enable ? 1 : 0;
+    if (db_stats_enabled) {
+        last_dump = db_stats_now();
+    }
+    pthread_mutex_unlock(&stats_lock);
+}
+
+void db_stats_get(sqlite3 *db, struct memo_stats *out)
+{
+    int cur, hiwtr;
+
+    pthread_mutex_lock(&stats_lock);
+    *out = stats;
+    pthread_mutex_unlock(&stats_lock);
+    out->cache_hit = out->cache_miss = out->cache_used = 0;
+    if (db == NULL) {
+        return;
+    }
+    if (sqlite3_db_status(db, SQLITE_DBSTATUS_CACHE_HIT, &cur, &hiwtr, 0) == SQLITE_OK) {
+        out->cache_hit = cur;
+    }
+    if (sqlite3_db_status(db, SQLITE_DBSTATUS_CACHE_MISS, &cur, &hiwtr, 0) == SQLITE_OK) {
+        out->cache_miss = cur;
+    }
+    if (sqlite3_db_status(db, SQLITE_DBSTATUS_CACHE_USED, &cur, &hiwtr, 0) == SQLITE_OK) {
+        out->cache_used = cur;
+    }
+}
+
+void db_stats_reset(sqlite3 *db)
+{
+    int cur, hiwtr;
+
+    pthread_mutex_lock(&stats_lock);
+    memset(&stats, 0, sizeof(stats));
+    pthread_mutex_unlock(&stats_lock);
+    if (db != NULL) { /* page cache counters are kept by sqlite, reset them too */
+        sqlite3_db_status(db, SQLITE_DBSTATUS_CACHE_HIT, &cur, &hiwtr, 1);
+        sqlite3_db_status(db, SQLITE_DBSTATUS_CACHE_MISS, &cur, &hiwtr, 1);
+    }
+}
+
+void db_stats_set_dump_interval(int seconds)
+{
+    pthread_mutex_lock(&stats_lock);
+    dump_interval = seconds > 0 ? seconds : 0;
+    last_dump = db_stats_now();
+    pthread_mutex_unlock(&stats_lock);
+}
@@ -0,0 +1,312 @@
+/*
+*
+* Copyright 2012  Samsung Electronics Co., Ltd
+*
+* Licensed under the Flora License, Version 1.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.tizenopensource.org/license
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+
+/*
+ * Doodle thumbnails: MEMO_THUMB_WIDTH x MEMO_THUMB_HEIGHT RGBA pixels, the
+ * doodle scaled to fit and centered on a transparent background.
+ *
+ * They are built when a memo with doodle_path is written and stored in
+ * memo_thumb with the modi_utime of the memo; a thumbnail whose modi_time
+ * differs from it is stale and rebuilt on the next read.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <png.h>
+
+#include "memo-log.h"
+#include "memo-db.h"
+#include "db-thumb.h"
+#include "db-alloc.h"
+
+#define THUMB_LEN (MEMO_THUMB_WIDTH * MEMO_THUMB_HEIGHT * 4)
+
+/* box filter, colors weighted by alpha so transparent pixels do not darken edges */
+static void _scale(const unsigned char *src, int sw, int sh, unsigned char *dst)
+{
+    int tw, th, ox, oy;
+    int x, y, sx, sy, x0, x1, y0, y1;
+    unsigned long r, g, b, a, n;
+    const unsigned char *p;
+    unsigned char *q;
+
+    /* fit, keeping the aspect ratio */
+    if ((long)sw * MEMO_THUMB_HEIGHT >= (long)sh * MEMO_THUMB_WIDTH) {
+        tw = MEMO_THUMB_WIDTH;
+        th = (int)((long)sh * MEMO_THUMB_WIDTH / sw);
+    } else {
+        th = MEMO_THUMB_HEIGHT;
+        tw = (int)((long)sw * MEMO_THUMB_HEIGHT / sh);
+    }
+    if (tw < 1) {
+        tw = 1;
+    }
+    if (th < 1) {
+        th = 1;
+    }
+    ox = (MEMO_THUMB_WIDTH - tw) / 2;
+    oy = (MEMO_THUMB_HEIGHT - th) / 2;
+
+    memset(dst, 0, THUMB_LEN);
+    for (y = 0; y < th; y++) {
+        y0 = (int)((long)y * sh / th);
+        y1 = (int)((long)(y + 1) * sh / th);
+        if (y1 <= y0) {
+            y1 = y0 + 1;
+        }
+        for (x = 0; x < tw; x++) {
+            x0 = (int)((long)x * sw / tw);
+            x1 = (int)((long)(x + 1) * sw / tw);
+            if (x1 <= x0) {
+                x1 = x0 + 1;
+            }
+
+            r = g = b = a = n = 0;
+            for (sy = y0; sy < y1; sy++) {
+                p = src + ((long)sy * sw + x0) * 4;
+                for (sx = x0; sx < x1; sx++, p += 4) {
+                    r += p[0] * p[3];
+                    g += p[1] * p[3];
+                    b += p[2] * p[3];
+                    a += p[3];
+                    n++;
+                }
+            }
+
+            q = dst + ((long)(y + oy) * MEMO_THUMB_WIDTH + x + ox) * 4;
+            if (a > 0) {
+                q[0] = r / a;
+                q[1] = g / a;
+                q[2] = b / a;
+                q[3] = a / n;
+            }
+        }
+    }
+}
+
+/* libpng and its zlib allocate through the library allocator, see memo_set_allocator */
+static png_voidp _png_malloc(png_structp png, png_alloc_size_t size)
+{
+    return db_malloc(size);
+}
+
+static void _png_free(png_structp png, png_voidp ptr)
+{
+    db_free(ptr);
+}
+
+static void _png_error(png_structp png, png_const_charp msg)
+{
+    ERR("Can't decode doodle : %s", msg);
+    png_longjmp(png, 1);
+}
+
+static void _png_warning(png_structp png, png_const_charp msg)
+{
+    DBG("Doodle : %s", msg);
+}
+
+/* decode the doodle to 8 bit RGBA, *width and *height receive its size */
+static unsigned char *_read_png(FILE *fp, const char *path, png_uint_32 *width, png_uint_32 *height)
+{
+    png_structp png;
+    png_infop info = NULL;
+    unsigned char *volatile pixels = NULL;
+    png_bytep *volatile rows = NULL;
+    png_uint_32 y;
+
+    png = png_create_read_struct_2(PNG_LIBPNG_VER_STRING, NULL, _png_error, _png_warning,
+            NULL, _png_malloc, _png_free);
+    retvm_if(png == NULL, NULL, "Can't read doodle %s", path);
+    info = png_create_info_struct(png);
+    if (info == NULL || setjmp(png_jmpbuf(png))) {
+        png_destroy_read_struct(&png, &info, NULL);
+        db_free(rows);
+        db_free(pixels);
+        return NULL;
+    }
+
+    png_init_io(png, fp);
+    png_read_info(png, info);
+    *width = png_get_image_width(png, info);
+    *height = png_get_image_height(png, info);
+    if (*width == 0 || *height == 0 || (unsigned long)*width * *height > THUMB_MAX_SOURCE_PIXELS) {
+        ERR("Doodle %s is too large : %ux%u", path, (unsigned int)*width, (unsigned int)*height);
+        png_longjmp(png, 1);
+    }
+
+    /* any bit depth and color type to RGBA */
+    png_set_expand(png);
+    png_set_scale_16(png);
+    png_set_gray_to_rgb(png);
+    png_set_add_alpha(png, 0xff, PNG_FILLER_AFTER);
+    png_set_interlace_handling(png);
+    png_read_update_info(png, info);
+
+    pixels = (unsigned char *)db_malloc((size_t)*width * *height * 4);
+    rows = (png_bytep *)db_malloc(sizeof(png_bytep) * *height);
+    if (pixels == NULL || rows == NULL) {
+        png_error(png, "out of memory");
+    }
+    for (y = 0; y < *height; y++) {
+        rows[y] = pixels + (size_t)y * *width * 4;
+    }
+    png_read_image(png, rows);
+    png_read_end(png, NULL);
+
+    png_destroy_read_struct(&png, &info, NULL);
+    db_free(rows);
+    return pixels;
+}
+
+static unsigned char *_make_thumb(const char *path)
+{
+    FILE *fp;
+    png_uint_32 width = 0, height = 0;
+    unsigned char *pixels, *thumb;
+
+    fp = fopen(path, "rb");
+    retvm_if(fp == NULL, NULL, "Can't read doodle %s", path);
+    pixels = _read_png(fp, path, &width, &height);
+    fclose(fp);
+    retv_if(pixels == NULL, NULL);
+
+    thumb = (unsigned char *)db_malloc(THUMB_LEN);
+    if (thumb != NULL) {
+        _scale(pixels, width, height, thumb);
+    }
+    db_free(pixels);
+    return thumb;
+}
+
+/**
+ * @brief     Build the thumbnail of a memo from its doodle file
+ *
+ * @return    Return 0 (Success) or -1 (Failed)
+ */
+int db_thumb_update(sqlite3 *db, int id, const char *path)
+{
+    sqlite3_stmt *stmt = NULL;
+    unsigned char *thumb;
+    int rc;
+
+    retvm_if(db == NULL, -1, "DB handler is null");
+    retv_if(path == NULL || path[0] == '\0', -1);
+
+    /* decode before touching the db, so no lock is held meanwhile */
+    thumb = _make_thumb(path);
+    retv_if(thumb == NULL, -1);
+
+    rc = sqlite3_prepare_v2(db, "insert or replace into memo_thumb (memo_id, modi_time, data) "
+            "select id, modi_utime, ? from memo where id = ?", -1, &stmt, NULL);
+    if (rc != SQLITE_OK) {
+        ERR("SQL error : %s", sqlite3_errmsg(db));
+        db_free(thumb);
+        return -1;
+    }
+    sqlite3_bind_blob(stmt, 1, thumb, THUMB_LEN, db_free);
+    sqlite3_bind_int(stmt, 2, id);
+    rc = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+    retvm_if(rc != SQLITE_DONE, -1, "SQL error : %s", sqlite3_errmsg(db));
+    return 0;
+}
+
+int db_thumb_clear(sqlite3 *db, int id)
+{
+    char query[64];
+
+    retvm_if(db == NULL, -1, "DB handler is null");
+
+    snprintf(query, sizeof(query), "delete from memo_thumb where memo_id = %d", id);
+    return sqlite3_exec(db, query, NULL, NULL, NULL) == SQLITE_OK ? 0 : -1;
+}
+
+/* 1 : thumbnail is current, 0 : stale or missing, -1 : no doodle or error */
+static int _lookup(sqlite3 *db, int id, char **path)
+{
+    sqlite3_stmt *stmt = NULL;
+    const char *p;
+    int rc;
+
+    *path = NULL;
+    rc = sqlite3_prepare_v2(db, "select m.doodle_path, t.modi_time = m.modi_utime "
+            "from memo m left join memo_thumb t on t.memo_id = m.id "
+            "where m.id = ? and m.delete_time = -1", -1, &stmt, NULL);
+    retvm_if(rc != SQLITE_OK, -1, "SQL error : %s", sqlite3_errmsg(db));
+    sqlite3_bind_int(stmt, 1, id);
+
+    rc = -1;
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        p = (const char *)sqlite3_column_text(stmt, 0);
+        if (sqlite3_column_int(stmt, 1)) {
+            rc = 1;
+        } else if (p != NULL && p[0] != '\0') {
+            *path = db_strdup(p);
+            rc = *path ? 0 : -1;
+        }
+    }
+    sqlite3_finalize(stmt);
+    return rc;
+}
+
+/**
+ * @brief     Get the thumbnail of a memo, rebuilding it when stale
+ *
+ * @remarks   The pixels are read straight from the blob into the returned buffer
+ *
+ * @return    Return 0 (Success) or -1 (Failed)
+ */
+int db_thumb_get(sqlite3 *db, int id, unsigned char **buf, int *len)
+{
+    sqlite3_blob *blob = NULL;
+    unsigned char *data;
+    char *path = NULL;
+    int rc;
+
+    retvm_if(db == NULL, -1, "DB handler is null");
+    retvm_if(buf == NULL || len == NULL, -1, "Invalid argument");
+
+    rc = _lookup(db, id, &path);
+    if (rc == 0) {
+        rc = db_thumb_update(db, id, path) == 0 ? 1 : -1;
+    }
+    db_free(path);
+    retv_if(rc == -1, -1);
+
+    rc = sqlite3_blob_open(db, "main", "memo_thumb", "data", id, 0, &blob);
+    retvm_if(rc != SQLITE_OK, -1, "Can't open thumbnail %d : %s", id, sqlite3_errmsg(db));
+    if (sqlite3_blob_bytes(blob) != THUMB_LEN) {
+        sqlite3_blob_close(blob);
+        ERR("Invalid thumbnail %d", id);
+        return -1;
+    }
+
+    data = (unsigned char *)db_malloc(THUMB_LEN);
+    if (data == NULL || sqlite3_blob_read(blob, data, THUMB_LEN, 0) != SQLITE_OK) {
+        sqlite3_blob_close(blob);
+        db_free(data);
+        return -1;
+    }
+    sqlite3_blob_close(blob);
+
+    *buf = data;
+    *len = THUMB_LEN;
+    return 0;
+}
@@ -17,6 +17,8 @@
 */
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
 #include <time.h>
 #include <fcntl.h>
 #include <sqlite3.h>
@@ -26,17 +28,39 @@
 #include "db-schema.h"
 #include "db.h"
 #include "db-helper.h"
+#include "db-compress.h"
+#include "db-chunk.h"
+#include "db-doodle.h"
+#include "db-thumb.h"
+#include "db-stats.h"
+#include "db-hash.h"
+#include "db-match.h"
+#include "db-collate.h"
+#include "db-busy.h"
+#include "db-alloc.h"
+#include "db-budget.h"
 
 #define QUERY_MAXLEN        5120
 #define NFS_TEST
 
 #define TEXT(s, n) (char *)sqlite3_column_text(s, n)
 #define INT(s, n) sqlite3_column_int(s, n)
+#define INT64(s, n) sqlite3_column_int64(s, n)
+
+/* content and comment may be packed, see db-compress.c */
+#define COL_CONTENT MEMO_UNPACK_FUNC "(content)"
+#define COL_COMMENT MEMO_UNPACK_FUNC "(comment)"
 
 static char* _d(char *str)
 {
     if(str == NULL /*|| strlen(str) == 0*/) return NULL;
-    return strdup(str);
+    return db_strdup(str);
+}
+
+/* bytes of a string held in a list, see db_budget_list_over */
+static size_t _s_len(const char *str)
+{
+    return str == NULL ? 0 : strlen(str) + 1;
 }
 
 static int _exec(sqlite3 *db, char *query)
@@ -56,134 +80,603 @@ static int _exec(sqlite3 *db, char *query)
     return 0;
 }
 
+static int _get_user_version(sqlite3 *db)
+{
+    int rc;
+    int version = -1;
+    sqlite3_stmt *stmt = NULL;
+
+    rc = sqlite3_prepare(db, "PRAGMA user_version", -1, &stmt, NULL);
+    if (SQLITE_OK != rc || NULL == stmt) {
+        ERR("SQL error\n");
+        sqlite3_finalize(stmt);
+        return -1;
+    }
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        version = INT(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    return version;
+}
+
+static int _has_column(sqlite3 *db, const char *table, const char *column)
+{
+    char query[64];
+    sqlite3_stmt *stmt = NULL;
+    int found = 0;
+
+    snprintf(query, sizeof(query), "PRAGMA table_info(%s)", table);
+    retvm_if(sqlite3_prepare_v2(db, query, -1, &stmt, NULL) != SQLITE_OK, -1,
+            "SQL error : %s", sqlite3_errmsg(db));
+    while (!found && sqlite3_step(stmt) == SQLITE_ROW) {
+        found = TEXT(stmt, 1) && strcmp(TEXT(stmt, 1), column) == 0;
+    }
+    sqlite3_finalize(stmt);
+    return found;
+}
+
+static int _add_column(sqlite3 *db, const char *table, const char *column, const char *type)
+{
+    char query[128];
+    int rc;
+
+    rc = _has_column(db, table, column);
+    retv_if(rc != 0, rc == 1 ? 0 : -1);
+    snprintf(query, sizeof(query), "ALTER TABLE %s ADD COLUMN %s %s", table, column, type);
+    return _exec(db, query);
+}
+
+/* content_hash of memos written before the column existed */
+static int _fill_content_hash(sqlite3 *db)
+{
+    sqlite3_stmt *stmt = NULL, *update = NULL;
+    char *content;
+    int id, rc = 0;
+
+    if (sqlite3_prepare_v2(db, "select id, " COL_CONTENT ", " COL_COMMENT ", doodle_path from memo "
+                "where content_hash is null and delete_time = -1", -1, &stmt, NULL) != SQLITE_OK
+            || sqlite3_prepare_v2(db, "update memo set content_hash = ? where id = ?",
+                -1, &update, NULL) != SQLITE_OK) {
+        ERR("SQL error : %s", sqlite3_errmsg(db));
+        sqlite3_finalize(stmt);
+        return -1;
+    }
+
+    while (rc == 0 && sqlite3_step(stmt) == SQLITE_ROW) {
+        id = INT(stmt, 0);
+        content = _d(TEXT(stmt, 1));
+        if (content != NULL && strlen(content) >= MEMO_DB_MAX_CONTENT_LEN - 3) {
+            content = db_chunk_join(db, id, content);
+        }
+        sqlite3_bind_int64(update, 1, db_hash_memo(content, TEXT(stmt, 2), TEXT(stmt, 3)));
+        sqlite3_bind_int(update, 2, id);
+        if (sqlite3_step(update) != SQLITE_DONE) {
+            ERR("SQL error : %s", sqlite3_errmsg(db));
+            rc = -1;
+        }
+        sqlite3_reset(update);
+        db_free(content);
+    }
+    sqlite3_finalize(stmt);
+    sqlite3_finalize(update);
+    return rc;
+}
+
 static int _create_table(sqlite3 *db)
 {
     int rc;
+    char query[64];
 
-    rc = _exec(db, CREATE_MEMO_TABLE);
+    /* user_version is set once the schema is complete, so a usual start costs one pragma */
+    if (_get_user_version(db) >= MEMO_SCHEMA_VERSION) {
+        return 0;
+    }
+
+    rc = _exec(db, "BEGIN IMMEDIATE");
     retv_if(rc == -1, -1);
 
+    rc = _exec(db, CREATE_MEMO_TABLE);
+    if (rc == 0) {
+        rc = _exec(db, CREATE_MEMO_CHUNK_TABLE);
+    }
+    if (rc == 0) {
+        rc = _exec(db, CREATE_MEMO_THUMB_TABLE);
+    }
+    /* version 3 */
+    if (rc == 0) {
+        rc = _add_column(db, "memo", "content_hash", "INTEGER");
+    }
+    if (rc == 0) {
+        rc = _exec(db, CREATE_MEMO_HASH_INDEX);
+    }
+    if (rc == 0) {
+        rc = _fill_content_hash(db);
+    }
+    /* version 4, older stamps are whole seconds and stay comparable */
+    if (rc == 0) {
+        rc = _add_column(db, "memo", "create_utime", "INTEGER");
+    }
+    if (rc == 0) {
+        rc = _add_column(db, "memo", "modi_utime", "INTEGER");
+    }
+    if (rc == 0) {
+        rc = _exec(db, "update memo set create_utime = create_time * 1000000, "
+                "modi_utime = modi_time * 1000000 where modi_utime is null");
+    }
+    if (rc == 0) {
+        rc = _exec(db, CREATE_MEMO_UTIME_INDEX);
+    }
+    /* version 5 */
+    if (rc == 0) {
+        rc = _exec(db, CREATE_MEMO_LIST_INDEXES);
+    }
+    /* version 6, the keys are filled by db_collate_load */
+    if (rc == 0) {
+        rc = _add_column(db, "memo", "sort_key", "BLOB");
+    }
+    if (rc == 0) {
+        rc = _exec(db, CREATE_MEMO_META_TABLE);
+    }
+    if (rc == 0) {
+        rc = _exec(db, CREATE_MEMO_SORT_KEY);
+    }
+    /* version 7, color 0 used to be left NULL */
+    if (rc == 0) {
+        rc = _exec(db, "update memo set color = 0 where color is null");
+    }
+    /* version 8, sort_key is set by the write path */
+    if (rc == 0) {
+        rc = _exec(db, DROP_MEMO_SORT_KEY_TRIGGERS);
+    }
+    if (rc == 0) {
+        snprintf(query, sizeof(query), "PRAGMA user_version = %d", MEMO_SCHEMA_VERSION);
+        rc = _exec(db, query);
+    }
+    if (rc == 0) {
+        rc = _exec(db, "COMMIT");
+    }
+    if (rc == -1) {
+        _exec(db, "ROLLBACK");
+        return -1;
+    }
+
     return 0;
 }
 
-static inline void _make_qry_i_cd(char *query, int len, struct memo_data *cd)
+static inline char *_make_qry_i_cd(struct memo_data *cd, char *preview, int64_t *hash)
 {
-    char * buf = db_make_insert_query(
-        KEY_ITEM_MODE, (void *)cd->has_doodle,
-        KEY_CONTENT, db_content_truncate(cd->content),
+    return db_make_insert_query(
+        KEY_ITEM_MODE, (void *)(intptr_t)cd->has_doodle,
+        KEY_FAVORITE, (void *)(intptr_t)cd->favorite,
+        KEY_COLOR, &cd->color,
+        KEY_CONTENT, preview,
         KEY_FONT_RESPECT, cd->font_respect,
         KEY_FONT_SIZE, ((cd->font_respect ? cd->font_size : 44)),
         KEY_FONT_COLOR, (cd->font_respect ? cd->font_color : 0xff000000),
         KEY_COMMENT, cd->comment,
         KEY_DOODLE_PATH, cd->doodle_path,
+        KEY_CONTENT_HASH, hash,
         KEY_INPUT_END);
-    if (buf != NULL) {
-        snprintf(query, len, "%s", buf);
-        free(buf);
+}
+
+/* preview part of content for the content column, *tail_len receives the length of the rest */
+static char *_content_preview(const char *content, int *tail_len)
+{
+    int len;
+
+    *tail_len = 0;
+    if (content == NULL) {
+        return NULL;
     }
+    len = db_content_preview_len(content);
+    *tail_len = strlen(content) - len;
+    return db_strndup(content, len);
 }
 
-int insert_data(sqlite3 *db, struct memo_data *cd)
+static int _store_tail(sqlite3 *db, int id, const char *content, int tail_len)
+{
+    if (content == NULL) {
+        return 0;
+    }
+    return db_chunk_store(db, id, content + strlen(content) - tail_len, tail_len);
+}
+
+/**
+ * @brief     Id of a live memo whose content_hash is hash
+ *
+ * @return    the id, 0 if there is none or -1 (Failed)
+ */
+int find_content_hash(sqlite3 *db, int64_t hash)
+{
+    sqlite3_stmt *stmt = NULL;
+    int id = 0;
+
+    retvm_if(db == NULL, -1, "DB handler is null");
+    retvm_if(sqlite3_prepare_v2(db, "select id from memo where content_hash = ? and delete_time = -1 "
+                "order by id limit 1", -1, &stmt, NULL) != SQLITE_OK, -1,
+            "SQL error : %s", sqlite3_errmsg(db));
+    sqlite3_bind_int64(stmt, 1, hash);
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        id = INT(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    return id;
+}
+
+static int _insert(sqlite3 *db, struct memo_data *cd, int if_absent)
 {
     int rc = 0;
+    int found = 0;
     char *query = NULL;
-    int len = 512;
+    char *preview;
+    int tail_len = 0;
+    int64_t hash;
 
     retvm_if(db == NULL, -1, "DB handler is null");
     retvm_if(cd == NULL, -1, "Insert data is null");
 
-    if (cd->content != NULL) {
-        len += strlen(cd->content);
-    }
-    if (cd->comment != NULL) {
-        len += strlen(cd->comment);
-    }
-    query = (char *)malloc(len);
+    hash = db_hash_memo(cd->content, cd->comment, cd->doodle_path);
+    preview = _content_preview(cd->content, &tail_len);
+    retv_if(cd->content != NULL && preview == NULL, -1);
+    /* the query is sized by the helper, packed columns may be longer or shorter than plain text */
+    query = _make_qry_i_cd(cd, preview, &hash);
+    db_free(preview);
     retv_if(query == NULL, -1);
-    _make_qry_i_cd(query, len, cd);
+
     memo_begin_trans();
-    rc = _exec(db, query);
+    /* IMMEDIATE, so no other writer adds the same memo between the lookup and the insert */
+    rc = _exec(db, "BEGIN IMMEDIATE");
+    if (rc == 0 && if_absent) {
+        found = find_content_hash(db, hash);
+        rc = found == -1 ? -1 : 0;
+    }
+    if (rc == 0 && found == 0) {
+        rc = _exec(db, query);
+        if (rc == 0) {
+            cd->id = sqlite3_last_insert_rowid(db);
+            rc = tail_len > 0 ? _store_tail(db, cd->id, cd->content, tail_len) : 0;
+        }
+        if (rc == 0) {
+            rc = db_collate_update_key(db, cd->id);
+        }
+    }
+    if (rc == 0) {
+        rc = _exec(db, "COMMIT");
+    }
+    if (rc == -1) {
+        _exec(db, "ROLLBACK");
+    }
     memo_end_trans();
-    free(query);
+    db_free(query);
     retv_if(rc == -1, rc);
-    cd->id = sqlite3_last_insert_rowid(db);
+    if (found > 0) {
+        cd->id = found;
+        return 0;
+    }
     DBG("Memo id : %d", cd->id);
+    if (cd->doodle_path != NULL) {
+        warn_if(db_thumb_update(db, cd->id, cd->doodle_path) == -1, "No thumbnail for memo %d", cd->id);
+    }
     return cd->id;
 }
 
-static inline void _make_qry_d_cd(char *query, int len, struct memo_data *cd)
+int insert_data(sqlite3 *db, struct memo_data *cd)
 {
-    char *buf = db_make_delete_query(cd->id);
-    if (buf != NULL) {
-        snprintf(query, len, "%s", buf);
-        free(buf);
-    }
+    return _insert(db, cd, 0);
 }
 
-int remove_data(sqlite3 *db, int cid)
+/**
+ * @brief     Insert cd unless a live memo has the same content, comment and doodle_path
+ *
+ * @return    id of the new memo, 0 if one exists (cd->id is set to it) or -1 (Failed)
+ */
+int insert_data_if_absent(sqlite3 *db, struct memo_data *cd)
+{
+    return _insert(db, cd, 1);
+}
+
+/**
+ * @brief     Live memos identical to memo id, other than id itself
+ *
+ * @return    the number of ids written to ids or -1 (Failed)
+ */
+int get_duplicates(sqlite3 *db, int id, int *ids, int len)
 {
+    sqlite3_stmt *stmt = NULL;
+    int n = 0;
     int rc;
-    char query[QUERY_MAXLEN];
 
     retvm_if(db == NULL, -1, "DB handler is null");
-    retvm_if(cid < 1, -1, "Invalid memo data ID");
-    if (has_id(db, cid) != 1) {
+    retvm_if(ids == NULL || len < 1, -1, "Invalid argument");
+
+    rc = sqlite3_prepare_v2(db, "select id from memo where content_hash = "
+            "(select content_hash from memo where id = ?1 and delete_time = -1) "
+            "and delete_time = -1 and id <> ?1 order by id limit ?2", -1, &stmt, NULL);
+    retvm_if(rc != SQLITE_OK, -1, "SQL error : %s", sqlite3_errmsg(db));
+    sqlite3_bind_int(stmt, 1, id);
+    sqlite3_bind_int(stmt, 2, len);
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        ids[n++] = INT(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    retvm_if(rc != SQLITE_DONE, -1, "SQL error : %s", sqlite3_errmsg(db));
+    return n;
+}
+
+/**
+ * @brief     Call cb for every live memo identical to a memo with a lower id
+ *
+ * @remarks   The pairs are collected before the first call, so cb may delete memos.
+ *
+ * @return    the number of duplicates or -1 (Failed)
+ */
+int foreach_duplicate(sqlite3 *db, void (*cb)(int id, int original, void *user_data), void *user_data)
+{
+    sqlite3_stmt *stmt = NULL;
+    int *pairs = NULL, *t;
+    int n = 0, cap = 0;
+    int64_t hash = 0;
+    int original = 0;
+    int i, rc;
+
+    retvm_if(db == NULL, -1, "DB handler is null");
+    retvm_if(cb == NULL, -1, "Invalid argument");
+
+    /* walks memo_content_hash, groups come out in order */
+    rc = sqlite3_prepare_v2(db, "select id, content_hash from memo where delete_time = -1 "
+            "and content_hash in (select content_hash from memo where delete_time = -1 "
+            "group by content_hash having count(*) > 1) order by content_hash, id", -1, &stmt, NULL);
+    retvm_if(rc != SQLITE_OK, -1, "SQL error : %s", sqlite3_errmsg(db));
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        if (original == 0 || sqlite3_column_int64(stmt, 1) != hash) {
+            hash = sqlite3_column_int64(stmt, 1);
+            original = INT(stmt, 0);
+            continue;
+        }
+        if (n + 2 > cap) {
+            cap = cap ? cap * 2 : 64;
+            t = (int *)db_realloc(pairs, cap * sizeof(int));
+            if (t == NULL) {
+                rc = SQLITE_NOMEM;
+                break;
+            }
+            pairs = t;
+        }
+        pairs[n++] = INT(stmt, 0);
+        pairs[n++] = original;
+    }
+    sqlite3_finalize(stmt);
+    if (rc != SQLITE_DONE) {
+        ERR("Can't list duplicates : %d", rc);
+        db_free(pairs);
         return -1;
     }
 
-    struct memo_data memo;
-    memo.id = cid;
-    _make_qry_d_cd(query, sizeof(query), &memo);
+    for (i = 0; i < n; i += 2) {
+        cb(pairs[i], pairs[i + 1], user_data);
+    }
+    db_free(pairs);
+    return n / 2;
+}
+
+/**
+ * @brief     Tombstone memos in one transaction
+ *
+ * @remarks   Doodle files no other live memo refers to are queued for the
+ *            reaper once the transaction is committed.
+ *
+ * @return    the number of removed memos or -1 (Failed)
+ */
+int remove_data_many(sqlite3 *db, const int *ids, int count)
+{
+    sqlite3_stmt *stmt = NULL;
+    char **doodles;
+    int n_doodles = 0;
+    int removed = 0;
+    int i, rc;
+    time_t now = time(NULL);
+
+    retvm_if(db == NULL, -1, "DB handler is null");
+    retvm_if(ids == NULL || count < 1, -1, "Invalid argument");
+
+    doodles = (char **)db_calloc(count, sizeof(char *));
+    retvm_if(doodles == NULL, -1, "calloc failed");
+
     memo_begin_trans();
-    rc = _exec(db, query);
+    rc = _exec(db, "BEGIN IMMEDIATE");
+    if (rc == 0 && sqlite3_prepare_v2(db, "update memo set delete_time = ?1, modi_time = ?2, "
+                "modi_utime = " NEXT_UTIME_SQL("?4") " where id = ?3 and delete_time = -1",
+                -1, &stmt, NULL) != SQLITE_OK) {
+        ERR("SQL error : %s", sqlite3_errmsg(db));
+        rc = -1;
+    }
+    for (i = 0; rc == 0 && i < count; i++) {
+        if (ids[i] < 1) {
+            continue;
+        }
+        /* before the tombstone, so the memo does not count as a live reference */
+        doodles[n_doodles] = db_doodle_path_to_release(db, ids[i]);
+
+        sqlite3_bind_int64(stmt, 1, now);
+        sqlite3_bind_int64(stmt, 2, now);
+        sqlite3_bind_int(stmt, 3, ids[i]);
+        sqlite3_bind_int64(stmt, 4, db_now_utime());
+        if (sqlite3_step(stmt) != SQLITE_DONE) {
+            ERR("SQL error : %s", sqlite3_errmsg(db));
+            rc = -1;
+        }
+        sqlite3_reset(stmt);
+        if (rc == 0 && sqlite3_changes(db) > 0) {
+            removed++;
+            rc = db_chunk_clear(db, ids[i]);
+            if (rc == 0) {
+                rc = db_thumb_clear(db, ids[i]);
+            }
+            if (doodles[n_doodles] != NULL) {
+                n_doodles++;
+            }
+        } else {
+            db_free(doodles[n_doodles]);
+            doodles[n_doodles] = NULL;
+        }
+    }
+    sqlite3_finalize(stmt);
+    if (rc == 0) {
+        rc = _exec(db, "COMMIT");
+    }
+    if (rc == -1) {
+        _exec(db, "ROLLBACK");
+    }
     memo_end_trans();
-    retv_if(rc == -1, rc);
-    return 0;
+
+    for (i = 0; i < n_doodles; i++) {
+        if (rc == 0) {
+            db_doodle_queue(doodles[i]);
+        } else {
+            db_free(doodles[i]);
+        }
+    }
+    db_free(doodles);
+    retv_if(rc == -1, -1);
+    return removed;
+}
+
+int remove_data(sqlite3 *db, int cid)
+{
+    retvm_if(db == NULL, -1, "DB handler is null");
+    retvm_if(cid < 1, -1, "Invalid memo data ID");
+    /* the tombstone update only changes a live memo */
+    return remove_data_many(db, &cid, 1) == 1 ? 0 : -1;
 }
 
-static inline void _make_qry_u_cd(char *query, int len, struct memo_data *cd)
+static inline char *_make_qry_u_cd(struct memo_data *cd, char *preview)
 {
-    char *buf = db_make_update_query(cd->id,
-        KEY_FAVORITE, (void *)cd->favorite,
-        KEY_CONTENT, db_content_truncate(cd->content),
+    return db_make_update_query(cd->id,
+        KEY_FAVORITE, (void *)(intptr_t)cd->favorite,
+        KEY_COLOR, &cd->color,
+        KEY_CONTENT, preview,
         KEY_FONT_RESPECT, cd->font_respect,
         KEY_FONT_SIZE, ((cd->font_respect ? cd->font_size : 44)),
         KEY_FONT_COLOR, (cd->font_respect ? cd->font_color : 0xff000000),
         KEY_COMMENT, cd->comment,
         KEY_DOODLE_PATH, cd->doodle_path,
         KEY_INPUT_END);
-    if (buf != NULL) {
-        snprintf(query, len, "%s", buf);
-        free(buf);
+}
+
+/* content_hash after an update, fields left NULL in the update keep their stored value */
+static int _update_hash(sqlite3 *db, int id, const char *content)
+{
+    sqlite3_stmt *stmt = NULL;
+    char *stored = NULL;
+    int64_t hash;
+    int rc;
+
+    rc = sqlite3_prepare_v2(db, "select " COL_CONTENT ", " COL_COMMENT ", doodle_path from memo where id = ?",
+            -1, &stmt, NULL);
+    retvm_if(rc != SQLITE_OK, -1, "SQL error : %s", sqlite3_errmsg(db));
+    sqlite3_bind_int(stmt, 1, id);
+    if (sqlite3_step(stmt) != SQLITE_ROW) {
+        sqlite3_finalize(stmt);
+        return 0; /* nothing was updated */
     }
+    if (content == NULL && TEXT(stmt, 0) != NULL) {
+        stored = _d(TEXT(stmt, 0));
+        if (stored != NULL && strlen(stored) >= MEMO_DB_MAX_CONTENT_LEN - 3) {
+            stored = db_chunk_join(db, id, stored);
+        }
+        content = stored;
+    }
+    hash = db_hash_memo(content, TEXT(stmt, 1), TEXT(stmt, 2));
+    sqlite3_finalize(stmt);
+    db_free(stored);
+
+    rc = sqlite3_prepare_v2(db, "update memo set content_hash = ? where id = ?", -1, &stmt, NULL);
+    retvm_if(rc != SQLITE_OK, -1, "SQL error : %s", sqlite3_errmsg(db));
+    sqlite3_bind_int64(stmt, 1, hash);
+    sqlite3_bind_int(stmt, 2, id);
+    rc = sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+    retvm_if(rc != SQLITE_DONE, -1, "SQL error : %s", sqlite3_errmsg(db));
+    return 0;
 }
 
-int update_data(sqlite3 *db, struct memo_data *cd)
+/* with expected -1 the update is unconditional, see update_data_if_unchanged */
+static int _update(sqlite3 *db, struct memo_data *cd, int64_t expected)
 {
     int rc;
     char *query = NULL;
-    int len = 512;
+    char *preview;
+    int tail_len = 0;
+    struct memo_probe p;
 
     retvm_if(db == NULL, -1, "DB handler is null");
     retvm_if(cd == NULL, -1, "Update data is null");
 
-    if (cd->content != NULL) {
-        len += strlen(cd->content);
-    }
-    if (cd->comment != NULL) {
-        len += strlen(cd->comment);
-    }
-    query = (char *)malloc(len);
+    preview = _content_preview(cd->content, &tail_len);
+    retv_if(cd->content != NULL && preview == NULL, -1);
+    query = _make_qry_u_cd(cd, preview);
+    db_free(preview);
     retv_if(query == NULL, -1);
-    _make_qry_u_cd(query, len, cd);
+    if (expected != -1) {
+        char *cas = sqlite3_mprintf("%s AND modi_utime = %lld AND delete_time = -1", query, (long long)expected);
+        db_free(query);
+        retvm_if(cas == NULL, -1, "sqlite3_mprintf failed");
+        query = db_strdup(cas);
+        sqlite3_free(cas);
+        retvm_if(query == NULL, -1, "strdup failed");
+    }
+
     memo_begin_trans();
-    rc = _exec(db, query);
+    rc = _exec(db, "BEGIN IMMEDIATE");
+    if (rc == 0) {
+        rc = _exec(db, query);
+    }
+    /* nothing matched: missing, or deleted or changed since expected */
+    if (rc == 0 && sqlite3_changes(db) == 0) {
+        rc = expected != -1 && probe_data(db, cd->id, &p) == 0 && p.exists ? MEMO_ERROR_CONFLICT : -1;
+        warn_if(rc == -1, "Memo data %d does not exist", cd->id);
+    }
+    if (rc == 0 && cd->content != NULL) { /* content is replaced, so are the chunks */
+        rc = _store_tail(db, cd->id, cd->content, tail_len);
+    }
+    if (rc == 0) {
+        rc = _update_hash(db, cd->id, cd->content);
+    }
+    if (rc == 0 && (cd->content != NULL || cd->comment != NULL)) {
+        rc = db_collate_update_key(db, cd->id);
+    }
+    if (rc == 0) {
+        rc = _exec(db, "COMMIT");
+    }
+    if (rc != 0) {
+        _exec(db, "ROLLBACK");
+    }
     memo_end_trans();
-    free(query);
-    retv_if(rc == -1, rc);
+    db_free(query);
+    retv_if(rc != 0, rc);
+    if (cd->doodle_path != NULL) {
+        warn_if(db_thumb_update(db, cd->id, cd->doodle_path) == -1, "No thumbnail for memo %d", cd->id);
+    }
     return 0;
 }
 
+int update_data(sqlite3 *db, struct memo_data *cd)
+{
+    return _update(db, cd, -1);
+}
+
+/**
+ * @brief     Update memo cd->id only if its modi_utime is still expected, atomically
+ *            as the check and the update are one statement in a write transaction
+ *
+ * @return    0 (Success), MEMO_ERROR_CONFLICT (changed by another writer) or -1 (Failed)
+ */
+int update_data_if_unchanged(sqlite3 *db, struct memo_data *cd, int64_t expected)
+{
+    retvm_if(expected < 0, -1, "Invalid modified time : %lld", (long long)expected);
+    return _update(db, cd, expected);
+}
+
 static int _get_cd(sqlite3 *db, int cid, struct memo_data *cd)
 {
     int rc;
@@ -191,7 +684,7 @@ static int _get_cd(sqlite3 *db, int cid, struct memo_data *cd)
     sqlite3_stmt *stmt;
     int idx;
 
-    snprintf(query, sizeof(query), "select content, modi_time, doodle, color, comment, favorite, font_respect, font_size, font_color, doodle_path "
+    snprintf(query, sizeof(query), "select " COL_CONTENT ", modi_time, doodle, color, " COL_COMMENT ", favorite, font_respect, font_size, font_color, doodle_path "
             "from memo where id = %d and delete_time = -1",
             cid);
 
@@ -207,7 +700,7 @@ static int _get_cd(sqlite3 *db, int cid, struct memo_data *cd)
         idx = 0;
         cd->content = _d(TEXT(stmt, idx++));
         //strncpy(cd->written_time, _s(TEXT(stmt, idx++)), DATE_LEN);
-        cd->modi_time = INT(stmt, idx++);
+        cd->modi_time = INT64(stmt, idx++);
         cd->has_doodle = INT(stmt, idx++);
         cd->color = INT(stmt, idx++);
         cd->comment = _d(TEXT(stmt, idx++));
@@ -216,10 +709,10 @@ static int _get_cd(sqlite3 *db, int cid, struct memo_data *cd)
         cd->font_size = INT(stmt, idx++);
         cd->font_color = INT(stmt, idx++);
         cd->doodle_path = _d(TEXT(stmt, idx++));
-    } else {
-        retvm_if(1, -1, "Contact data %d does not exist", cid);
+        STAT_ROW(MEMO_STAT_GET, cd);
     }
-    rc = sqlite3_finalize(stmt);
+    sqlite3_finalize(stmt);
+    retvm_if(rc != SQLITE_ROW, -1, "Memo data %d does not exist", cid);
 
     return 0;
 }
@@ -235,16 +728,215 @@ int get_data(sqlite3 *db, int cid, struct memo_data *cd)
     rc = _get_cd(db, cid, cd);
     retv_if(rc == -1, rc);
 
+    /* a full preview (the cut may step back up to 3 bytes of an UTF-8 character) can have chunks */
+    if (cd->content != NULL && strlen(cd->content) >= MEMO_DB_MAX_CONTENT_LEN - 3) {
+        cd->content = db_chunk_join(db, cid, cd->content);
+    }
+
     cd->id = cid;
     return 0;
 }
 
+/*
+ * get_data_many returns one block: the memo_data array followed by the strings.
+ * While it grows the string fields hold offsets in the block, see _many_fix.
+ */
+struct many_block {
+    char *base;
+    size_t len;
+    size_t cap;
+};
+
+struct many_pos {
+    int id;
+    int pos;
+};
+
+#define GET_MANY_BATCH 128
+
+static int _cmp_pos(const void *a, const void *b)
+{
+    const struct many_pos *x = a, *y = b;
+    return x->id < y->id ? -1 : x->id > y->id;
+}
+
+/* offset of a copy of s in the block, 0 for NULL, -1 when out of memory */
+static intptr_t _many_add(struct many_block *b, const char *s)
+{
+    size_t n, cap;
+    char *t;
+    intptr_t off;
+
+    if (s == NULL) {
+        return 0;
+    }
+    n = strlen(s) + 1;
+    if (b->len + n > b->cap) {
+        cap = b->cap * 2 > b->len + n ? b->cap * 2 : b->len + n;
+        t = (char *)db_realloc(b->base, cap);
+        retvm_if(t == NULL, -1, "realloc failed");
+        b->base = t;
+        b->cap = cap;
+    }
+    off = b->len;
+    memcpy(b->base + off, s, n);
+    b->len += n;
+    return off;
+}
+
+static inline char *_many_fix(char *base, char *field)
+{
+    return field ? base + (intptr_t)field : NULL;
+}
+
+/* copies the row into mds[pos] of the block, the content is joined with its chunks */
+static int _many_row(sqlite3 *db, sqlite3_stmt *stmt, struct many_block *b, int pos)
+{
+    memo_data_t *md;
+    char *content = NULL;
+    intptr_t c, m, d;
+
+    if (TEXT(stmt, 1) != NULL && strlen(TEXT(stmt, 1)) >= MEMO_DB_MAX_CONTENT_LEN - 3) {
+        content = db_chunk_join(db, INT(stmt, 0), _d(TEXT(stmt, 1)));
+        retv_if(content == NULL, -1);
+    }
+    c = _many_add(b, content ? content : TEXT(stmt, 1));
+    db_free(content);
+    m = _many_add(b, TEXT(stmt, 5));
+    d = _many_add(b, TEXT(stmt, 10));
+    retv_if(c == -1 || m == -1 || d == -1, -1);
+
+    md = (memo_data_t *)b->base + pos;
+    md->id = INT(stmt, 0);
+    md->content = (char *)c;
+    md->modi_time = INT64(stmt, 2);
+    md->has_doodle = INT(stmt, 3);
+    md->color = INT(stmt, 4);
+    md->comment = (char *)m;
+    md->favorite = INT(stmt, 6);
+    md->font_respect = INT(stmt, 7);
+    md->font_size = INT(stmt, 8);
+    md->font_color = INT(stmt, 9);
+    md->doodle_path = (char *)d;
+    return 0;
+}
+
+static int _many_batch(sqlite3 *db, struct many_block *b, const struct many_pos *sorted, int n,
+    const int *ids, int count)
+{
+    char query[QUERY_MAXLEN];
+    sqlite3_stmt *stmt = NULL;
+    struct many_pos key, *found;
+    int len, i, rc;
+
+    len = snprintf(query, sizeof(query), "select id, " COL_CONTENT ", modi_time, doodle, color, " COL_COMMENT
+            ", favorite, font_respect, font_size, font_color, doodle_path from memo where delete_time = -1 and id in (?");
+    for (i = 1; i < count; i++) {
+        len += snprintf(query + len, sizeof(query) - len, ",?");
+    }
+    snprintf(query + len, sizeof(query) - len, ")");
+
+    rc = sqlite3_prepare_v2(db, query, -1, &stmt, NULL);
+    retvm_if(rc != SQLITE_OK, -1, "SQL error : %s", sqlite3_errmsg(db));
+    for (i = 0; i < count; i++) {
+        sqlite3_bind_int(stmt, i + 1, ids[i]);
+    }
+    rc = 0;
+    while (rc == 0 && sqlite3_step(stmt) == SQLITE_ROW) {
+        key.id = INT(stmt, 0);
+        found = (struct many_pos *)bsearch(&key, sorted, n, sizeof(key), _cmp_pos);
+        if (found == NULL || ((memo_data_t *)b->base)[found->pos].id != 0) {
+            continue; /* an id repeated in the batches */
+        }
+        while (found > sorted && found[-1].id == key.id) {
+            found--;
+        }
+        rc = _many_row(db, stmt, b, found->pos);
+        /* the copies of a repeated id share the strings */
+        for (i = 1; rc == 0 && found + i < sorted + n && found[i].id == key.id; i++) {
+            ((memo_data_t *)b->base)[found[i].pos] = ((memo_data_t *)b->base)[found->pos];
+        }
+    }
+    sqlite3_finalize(stmt);
+    return rc;
+}
+
+/**
+ * @brief     Get the memos of ids with a statement per GET_MANY_BATCH ids
+ *
+ * @return    n memo_data in one block, entry i is memo ids[i] or has id 0 when it does not exist.
+ *            NULL (Failed)
+ */
+memo_data_t *get_data_many(sqlite3 *db, const int *ids, int n)
+{
+    struct many_block b;
+    struct many_pos *sorted;
+    memo_data_t *mds;
+    int i, rc = 0;
+
+    retvm_if(db == NULL, NULL, "DB handler is null");
+    retvm_if(ids == NULL || n < 1, NULL, "Invalid argument");
+
+    sorted = (struct many_pos *)db_malloc(sizeof(struct many_pos) * n);
+    retvm_if(sorted == NULL, NULL, "malloc failed");
+    for (i = 0; i < n; i++) {
+        sorted[i].id = ids[i];
+        sorted[i].pos = i;
+    }
+    qsort(sorted, n, sizeof(struct many_pos), _cmp_pos);
+
+    b.len = sizeof(memo_data_t) * n;
+    b.cap = b.len + n * 256;
+    b.base = (char *)db_malloc(b.cap);
+    if (b.base == NULL) {
+        db_free(sorted);
+        ERR("malloc failed");
+        return NULL;
+    }
+    memset(b.base, 0, b.len);
+
+    for (i = 0; rc == 0 && i < n; i += GET_MANY_BATCH) {
+        rc = _many_batch(db, &b, sorted, n, ids + i, n - i < GET_MANY_BATCH ? n - i : GET_MANY_BATCH);
+    }
+    db_free(sorted);
+    if (rc == -1) {
+        db_free(b.base);
+        return NULL;
+    }
+
+    mds = (memo_data_t *)b.base;
+    for (i = 0; i < n; i++) {
+        mds[i].content = _many_fix(b.base, mds[i].content);
+        mds[i].comment = _many_fix(b.base, mds[i].comment);
+        mds[i].doodle_path = _many_fix(b.base, mds[i].doodle_path);
+        if (mds[i].id != 0) {
+            STAT_ROW(MEMO_STAT_GET, &mds[i]);
+        }
+    }
+    return mds;
+}
+
+static void _free_data_list(struct memo_data_list *cd)
+{
+    struct memo_data_list *t;
+
+    while (cd != NULL) {
+        t = cd->next;
+        db_free(cd->md.content);
+        db_free(cd->md.comment);
+        db_free(cd->md.doodle_path);
+        db_free(cd);
+        cd = t;
+    }
+}
+
 static struct memo_data_list* _get_data_list(sqlite3 *db, const char* query)
 {
     int rc;
     sqlite3_stmt *stmt;
     struct memo_data_list *cd = NULL;
     struct memo_data_list *t;
+    size_t bytes = 0;
     int idx;
 
     retvm_if(db == NULL, cd, "DB handler is null");
@@ -259,14 +951,14 @@ static struct memo_data_list* _get_data_list(sqlite3 *db, const char* query)
     rc = sqlite3_step(stmt);
     while(rc == SQLITE_ROW) {
         idx=0;
-        t = (struct memo_data_list *)calloc(1, sizeof(struct memo_data_list));
+        t = (struct memo_data_list *)db_calloc(1, sizeof(struct memo_data_list));
         if (t == NULL) {
-            continue;
+            break;
         }
         t->md.id = INT(stmt, idx++);
         t->md.content = _d(TEXT(stmt, idx++));
         //strncpy(t->md.written_time, _s(TEXT(stmt, idx++)), DATE_LEN);
-        t->md.modi_time = INT(stmt, idx++);
+        t->md.modi_time = INT64(stmt, idx++);
         t->md.has_doodle = INT(stmt, idx++);
         t->md.color = INT(stmt, idx++);        // jwh : color added
         t->md.comment = _d(TEXT(stmt, idx++));
@@ -275,6 +967,7 @@ static struct memo_data_list* _get_data_list(sqlite3 *db, const char* query)
         t->md.font_size = INT(stmt, idx++);
         t->md.font_color = INT(stmt, idx++);
         t->md.doodle_path = _d(TEXT(stmt, idx++));
+        STAT_ROW(MEMO_STAT_LIST, &t->md);
 
         t->next = NULL;
         t->prev = NULL;
@@ -283,6 +976,13 @@ static struct memo_data_list* _get_data_list(sqlite3 *db, const char* query)
             cd->prev = t;
         }
         cd = t;
+        bytes += sizeof(*t) + _s_len(t->md.content) + _s_len(t->md.comment) + _s_len(t->md.doodle_path);
+        if (db_budget_list_over(bytes)) {
+            ERR("List over the memory budget, iterate with memo_all_data");
+            _free_data_list(cd);
+            cd = NULL;
+            break;
+        }
         rc = sqlite3_step(stmt);
     }
     rc = sqlite3_finalize(stmt);
@@ -296,44 +996,43 @@ struct memo_data_list* get_all_data_list(sqlite3 *db)
     retvm_if(db == NULL, NULL, "db handler is null");
 
     snprintf(query, sizeof(query),    "select "
-                                    "id, content, modi_time, doodle, color, comment, favorite, font_respect, font_size, font_color, doodle_path "
-                                    "from memo where delete_time = -1 order by create_time asc");
+                                    "id, " COL_CONTENT ", modi_time, doodle, color, " COL_COMMENT ", favorite, font_respect, font_size, font_color, doodle_path "
+                                    "from memo where delete_time = -1 order by create_utime asc");
 
     return _get_data_list(db, query);
 }
 
-struct memo_operation_list* get_operation_list(sqlite3 *db, time_t stamp)
+/* query selects id, create stamp, modi_utime and delete_time of the memos changed after stamp */
+static struct memo_operation_list *_get_operation_list(sqlite3 *db, const char *query, int64_t stamp)
 {
-    char query[QUERY_MAXLEN];
     int rc;
     sqlite3_stmt *stmt;
-    time_t create_tm, mod_tm, del_tm;
+    int64_t create_tm, del_tm;
     struct memo_operation_list *t = NULL;
     struct memo_operation_list *cd = NULL;
+    size_t bytes = 0;
     int idx;
 
     retvm_if(db == NULL, NULL, "db handler is null");
-    snprintf(query, sizeof(query),    "select "
-                                    "id, create_time, modi_time, delete_time "
-                                    "from memo where modi_time > %ld", stamp);
-    rc = sqlite3_prepare(db, query, -1, &stmt, NULL);
+    rc = sqlite3_prepare_v2(db, query, -1, &stmt, NULL);
     if (SQLITE_OK != rc || NULL == stmt) {
         ERR("SQL error\n");
         sqlite3_finalize(stmt);
         return NULL;
     }
+    sqlite3_bind_int64(stmt, 1, stamp);
 
     rc = sqlite3_step(stmt);
     while(rc == SQLITE_ROW) {
         idx=0;
-        t = (struct memo_operation_list *)malloc(sizeof(struct memo_operation_list));
+        t = (struct memo_operation_list *)db_malloc(sizeof(struct memo_operation_list));
         if (t == NULL) {
-            continue;
+            break;
         }
         t->id = INT(stmt, idx++);
-        create_tm = INT(stmt, idx++);
-        mod_tm = INT(stmt, idx++);
-        del_tm = INT(stmt, idx++);
+        create_tm = INT64(stmt, idx++);
+        t->modi_utime = INT64(stmt, idx++);
+        del_tm = INT64(stmt, idx++);
         if (del_tm != -1) {
             t->operation = MEMO_OPERATION_DELETE;
         } else if (stamp < create_tm) {
@@ -343,6 +1042,16 @@ struct memo_operation_list* get_operation_list(sqlite3 *db, time_t stamp)
         }
         t->next = cd;
         cd = t;
+        bytes += sizeof(*t);
+        if (db_budget_list_over(bytes)) {
+            ERR("Operation list over the memory budget");
+            while (cd != NULL) {
+                t = cd->next;
+                db_free(cd);
+                cd = t;
+            }
+            break;
+        }
         rc = sqlite3_step(stmt);
     }
     rc = sqlite3_finalize(stmt);
@@ -350,59 +1059,166 @@ struct memo_operation_list* get_operation_list(sqlite3 *db, time_t stamp)
     return cd;
 }
 
-int has_id(sqlite3 *db, int cid)
+struct memo_operation_list* get_operation_list(sqlite3 *db, time_t stamp)
 {
-    int rc;
-    int ret = 0;
-    char query[QUERY_MAXLEN];
-    sqlite3_stmt *stmt;
+    return _get_operation_list(db, "select id, create_time, modi_utime, delete_time "
+            "from memo where modi_time > ?", stamp);
+}
 
-    retvm_if(db == NULL, ret, "DB handler is null");
-    retvm_if(cid < 1, ret, "Invalid memo data ID");
+/**
+ * @brief     Memos changed after ustamp, a modi_utime
+ *
+ * @remarks   Unlike get_operation_list, changes within the same second are told apart.
+ */
+struct memo_operation_list* get_operation_list_since(sqlite3 *db, int64_t ustamp)
+{
+    return _get_operation_list(db, "select id, create_utime, modi_utime, delete_time "
+            "from memo where modi_utime > ?", ustamp);
+}
 
-    snprintf(query, sizeof(query), "select id from memo where id = %d", cid);
+/*
+ * Probe statement of the main connection, prepared by db_init and finalized by db_fini.
+ * Other connections prepare their own each time. The connection mutex keeps two threads
+ * from stepping it at once.
+ */
+#define PROBE_SQL "select modi_time, modi_utime, delete_time from memo where id = ?"
 
-    rc = sqlite3_prepare(db, query, -1, &stmt, NULL);
-    if (SQLITE_OK != rc || NULL == stmt) {
-        ERR("SQL error\n");
-        sqlite3_finalize(stmt);
-        return -1;
+static sqlite3 *probe_db;
+static sqlite3_stmt *probe_stmt;
+
+static int _probe(sqlite3 *db, int cid, struct memo_probe *p, time_t *modi_time)
+{
+    sqlite3_stmt *stmt = NULL;
+    int cached = (db == probe_db && probe_stmt != NULL);
+    int rc;
+
+    memset(p, 0, sizeof(*p));
+    p->id = cid;
+    if (cached) {
+        stmt = probe_stmt;
+    } else {
+        rc = sqlite3_prepare_v2(db, PROBE_SQL, -1, &stmt, NULL);
+        retvm_if(rc != SQLITE_OK, -1, "SQL error : %s", sqlite3_errmsg(db));
     }
 
+    sqlite3_bind_int(stmt, 1, cid);
     rc = sqlite3_step(stmt);
-    if(rc == SQLITE_ROW) {
-        ret = 1; // exist
+    if (rc == SQLITE_ROW) {
+        p->deleted = INT64(stmt, 2) != -1;
+        p->exists = !p->deleted;
+        p->modi_utime = INT64(stmt, 1);
+        if (modi_time != NULL) {
+            *modi_time = INT64(stmt, 0);
+        }
     }
-    rc = sqlite3_finalize(stmt);
+    if (cached) {
+        sqlite3_reset(stmt);
+    } else {
+        sqlite3_finalize(stmt);
+    }
+    retvm_if(rc != SQLITE_ROW && rc != SQLITE_DONE, -1, "SQL error : %s", sqlite3_errmsg(db));
+    return 0;
+}
 
-    return ret;
+/**
+ * @brief     Whether memo cid exists and whether it is deleted, with its modi_utime
+ *
+ * @return    0 (Success) or -1 (Failed)
+ */
+int probe_data(sqlite3 *db, int cid, struct memo_probe *p)
+{
+    sqlite3_mutex *m;
+    int rc;
+
+    retvm_if(db == NULL, -1, "DB handler is null");
+    retvm_if(p == NULL, -1, "Output struct is null");
+
+    m = sqlite3_db_mutex(db);
+    sqlite3_mutex_enter(m);
+    rc = _probe(db, cid, p, NULL);
+    sqlite3_mutex_leave(m);
+    return rc;
+}
+
+/**
+ * @brief     probe_data of n ids with the same statement, in one read transaction
+ *
+ * @return    0 (Success) or -1 (Failed)
+ */
+int probe_data_many(sqlite3 *db, const int *ids, int n, struct memo_probe *probes)
+{
+    sqlite3_mutex *m;
+    int own_trans;
+    int i, rc = 0;
+
+    retvm_if(db == NULL, -1, "DB handler is null");
+    retvm_if(ids == NULL || probes == NULL || n < 1, -1, "Invalid argument");
+
+    m = sqlite3_db_mutex(db);
+    sqlite3_mutex_enter(m);
+    /* one shared lock for all of them instead of a lock and a change counter check per id */
+    own_trans = sqlite3_get_autocommit(db) && _exec(db, "BEGIN") == 0;
+    for (i = 0; rc == 0 && i < n; i++) {
+        rc = _probe(db, ids[i], &probes[i], NULL);
+    }
+    if (own_trans) {
+        _exec(db, "COMMIT");
+    }
+    sqlite3_mutex_leave(m);
+    return rc;
+}
+
+int has_id(sqlite3 *db, int cid)
+{
+    struct memo_probe p;
+
+    retvm_if(cid < 1, 0, "Invalid memo data ID");
+    retv_if(probe_data(db, cid, &p) == -1, -1);
+    return p.exists;
 }
 
 time_t get_modtime(sqlite3 *db, int cid)
 {
-    int rc;
+    struct memo_probe p;
+    sqlite3_mutex *m;
     time_t ret = -1;
-    char query[QUERY_MAXLEN];
-    sqlite3_stmt *stmt;
+    int rc;
 
     retvm_if(db == NULL, ret, "DB handler is null");
     retvm_if(cid < 1, ret, "Invalid memo data ID");
 
-    snprintf(query, sizeof(query), "select modi_time from memo where id = %d", cid);
+    m = sqlite3_db_mutex(db);
+    sqlite3_mutex_enter(m);
+    rc = _probe(db, cid, &p, &ret);
+    sqlite3_mutex_leave(m);
+    return rc == 0 ? ret : -1;
+}
 
-    rc = sqlite3_prepare(db, query, -1, &stmt, NULL);
-    if (SQLITE_OK != rc || NULL == stmt) {
-        ERR("SQL error\n");
-        sqlite3_finalize(stmt);
-        return -1;
-    }
+/**
+ * @brief     modi_utime of memo cid, or with cid 0 the latest modi_utime of the db
+ *
+ * @return    the stamp, 0 for an empty db or -1 (Failed)
+ */
+int64_t get_modutime(sqlite3 *db, int cid)
+{
+    sqlite3_stmt *stmt = NULL;
+    struct memo_probe p;
+    int64_t ret = -1;
+    int rc;
 
-    rc = sqlite3_step(stmt);
-    if(rc == SQLITE_ROW) {
-        ret = INT(stmt, 0);
-    }
-    rc = sqlite3_finalize(stmt);
+    retvm_if(db == NULL, ret, "DB handler is null");
+    retvm_if(cid < 0, ret, "Invalid memo data ID");
 
+    if (cid) {
+        retv_if(probe_data(db, cid, &p) == -1, -1);
+        return p.exists || p.deleted ? p.modi_utime : -1;
+    }
+    rc = sqlite3_prepare_v2(db, "select ifnull(max(modi_utime), 0) from memo", -1, &stmt, NULL);
+    retvm_if(rc != SQLITE_OK, -1, "SQL error : %s", sqlite3_errmsg(db));
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        ret = INT64(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
     return ret;
 }
 
@@ -421,6 +1237,24 @@ sqlite3* db_init(char *root)
         return NULL;
     }
 
+    rc = db_budget_apply(db);
+    if (rc == 0) {
+        rc = db_busy_register(db);
+    }
+    if (rc == 0) {
+        rc = db_compress_register(db);
+    }
+    if (rc == 0) {
+        rc = db_match_register(db);
+    }
+    if (rc == 0) {
+        rc = db_collate_register(db);
+    }
+    if(rc) {
+        db_util_close(db);
+        return NULL;
+    }
+
     rc = _create_table(db);
     if(rc) {
         ERR("Can't create tables: %s", sqlite3_errmsg(db));
@@ -428,12 +1262,21 @@ sqlite3* db_init(char *root)
         db_util_close(db);
         return NULL;
     }
+    warn_if(db_collate_load(db) == -1, "Title order of another locale");
 
+    if (probe_db == NULL && sqlite3_prepare_v2(db, PROBE_SQL, -1, &probe_stmt, NULL) == SQLITE_OK) {
+        probe_db = db;
+    }
     return db;
 }
 
 void db_fini(sqlite3 *db)
 {
+    if (db != NULL && db == probe_db) {
+        sqlite3_finalize(probe_stmt);
+        probe_stmt = NULL;
+        probe_db = NULL;
+    }
     if(db) {
         //sqlite3_close(db); // changed to db_util_close
         db_util_close(db);
@@ -495,11 +1338,7 @@ int get_data_count(sqlite3 *db, int *count)
  */
 int get_indexes(sqlite3 *db, int *aIndex, int len, MEMO_SORT_TYPE sort)
 {
-    int rc = 0;
-    sqlite3_stmt *stmt = NULL;
-    char query[128] = {0};
     int i = 0;
-    const char *str_sort = "order by create_time desc";
 
     retvm_if(db == NULL, 0, "db handler is null");
     retvm_if(len < 0, 0, "index buffer length invalid");
@@ -509,36 +1348,32 @@ int get_indexes(sqlite3 *db, int *aIndex, int len, MEMO_SORT_TYPE sort)
         return i;
     }
 
-    /* ugh, get sort type dynamically */
-    snprintf(query, sizeof(query), "select id from memo where delete_time = -1 %s limit %d", str_sort, len);
-    rc = sqlite3_prepare(db, query, -1, &stmt, NULL);
-    if ((rc == SQLITE_OK) && (stmt != NULL)) {
-        rc = sqlite3_step(stmt);
-        while((rc==SQLITE_ROW)) { /* loop times depends on limit keyword, aIndex will not overflow */
-            aIndex[i++] = INT(stmt, 0);
-            rc = sqlite3_step(stmt);
-        }
-    }
-    rc = sqlite3_finalize(stmt);
-    return i;
+    i = get_indexes_filtered(db, aIndex, len, MEMO_SORT_CREATE_TIME, NULL);
+    return i < 0 ? 0 : i;
 }
 
-
+/* id breaks ties, so every list and page of one sort agrees on the order (see _cmp_row in db-psearch.c) */
 static const char *_get_sort_exp(MEMO_SORT_TYPE sort)
 {
-    const char *exp = "create_time DESC"; /* default sort type */
+    const char *exp = "create_utime DESC, id DESC"; /* default sort type */
     switch (sort) {
     case MEMO_SORT_CREATE_TIME:
-        exp = "create_time DESC";
+        exp = "create_utime DESC, id DESC";
         break;
     case MEMO_SORT_CREATE_TIME_ASC:
-        exp = "create_time ASC";
+        exp = "create_utime ASC, id ASC";
         break;
-    case MEMO_SORT_TITLE:
-        exp = "CASE WHEN comment IS NOT NULL THEN comment ELSE content END DESC";
+    case MEMO_SORT_TITLE: /* see db-collate.c */
+        exp = "sort_key DESC, id DESC";
         break;
     case MEMO_SORT_TITLE_ASC:
-        exp = "CASE WHEN comment IS NOT NULL THEN comment ELSE content END ASC";
+        exp = "sort_key ASC, id ASC";
+        break;
+    case MEMO_SORT_MODI_TIME:
+        exp = "modi_utime DESC, id DESC";
+        break;
+    case MEMO_SORT_MODI_TIME_ASC:
+        exp = "modi_utime ASC, id ASC";
         break;
     default:
         break;
@@ -546,82 +1381,526 @@ static const char *_get_sort_exp(MEMO_SORT_TYPE sort)
     return exp;
 }
 
-int search_data(sqlite3 *db, const char *search_str, int limit, int offset, MEMO_SORT_TYPE sort,
-    memo_data_iterate_cb_t cb, void *user_data)
+/*
+ * " AND ..." terms of filter. The values are written as literals: SQLite uses a
+ * partial index only when the query terms match its WHERE clause, which a bound
+ * parameter can not.
+ */
+static void _get_filter_exp(const struct memo_filter *filter, char *buf, int len)
 {
-    retvm_if(db == NULL, -1, "db handler is NULL");
-    retvm_if(search_str == NULL, -1, "search string is NULL");
+    int n = 0;
 
+    buf[0] = '\0';
+    if (filter == NULL) {
+        return;
+    }
+    if (filter->flags & MEMO_FILTER_FAVORITE) {
+        n += snprintf(buf + n, len - n, " AND favorite = 1");
+    }
+    if ((filter->flags & MEMO_FILTER_COLOR) && n < len) {
+        n += snprintf(buf + n, len - n, " AND color = %d", (int)filter->color); /* stored as a signed int */
+    }
+    if ((filter->flags & MEMO_FILTER_DOODLE) && n < len) {
+        n += snprintf(buf + n, len - n, " AND doodle = 1");
+    }
+    if ((filter->flags & MEMO_FILTER_TEXT) && n < len) {
+        n += snprintf(buf + n, len - n, " AND doodle = 0");
+    }
+    if ((filter->flags & MEMO_FILTER_MODIFIED_AFTER) && n < len) {
+        snprintf(buf + n, len - n, " AND modi_utime > %lld", (long long)filter->modified_after);
+    }
+}
+
+/**
+ * @brief     Ids of the live memos matching filter, in sort order
+ *
+ * @param     [in] filter          may be NULL
+ *
+ * @return    number of retrieved indexes or -1 (Failed)
+ */
+int get_indexes_filtered(sqlite3 *db, int *aIndex, int len, MEMO_SORT_TYPE sort,
+    const struct memo_filter *filter)
+{
     int rc = 0;
     sqlite3_stmt *stmt = NULL;
-    char query[QUERY_MAXLEN] = {0};
+    char query[QUERY_MAXLEN];
+    char filter_exp[256];
+    int i = 0;
+
+    retvm_if(db == NULL, -1, "db handler is null");
+    retvm_if(aIndex == NULL || len < 0, -1, "index buffer invalid");
+
+    _get_filter_exp(filter, filter_exp, sizeof(filter_exp));
+    snprintf(query, sizeof(query), "select id from memo where delete_time = -1%s order by %s limit %d",
+            filter_exp, _get_sort_exp(sort), len);
+    rc = sqlite3_prepare_v2(db, query, -1, &stmt, NULL);
+    retvm_if(rc != SQLITE_OK, -1, "SQL error : %s", sqlite3_errmsg(db));
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) { /* limit keeps aIndex from overflowing */
+        aIndex[i++] = INT(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    retvm_if(rc != SQLITE_DONE, -1, "SQL error : %s", sqlite3_errmsg(db));
+    return i;
+}
+
+int get_data_count_filtered(sqlite3 *db, const struct memo_filter *filter, int *count)
+{
+    int rc;
+    sqlite3_stmt *stmt = NULL;
+    char query[QUERY_MAXLEN];
+    char filter_exp[256];
+
+    retvm_if(db == NULL, -1, "db handler is null");
+    retvm_if(count == NULL, -1, "Invalid argument");
+
+    _get_filter_exp(filter, filter_exp, sizeof(filter_exp));
+    snprintf(query, sizeof(query), "select count(*) from memo where delete_time = -1%s", filter_exp);
+    rc = sqlite3_prepare_v2(db, query, -1, &stmt, NULL);
+    retvm_if(rc != SQLITE_OK, -1, "SQL error : %s", sqlite3_errmsg(db));
+    rc = sqlite3_step(stmt);
+    if (rc == SQLITE_ROW) {
+        *count = INT(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    return rc == SQLITE_ROW ? 0 : -1;
+}
+
+/* call cb for every row of query, which selects the columns of ITER_COLUMNS */
+#define ITER_COLUMNS "id, " COL_CONTENT ", modi_time, doodle, " COL_COMMENT ", font_respect, font_size, font_color"
+#define ITER_COLUMNS_N 8
+
+static inline void _iter_row(sqlite3_stmt *stmt, memo_data_t *md)
+{
     int idx = 0;
-    memo_data_t *md = (memo_data_t *)calloc(1, sizeof(memo_data_t));
+
+    md->id = INT(stmt, idx++);
+    md->content = TEXT(stmt, idx++);
+    md->modi_time = INT64(stmt, idx++);
+    md->has_doodle = INT(stmt, idx++);
+    md->comment = TEXT(stmt, idx++);
+    md->font_respect = INT(stmt, idx++);
+    md->font_size = INT(stmt, idx++);
+    md->font_color = INT(stmt, idx++);
+}
+
+static int _iterate_stmt(sqlite3_stmt *stmt, int stat, memo_data_iterate_cb_t cb, void *user_data)
+{
+    int rc = 0;
+    memo_data_t *md = (memo_data_t *)db_calloc(1, sizeof(memo_data_t));
     retvm_if(md == NULL, -1, "calloc failed");
 
-    snprintf(query, sizeof(query),
-        "SELECT id, content, modi_time, doodle, comment, font_respect, font_size, font_color "
-        "FROM memo WHERE delete_time = -1 AND "
-        "CASE WHEN comment IS NOT NULL THEN comment like '%%%s%%' "
-        "ELSE content LIKE '%%%s%%' END "
-        "ORDER BY %s LIMIT %d OFFSET %d",
-        search_str, search_str, _get_sort_exp(sort), limit, offset);
-    LOGD("[query] : %s\n", query);
-    rc = sqlite3_prepare(db, query, -1, &stmt, NULL);
-    if ((rc == SQLITE_OK) && (stmt != NULL)) {
+    rc = sqlite3_step(stmt);
+    while((rc==SQLITE_ROW)) {
+        _iter_row(stmt, md);
+        STAT_ROW(stat, md);
+        cb(md, user_data); /* callback */
         rc = sqlite3_step(stmt);
-        while((rc==SQLITE_ROW)) {
-            idx=0;
-            md->id = INT(stmt, idx++);
-            md->content = TEXT(stmt, idx++);
-            md->modi_time = INT(stmt, idx++);
-            md->has_doodle = INT(stmt, idx++);
-            md->comment = TEXT(stmt, idx++);
-            md->font_respect = INT(stmt, idx++);
-            md->font_size = INT(stmt, idx++);
-            md->font_color = INT(stmt, idx++);
-            cb(md, user_data); /* callback */
-            rc = sqlite3_step(stmt);
-        }
     }
-    rc = sqlite3_finalize(stmt);
-    free(md);
+    db_free(md);
     return 0;
 }
 
-int all_data(sqlite3 *db, memo_data_iterate_cb_t cb, void *user_data)
+/*
+ * _iterate_stmt for a callback which can stop, the rows are only stepped to as long
+ * as it wants more. When cursor is set column ITER_COLUMNS_N holds create_utime.
+ */
+static int _iterate_stmt_ex(sqlite3_stmt *stmt, int stat, memo_cursor_t *cursor,
+    memo_data_iterate_ex_cb_t cb, void *user_data)
 {
-    retvm_if(db == NULL, -1, "db handler is NULL");
-    retvm_if(cb == NULL, -1, "iterator callback is NULL");
+    memo_data_t md;
+    int count = 0;
+    int rc;
+
+    memset(&md, 0, sizeof(md));
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        _iter_row(stmt, &md);
+        STAT_ROW(stat, &md);
+        count++;
+        if (cursor != NULL) {
+            cursor->id = md.id;
+            cursor->create_utime = INT64(stmt, ITER_COLUMNS_N);
+        }
+        if (cb(&md, user_data) != MEMO_ITERATE_CONTINUE) {
+            return count;
+        }
+    }
+    retvm_if(rc != SQLITE_DONE, -1, "SQL error : %s", sqlite3_errmsg(sqlite3_db_handle(stmt)));
+    return count;
+}
 
+static int _iterate(sqlite3 *db, const char *query, int stat, memo_data_iterate_cb_t cb, void *user_data)
+{
     int rc = 0;
     sqlite3_stmt *stmt = NULL;
-    int idx = 0;
-    memo_data_t *md = (memo_data_t *)calloc(1, sizeof(memo_data_t));
-    retvm_if(md == NULL, -1, "calloc failed");
 
-    rc = sqlite3_prepare(db,
-        "SELECT id, content, modi_time, doodle, comment, font_respect, font_size, font_color "
-        "FROM memo where delete_time = -1 order by create_time desc",
-        -1, &stmt, NULL);
+    rc = sqlite3_prepare(db, query, -1, &stmt, NULL);
     if ((rc == SQLITE_OK) && (stmt != NULL)) {
-        rc = sqlite3_step(stmt);
-        while((rc==SQLITE_ROW)) {
-            idx=0;
-            md->id = INT(stmt, idx++);
-            md->content = TEXT(stmt, idx++);
-            md->modi_time = INT(stmt, idx++);
-            md->has_doodle = INT(stmt, idx++);
-            md->comment = TEXT(stmt, idx++);
-            md->font_respect = INT(stmt, idx++);
-            md->font_size = INT(stmt, idx++);
-            md->font_color = INT(stmt, idx++);
-            cb(md, user_data); /* callback */
-            rc = sqlite3_step(stmt);
+        rc = _iterate_stmt(stmt, stat, cb, user_data);
+    }
+    sqlite3_finalize(stmt);
+    return rc == -1 ? -1 : 0;
+}
+
+/* the memo matches the search string bound to ?1, the title is searched when there is one */
+#define SEARCH_MATCH_EXP \
+    MEMO_CONTAINS_FUNC "(CASE WHEN comment IS NOT NULL THEN " COL_COMMENT " ELSE " COL_CONTENT " END, ?1)"
+
+/* the search query of search_data_filtered, with ?1 bound to search_str */
+static sqlite3_stmt *_search_prepare(sqlite3 *db, const char *search_str, int limit, int offset, MEMO_SORT_TYPE sort,
+    const struct memo_filter *filter)
+{
+    char query[QUERY_MAXLEN] = {0};
+    char filter_exp[256];
+    sqlite3_stmt *stmt = NULL;
+    int rc;
+
+    _get_filter_exp(filter, filter_exp, sizeof(filter_exp));
+    snprintf(query, sizeof(query),
+        "SELECT " ITER_COLUMNS " "
+        "FROM memo WHERE delete_time = -1%s AND " SEARCH_MATCH_EXP " "
+        "ORDER BY %s LIMIT %d OFFSET %d",
+        filter_exp, _get_sort_exp(sort), limit, offset);
+    LOGD("[query] : %s\n", query);
+    rc = sqlite3_prepare_v2(db, query, -1, &stmt, NULL);
+    retvm_if(rc != SQLITE_OK, NULL, "SQL error : %s", sqlite3_errmsg(db));
+    sqlite3_bind_text(stmt, 1, search_str, -1, SQLITE_TRANSIENT);
+    return stmt;
+}
+
+int search_data_filtered(sqlite3 *db, const char *search_str, int limit, int offset, MEMO_SORT_TYPE sort,
+    const struct memo_filter *filter, memo_data_iterate_cb_t cb, void *user_data)
+{
+    sqlite3_stmt *stmt;
+    int rc;
+
+    retvm_if(db == NULL, -1, "db handler is NULL");
+    retvm_if(search_str == NULL, -1, "search string is NULL");
+
+    stmt = _search_prepare(db, search_str, limit, offset, sort, filter);
+    retv_if(stmt == NULL, -1);
+    rc = _iterate_stmt(stmt, MEMO_STAT_SEARCH, cb, user_data);
+    sqlite3_finalize(stmt);
+    return rc;
+}
+
+int search_data_ex(sqlite3 *db, const char *search_str, int limit, int offset, MEMO_SORT_TYPE sort,
+    memo_data_iterate_ex_cb_t cb, void *user_data)
+{
+    sqlite3_stmt *stmt;
+    int rc;
+
+    retvm_if(db == NULL, -1, "db handler is NULL");
+    retvm_if(search_str == NULL, -1, "search string is NULL");
+    retvm_if(cb == NULL, -1, "iterator callback is NULL");
+
+    stmt = _search_prepare(db, search_str, limit, offset, sort, NULL);
+    retv_if(stmt == NULL, -1);
+    rc = _iterate_stmt_ex(stmt, MEMO_STAT_SEARCH, NULL, cb, user_data);
+    sqlite3_finalize(stmt);
+    return rc;
+}
+
+int search_data(sqlite3 *db, const char *search_str, int limit, int offset, MEMO_SORT_TYPE sort,
+    memo_data_iterate_cb_t cb, void *user_data)
+{
+    return search_data_filtered(db, search_str, limit, offset, sort, NULL, cb, user_data);
+}
+
+/**
+ * @brief     Call cb for a page of the live memos matching filter
+ *
+ * @param     [in] limit           -1 for all
+ */
+int all_data_filtered(sqlite3 *db, int limit, int offset, MEMO_SORT_TYPE sort,
+    const struct memo_filter *filter, memo_data_iterate_cb_t cb, void *user_data)
+{
+    retvm_if(db == NULL, -1, "db handler is NULL");
+    retvm_if(cb == NULL, -1, "iterator callback is NULL");
+
+    char query[QUERY_MAXLEN];
+    char filter_exp[256];
+
+    _get_filter_exp(filter, filter_exp, sizeof(filter_exp));
+    snprintf(query, sizeof(query),
+        "SELECT " ITER_COLUMNS " FROM memo where delete_time = -1%s ORDER BY %s LIMIT %d OFFSET %d",
+        filter_exp, _get_sort_exp(sort), limit, offset);
+    return _iterate(db, query, MEMO_STAT_LIST, cb, user_data);
+}
+
+int all_data(sqlite3 *db, memo_data_iterate_cb_t cb, void *user_data)
+{
+    return all_data_filtered(db, -1, 0, MEMO_SORT_CREATE_TIME, NULL, cb, user_data);
+}
+
+/**
+ * @brief     Call cb for the live memos newest first, from cursor on
+ *
+ * @return    number of memos handed to cb or -1 (Failed)
+ */
+int all_data_ex(sqlite3 *db, int limit, int offset, memo_cursor_t *cursor,
+    memo_data_iterate_ex_cb_t cb, void *user_data)
+{
+    sqlite3_stmt *stmt = NULL;
+    int from = cursor != NULL && cursor->id > 0;
+    int rc;
+
+    retvm_if(db == NULL, -1, "db handler is NULL");
+    retvm_if(cb == NULL, -1, "iterator callback is NULL");
+
+    rc = sqlite3_prepare_v2(db, from
+            ? "SELECT " ITER_COLUMNS ", create_utime FROM memo where delete_time = -1 "
+              "AND (create_utime, id) < (?3, ?4) ORDER BY create_utime DESC, id DESC LIMIT ?1 OFFSET ?2"
+            : "SELECT " ITER_COLUMNS ", create_utime FROM memo where delete_time = -1 "
+              "ORDER BY create_utime DESC, id DESC LIMIT ?1 OFFSET ?2", -1, &stmt, NULL);
+    retvm_if(rc != SQLITE_OK, -1, "SQL error : %s", sqlite3_errmsg(db));
+    sqlite3_bind_int(stmt, 1, limit);
+    sqlite3_bind_int(stmt, 2, offset);
+    if (from) {
+        sqlite3_bind_int64(stmt, 3, cursor->create_utime);
+        sqlite3_bind_int(stmt, 4, cursor->id);
+    }
+    rc = _iterate_stmt_ex(stmt, MEMO_STAT_LIST, cursor, cb, user_data);
+    sqlite3_finalize(stmt);
+    return rc;
+}
+
+/*
+ * Search session: the memos matching the last search string are kept in a temp table.
+ * A search string containing the previous one can only match a subset of them, so the
+ * next keystroke re-checks the candidates instead of the whole table. Any add, edit or
+ * delete bumps max(modi_utime), which throws the candidates away.
+ *
+ * The table is filled lazily, newest first: it holds every match created at or after
+ * the scan position (last_utime, last_id), and the scan continues from there only when
+ * a page needs more. Other sort orders complete the scan first.
+ */
+enum {
+    SEARCH_STAMP,
+    SEARCH_CLEAR,
+    SEARCH_NARROW,
+    SEARCH_SCAN,
+    SEARCH_SCAN_FROM,
+    SEARCH_INSERT,
+    SEARCH_PAGE,
+    SEARCH_STMTS,
+};
+
+struct memo_search_session {
+    sqlite3 *db;
+    char table[32];
+    sqlite3_stmt *stmt[SEARCH_STMTS]; /* prepared on first use */
+    MEMO_SORT_TYPE page_sort; /* of stmt[SEARCH_PAGE] */
+    char *search_str; /* of the candidates, NULL when there are none */
+    int64_t stamp; /* max(modi_utime) when the candidates were collected */
+    int count; /* rows of table */
+    int scanned; /* the scan position is valid */
+    int complete; /* the scan reached the oldest memo */
+    int64_t last_utime;
+    int last_id;
+};
+
+memo_search_session_t *search_session_open(sqlite3 *db)
+{
+    static int serial = 0;
+    memo_search_session_t *s;
+    char query[128];
+
+    retvm_if(db == NULL, NULL, "db handler is NULL");
+
+    s = (memo_search_session_t *)db_calloc(1, sizeof(memo_search_session_t));
+    retv_if(s == NULL, NULL);
+    s->db = db;
+    snprintf(s->table, sizeof(s->table), "memo_search_%d", ++serial);
+    snprintf(query, sizeof(query), "create temp table %s (id INTEGER PRIMARY KEY)", s->table);
+    if (_exec(db, query) == -1) {
+        db_free(s);
+        return NULL;
+    }
+    return s;
+}
+
+/* statement i of the session, reset and ready to be bound */
+static sqlite3_stmt *_search_stmt(memo_search_session_t *s, int i, MEMO_SORT_TYPE sort)
+{
+    char query[QUERY_MAXLEN];
+
+    if (i == SEARCH_PAGE && s->stmt[i] != NULL && s->page_sort != sort) {
+        sqlite3_finalize(s->stmt[i]);
+        s->stmt[i] = NULL;
+    }
+    if (s->stmt[i] != NULL) {
+        sqlite3_reset(s->stmt[i]);
+        sqlite3_clear_bindings(s->stmt[i]);
+        return s->stmt[i];
+    }
+
+    switch (i) {
+    case SEARCH_STAMP:
+        snprintf(query, sizeof(query), "select ifnull(max(modi_utime), 0) from memo");
+        break;
+    case SEARCH_CLEAR:
+        snprintf(query, sizeof(query), "delete from temp.%s", s->table);
+        break;
+    case SEARCH_NARROW:
+        snprintf(query, sizeof(query), "delete from temp.%s where "
+                "(select " SEARCH_MATCH_EXP " from memo where memo.id = temp.%s.id) is not 1",
+                s->table, s->table);
+        break;
+    case SEARCH_SCAN:
+    case SEARCH_SCAN_FROM:
+        snprintf(query, sizeof(query), "select id, create_utime from memo where delete_time = -1 %s AND "
+                SEARCH_MATCH_EXP " order by create_utime DESC, id DESC limit ?4",
+                i == SEARCH_SCAN_FROM ? "AND (create_utime, id) < (?2, ?3)" : "");
+        break;
+    case SEARCH_INSERT:
+        snprintf(query, sizeof(query), "insert into temp.%s (id) values (?)", s->table);
+        break;
+    case SEARCH_PAGE:
+        snprintf(query, sizeof(query),
+            "SELECT " ITER_COLUMNS " FROM memo WHERE id IN (select id from temp.%s) "
+            "ORDER BY %s LIMIT ?1 OFFSET ?2",
+            s->table, _get_sort_exp(sort));
+        s->page_sort = sort;
+        break;
+    default:
+        return NULL;
+    }
+    if (sqlite3_prepare_v2(s->db, query, -1, &s->stmt[i], NULL) != SQLITE_OK) {
+        ERR("SQL error : %s", sqlite3_errmsg(s->db));
+        sqlite3_finalize(s->stmt[i]);
+        s->stmt[i] = NULL;
+    }
+    return s->stmt[i];
+}
+
+/* bind ?1 of stmt to search_str */
+static void _search_bind(sqlite3_stmt *stmt, const char *search_str)
+{
+    sqlite3_bind_text(stmt, 1, search_str, -1, SQLITE_TRANSIENT);
+}
+
+/* step a statement returning no rows */
+static int _search_step(memo_search_session_t *s, sqlite3_stmt *stmt)
+{
+    int rc;
+
+    retv_if(stmt == NULL, -1);
+    rc = sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+    retvm_if(rc != SQLITE_DONE, -1, "SQL error : %s", sqlite3_errmsg(s->db));
+    return 0;
+}
+
+/* continue the scan until the table holds need rows, need -1 for the whole scan */
+static int _search_scan(memo_search_session_t *s, const char *search_str, int need)
+{
+    sqlite3_stmt *stmt;
+    sqlite3_stmt *ins;
+    int want = need < 0 ? -1 : need - s->count;
+    int found = 0;
+    int rc;
+
+    if (s->complete || (need >= 0 && s->count >= need)) {
+        return 0;
+    }
+
+    stmt = _search_stmt(s, s->scanned ? SEARCH_SCAN_FROM : SEARCH_SCAN, 0);
+    ins = _search_stmt(s, SEARCH_INSERT, 0);
+    retv_if(stmt == NULL || ins == NULL, -1);
+    _search_bind(stmt, search_str);
+    if (s->scanned) {
+        sqlite3_bind_int64(stmt, 2, s->last_utime);
+        sqlite3_bind_int(stmt, 3, s->last_id);
+    }
+    sqlite3_bind_int(stmt, 4, want);
+
+    while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+        s->last_id = INT(stmt, 0);
+        s->last_utime = INT64(stmt, 1);
+        s->scanned = 1;
+        sqlite3_bind_int(ins, 1, s->last_id);
+        if (_search_step(s, ins) == -1) {
+            break;
         }
+        found++;
+    }
+    sqlite3_reset(stmt);
+    s->count += found;
+    retvm_if(rc != SQLITE_DONE, -1, "SQL error : %s", sqlite3_errmsg(s->db));
+
+    if (want < 0 || found < want) {
+        s->complete = 1;
     }
-    rc = sqlite3_finalize(stmt);
-    free(md);
     return 0;
 }
 
+int search_session_data(memo_search_session_t *s, const char *search_str, int limit, int offset,
+    MEMO_SORT_TYPE sort, memo_data_iterate_cb_t cb, void *user_data)
+{
+    sqlite3_stmt *stmt;
+    int64_t stamp = -1;
+    int rc = 0;
+
+    retvm_if(s == NULL, -1, "search session is NULL");
+    retvm_if(search_str == NULL, -1, "search string is NULL");
+    retvm_if(cb == NULL, -1, "iterator callback is NULL");
+
+    stmt = _search_stmt(s, SEARCH_STAMP, 0);
+    retv_if(stmt == NULL, -1);
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        stamp = INT64(stmt, 0);
+    }
+    sqlite3_reset(stmt);
+
+    if (s->search_str != NULL && stamp == s->stamp && strstr(search_str, s->search_str) != NULL) {
+        if (strcmp(search_str, s->search_str) != 0) {
+            stmt = _search_stmt(s, SEARCH_NARROW, 0);
+            if (stmt != NULL) {
+                _search_bind(stmt, search_str);
+            }
+            rc = _search_step(s, stmt);
+            s->count -= rc == 0 ? sqlite3_changes(s->db) : 0;
+        }
+    } else {
+        rc = _search_step(s, _search_stmt(s, SEARCH_CLEAR, 0));
+        s->count = 0;
+        s->scanned = 0;
+        s->complete = 0;
+    }
+    db_free(s->search_str);
+    s->search_str = NULL;
+    retv_if(rc == -1, -1);
+
+    /* only the newest first order can be served from a partial scan */
+    if (sort == MEMO_SORT_CREATE_TIME && limit >= 0) {
+        rc = _search_scan(s, search_str, offset + limit);
+    } else {
+        rc = _search_scan(s, search_str, -1);
+    }
+    retv_if(rc == -1, -1);
+    s->search_str = db_strdup(search_str);
+    s->stamp = stamp;
+
+    stmt = _search_stmt(s, SEARCH_PAGE, sort);
+    retv_if(stmt == NULL, -1);
+    sqlite3_bind_int(stmt, 1, limit);
+    sqlite3_bind_int(stmt, 2, offset);
+    rc = _iterate_stmt(stmt, MEMO_STAT_SEARCH, cb, user_data);
+    sqlite3_reset(stmt);
+    return rc;
+}
+
+void search_session_close(memo_search_session_t *s)
+{
+    char query[64];
+    int i;
+
+    ret_if(s == NULL);
+    for (i = 0; i < SEARCH_STMTS; i++) {
+        sqlite3_finalize(s->stmt[i]);
+    }
+    snprintf(query, sizeof(query), "drop table if exists temp.%s", s->table);
+    _exec(s->db, query);
+    db_free(s->search_str);
+    db_free(s);
+}
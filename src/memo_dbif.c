@@ -21,11 +21,25 @@
 #include <unistd.h>
 #include <limits.h>
 #include <fcntl.h>
+#include <pthread.h>
 #include <vconf.h>
 
 #include "memo-log.h"
 #include "memo-db.h"
 #include "db.h"
+#include "db-compress.h"
+#include "db-chunk.h"
+#include "db-snapshot.h"
+#include "db-stats.h"
+#include "db-doodle.h"
+#include "db-thumb.h"
+#include "db-export.h"
+#include "db-import.h"
+#include "db-collate.h"
+#include "db-psearch.h"
+#include "db-busy.h"
+#include "db-alloc.h"
+#include "db-budget.h"
 
 #ifndef MEMOAPI
 #define MEMOAPI __attribute__ ((visibility("default")))
@@ -36,8 +50,15 @@
 
 static void (*g_data_monitor) (void *) = NULL;
 static int trans_count = 0;
-static DBHandle *db;
+static DBHandle *g_db;
+static char *g_db_name = NULL;
+static pthread_mutex_t g_db_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t g_prewarm_thread;
+static int g_prewarm_started = 0;
 static int ref_count = 0;
+static char *snapshot_path = NULL;
+static int export_threads = 1;
+static char *import_doodle_dir = NULL;
 
 /******************************
 * External API
@@ -53,8 +74,10 @@ MEMOAPI int memo_init(char *dbfile)
     char *name = NULL;
     char defname[PATH_MAX];
 
-    if(db) {
+    pthread_mutex_lock(&g_db_lock);
+    if(g_db_name) {
         ref_count++;
+        pthread_mutex_unlock(&g_db_lock);
         return 0;
     }
 
@@ -68,9 +91,64 @@ MEMOAPI int memo_init(char *dbfile)
     }
 
     DBG("DB name : %s", name);
-    db = db_init(name);
-    retv_if(db == NULL, -1);
+    /* the db is opened by the first query, see _db() */
+    g_db_name = db_strdup(name);
+    if (g_db_name == NULL) {
+        pthread_mutex_unlock(&g_db_lock);
+        return -1;
+    }
     ref_count++;
+    pthread_mutex_unlock(&g_db_lock);
+    return 0;
+}
+
+/**
+ * @fn            static DBHandle *_db(void)
+ * @brief        get db handle, opening the db on first use
+ * @return        db handle or NULL if memo_init was not called or open failed
+ */
+static DBHandle *_db(void)
+{
+    DBHandle *h;
+
+    pthread_mutex_lock(&g_db_lock);
+    if (g_db == NULL && g_db_name != NULL) {
+        g_db = db_init(g_db_name);
+    }
+    h = g_db;
+    pthread_mutex_unlock(&g_db_lock);
+    return h;
+}
+
+static void *_prewarm(void *data)
+{
+    _db();
+    return NULL;
+}
+
+/**
+ * @fn            int memo_prewarm(void)
+ * @brief        open db in a background thread so the first query does not wait for it
+ * @return        Return 0 (Success) or -1 (Failed)
+ */
+MEMOAPI int memo_prewarm(void)
+{
+    int rc;
+
+    pthread_mutex_lock(&g_db_lock);
+    if (g_db_name == NULL) {
+        pthread_mutex_unlock(&g_db_lock);
+        ERR("DB is not initialized, need memo_init");
+        return -1;
+    }
+    if (g_db != NULL || g_prewarm_started) {
+        pthread_mutex_unlock(&g_db_lock);
+        return 0;
+    }
+    rc = pthread_create(&g_prewarm_thread, NULL, _prewarm, NULL);
+    g_prewarm_started = (rc == 0);
+    pthread_mutex_unlock(&g_db_lock);
+    retvm_if(rc != 0, -1, "pthread_create failed : %d", rc);
     return 0;
 }
 
@@ -81,11 +159,75 @@ MEMOAPI int memo_init(char *dbfile)
  */
 MEMOAPI void memo_fini(void)
 {
+    int started;
+
+    pthread_mutex_lock(&g_db_lock);
     ref_count--;
-    if (ref_count == 0) {
-        db_fini(db);
-        db = NULL;
+    if (ref_count > 0) {
+        pthread_mutex_unlock(&g_db_lock);
+        return;
+    }
+    started = g_prewarm_started;
+    g_prewarm_started = 0;
+    pthread_mutex_unlock(&g_db_lock);
+
+    if (started) {
+        pthread_join(g_prewarm_thread, NULL);
+    }
+    db_doodle_stop();
+    db_snapshot_stop();
+
+    pthread_mutex_lock(&g_db_lock);
+    db_fini(g_db);
+    g_db = NULL;
+    db_free(g_db_name);
+    g_db_name = NULL;
+    db_free(snapshot_path);
+    snapshot_path = NULL;
+    db_free(import_doodle_dir);
+    import_doodle_dir = NULL;
+    pthread_mutex_unlock(&g_db_lock);
+}
+
+/**
+ * @fn            int memo_set_allocator(memo_malloc_fn malloc_fn, memo_free_fn free_fn, memo_realloc_fn realloc_fn, void *ctx, bool sqlite)
+ * @brief        set the allocator of the library, before memo_init
+ * @return        Return 0 (Success) or -1 (Failed)
+ */
+MEMOAPI int memo_set_allocator(memo_malloc_fn malloc_fn, memo_free_fn free_fn, memo_realloc_fn realloc_fn,
+        void *ctx, bool sqlite)
+{
+    int rc;
+
+    pthread_mutex_lock(&g_db_lock);
+    if (g_db_name != NULL) {
+        pthread_mutex_unlock(&g_db_lock);
+        ERR("The library is in use, call it before memo_init");
+        return -1;
     }
+    rc = db_alloc_set(malloc_fn, free_fn, realloc_fn, ctx, sqlite);
+    pthread_mutex_unlock(&g_db_lock);
+    return rc;
+}
+
+/**
+ * @fn            int memo_set_memory_budget(const struct memo_memory_budget *budget)
+ * @brief        set the memory budget, before memo_init
+ * @return        Return 0 (Success) or -1 (Failed)
+ */
+MEMOAPI int memo_set_memory_budget(const struct memo_memory_budget *budget)
+{
+    int rc;
+
+    pthread_mutex_lock(&g_db_lock);
+    if (g_db_name != NULL) {
+        pthread_mutex_unlock(&g_db_lock);
+        ERR("The library is in use, call it before memo_init");
+        return -1;
+    }
+    rc = db_budget_set(budget);
+    pthread_mutex_unlock(&g_db_lock);
+    return rc;
 }
 
 /**
@@ -95,7 +237,7 @@ MEMOAPI void memo_fini(void)
  */
 MEMOAPI struct memo_data* memo_create_data()
 {
-    return (struct memo_data *)calloc(1, sizeof(struct memo_data));
+    return (struct memo_data *)db_calloc(1, sizeof(struct memo_data));
 }
 
 /**
@@ -108,6 +250,9 @@ MEMOAPI struct memo_data* memo_get_data(int id)
 {
     int rc;
     struct memo_data *md;
+    unsigned long long start = STAT_BEGIN();
+
+    DBHandle *db = _db();
 
     retvm_if(db == NULL, NULL, "DB Handle is null, need memo_init");
     retvm_if(id < 1, NULL, "Invalid memo data id : %d", id);
@@ -116,6 +261,7 @@ MEMOAPI struct memo_data* memo_get_data(int id)
     retv_if(md == NULL, md);
 
     rc = get_data(db, id, md);
+    STAT_END(MEMO_STAT_GET, start, rc);
     if(rc) {
         memo_free_data(md);
         return NULL;
@@ -135,15 +281,41 @@ MEMOAPI void memo_free_data(struct memo_data *md)
     ret_if(md == NULL);
 
     if(md->content)
-        free(md->content);
+        db_free(md->content);
 
     if(md->comment)
-        free(md->comment);
+        db_free(md->comment);
 
     if(md->doodle_path)
-        free(md->doodle_path);
+        db_free(md->doodle_path);
+
+    db_free(md);
+}
+
+/**
+ * @fn            memo_data_t *memo_get_data_many(const int *ids, int n)
+ * @brief        Get memo data of several ids in one block
+ * @param[in]    ids    db ids
+ * @param[in]    n    number of ids
+ * @return        n memo data, id 0 for the missing ones, or NULL (Failed)
+ */
+MEMOAPI memo_data_t *memo_get_data_many(const int *ids, int n)
+{
+    memo_data_t *mds;
+    unsigned long long start = STAT_BEGIN();
+    DBHandle *db = _db();
+
+    retvm_if(db == NULL, NULL, "DB Handle is null, need memo_init");
+    retvm_if(ids == NULL || n < 1, NULL, "Invalid argument");
 
-    free(md);
+    mds = get_data_many(db, ids, n);
+    STAT_END(MEMO_STAT_GET, start, mds == NULL);
+    return mds;
+}
+
+MEMOAPI void memo_free_data_many(memo_data_t *mds)
+{
+    db_free(mds);
 }
 
 /**
@@ -154,8 +326,62 @@ MEMOAPI void memo_free_data(struct memo_data *md)
  */
 MEMOAPI int memo_add_data(struct memo_data *md)
 {
+    DBHandle *db = _db();
+    int rc;
+    unsigned long long start = STAT_BEGIN();
+
     retvm_if(db == NULL, -1, "DB Handle is null, need memo_init");
-    return insert_data(db, md);
+    rc = insert_data(db, md);
+    STAT_END(MEMO_STAT_INSERT, start, rc == -1);
+    return rc;
+}
+
+/**
+ * @fn            int memo_add_data_if_absent(struct memo_data *md)
+ * @brief        insert memo data unless an identical memo exists
+ * @param[in]    md    memo data struct
+ * @return        Return id, 0 (exists) or -1 (Failed)
+ */
+MEMOAPI int memo_add_data_if_absent(struct memo_data *md)
+{
+    DBHandle *db = _db();
+    int rc;
+    unsigned long long start = STAT_BEGIN();
+
+    retvm_if(db == NULL, -1, "DB Handle is null, need memo_init");
+    rc = insert_data_if_absent(db, md);
+    STAT_END(MEMO_STAT_INSERT, start, rc == -1);
+    return rc;
+}
+
+/**
+ * @fn            int memo_get_duplicates(int id, int *ids, int len)
+ * @brief        get the memos identical to memo id
+ * @param[in]    id    memo id
+ * @param[out]    ids    ids of the duplicates
+ * @param[in]    len    size of ids
+ * @return        Return the number of ids (Success) or -1 (Failed)
+ */
+MEMOAPI int memo_get_duplicates(int id, int *ids, int len)
+{
+    DBHandle *db = _db();
+    retvm_if(db == NULL, -1, "DB Handle is null, need memo_init");
+    retvm_if(id < 1, -1, "Invalid memo data ID");
+    return get_duplicates(db, id, ids, len);
+}
+
+/**
+ * @fn            int memo_foreach_duplicate(memo_duplicate_cb_t cb, void *user_data)
+ * @brief        call cb for every memo identical to an older one
+ * @param[in]    cb    callback
+ * @param[in]    user_data    passed to cb
+ * @return        Return the number of duplicates (Success) or -1 (Failed)
+ */
+MEMOAPI int memo_foreach_duplicate(memo_duplicate_cb_t cb, void *user_data)
+{
+    DBHandle *db = _db();
+    retvm_if(db == NULL, -1, "DB Handle is null, need memo_init");
+    return foreach_duplicate(db, cb, user_data);
 }
 
 /**
@@ -166,10 +392,33 @@ MEMOAPI int memo_add_data(struct memo_data *md)
  */
 MEMOAPI int memo_mod_data(struct memo_data *md)
 {
+    DBHandle *db = _db();
     retvm_if(db == NULL, -1, "DB Handle is null, need memo_init");
     retvm_if(md == NULL, -1, "Update data is null");
     retvm_if(md->id < 1, -1, "Invalid memo data ID");
-    return update_data(db, md);
+    unsigned long long start = STAT_BEGIN();
+    int rc = update_data(db, md);
+    STAT_END(MEMO_STAT_UPDATE, start, rc == -1);
+    return rc;
+}
+
+/**
+ * @fn            int memo_mod_data_if_unchanged(struct memo_data *md, int64_t modi_utime)
+ * @brief        Update data in DB if its modified time is still modi_utime
+ * @param[in]    md    The pointer of memo data
+ * @param[in]    modi_utime    expected modified time in microseconds
+ * @return        Return 0 (Success), MEMO_ERROR_CONFLICT or -1 (Failed)
+ */
+MEMOAPI int memo_mod_data_if_unchanged(struct memo_data *md, int64_t modi_utime)
+{
+    DBHandle *db = _db();
+    retvm_if(db == NULL, -1, "DB Handle is null, need memo_init");
+    retvm_if(md == NULL, -1, "Update data is null");
+    retvm_if(md->id < 1, -1, "Invalid memo data ID");
+    unsigned long long start = STAT_BEGIN();
+    int rc = update_data_if_unchanged(db, md, modi_utime);
+    STAT_END(MEMO_STAT_UPDATE, start, rc == -1);
+    return rc;
 }
 
 /**
@@ -180,13 +429,155 @@ MEMOAPI int memo_mod_data(struct memo_data *md)
  */
 MEMOAPI int memo_del_data(int id)
 {
-    char buf[128] = {0};
+    DBHandle *db = _db();
+    retvm_if(db == NULL, -1, "DB Handle is null, need memo_init");
+    retvm_if(id < 1, -1, "Invalid memo data ID");
+    /* the doodle file is removed in background after the delete is committed */
+    unsigned long long start = STAT_BEGIN();
+    int rc = remove_data(db, id);
+    STAT_END(MEMO_STAT_DELETE, start, rc == -1);
+    return rc;
+}
+
+/**
+ * @fn            int memo_del_data_many(const int *ids, int count)
+ * @brief        remove data of several ids in one transaction
+ * @param[in]    ids    db ids
+ * @param[in]    count    number of ids
+ * @return        the number of removed memos or -1 (Failed)
+ */
+MEMOAPI int memo_del_data_many(const int *ids, int count)
+{
+    DBHandle *db = _db();
+    retvm_if(db == NULL, -1, "DB Handle is null, need memo_init");
+    retvm_if(ids == NULL || count < 1, -1, "Invalid argument");
+    unsigned long long start = STAT_BEGIN();
+    int rc = remove_data_many(db, ids, count);
+    STAT_END(MEMO_STAT_DELETE, start, rc == -1);
+    return rc;
+}
+
+/**
+ * @fn            int memo_doodle_reap_orphans(const char *dir)
+ * @brief        remove the doodle files of dir which no memo refers to
+ * @param[in]    dir    doodle directory, absolute path
+ * @return        the number of files queued for removal or -1 (Failed)
+ */
+MEMOAPI int memo_doodle_reap_orphans(const char *dir)
+{
+    DBHandle *db = _db();
+    retvm_if(db == NULL, -1, "DB Handle is null, need memo_init");
+    return db_doodle_scan_orphans(db, dir);
+}
+
+/**
+ * @fn            int memo_get_thumbnail(int id, unsigned char **buf, int *len)
+ * @brief        get the doodle thumbnail of a memo
+ * @param[in]    id    db id
+ * @param[out]    buf    RGBA pixels, free with memo_free_thumbnail
+ * @param[out]    len    length of buf
+ * @return        Return 0 (Success) or -1 (Failed)
+ */
+MEMOAPI int memo_get_thumbnail(int id, unsigned char **buf, int *len)
+{
+    DBHandle *db = _db();
     retvm_if(db == NULL, -1, "DB Handle is null, need memo_init");
     retvm_if(id < 1, -1, "Invalid memo data ID");
-    /* delete doodle */
-    snprintf(buf, 128, "/opt/apps/com.samsung.memo/data/doodle/%d.png", id);
-    remove(buf);
-    return remove_data(db, id);
+    return db_thumb_get(db, id, buf, len);
+}
+
+MEMOAPI void memo_free_thumbnail(unsigned char *buf)
+{
+    db_free(buf);
+}
+
+/**
+ * @fn            int memo_export(int fd, int format)
+ * @brief        write all memos to fd
+ * @param[in]    fd    file descriptor
+ * @param[in]    format    MEMO_EXPORT_FORMAT
+ * @return        Return 0 (Success) or -1 (Failed)
+ */
+MEMOAPI int memo_export(int fd, int format)
+{
+    DBHandle *db = _db();
+    retvm_if(db == NULL, -1, "DB Handle is null, need memo_init");
+    return db_export(db, fd, format, export_threads);
+}
+
+MEMOAPI int memo_export_set_threads(int threads)
+{
+    retvm_if(threads < 1 || threads > EXPORT_MAX_THREADS, -1, "Invalid number of threads : %d", threads);
+    export_threads = threads;
+    return 0;
+}
+
+/**
+ * @fn            int memo_backup(const char *dest)
+ * @brief        copy the db to dest
+ * @param[in]    dest    path of the copy
+ * @return        Return 0 (Success) or -1 (Failed)
+ */
+MEMOAPI int memo_backup(const char *dest)
+{
+    DBHandle *db = _db();
+    retvm_if(db == NULL, -1, "DB Handle is null, need memo_init");
+    return db_backup(db, dest);
+}
+
+/**
+ * @fn            int memo_import(int fd, MEMO_IMPORT_POLICY policy, memo_import_progress_cb cb, void *user_data)
+ * @brief        add the memos of an archive written by memo_export
+ * @param[in]    fd    file descriptor
+ * @param[in]    policy    MEMO_IMPORT_POLICY
+ * @param[in]    cb    progress callback, may be NULL
+ * @param[in]    user_data    passed to cb
+ * @return        the number of added and overwritten memos or -1 (Failed)
+ */
+MEMOAPI int memo_import(int fd, MEMO_IMPORT_POLICY policy, memo_import_progress_cb cb, void *user_data)
+{
+    DBHandle *db = _db();
+    char *dir = NULL;
+    int rc;
+
+    retvm_if(db == NULL, -1, "DB Handle is null, need memo_init");
+
+    pthread_mutex_lock(&g_db_lock);
+    if (import_doodle_dir) {
+        dir = db_strdup(import_doodle_dir);
+    }
+    pthread_mutex_unlock(&g_db_lock);
+
+    rc = db_import(db, fd, policy, dir, cb, user_data);
+    db_free(dir);
+    return rc;
+}
+
+MEMOAPI int memo_import_set_doodle_dir(const char *dir)
+{
+    char *t = NULL;
+
+    retvm_if(dir && dir[0] != '/', -1, "Doodle dir must be absolute : %s", dir);
+    if (dir) {
+        t = db_strdup(dir);
+        retv_if(t == NULL, -1);
+    }
+
+    pthread_mutex_lock(&g_db_lock);
+    db_free(import_doodle_dir);
+    import_doodle_dir = t;
+    pthread_mutex_unlock(&g_db_lock);
+    return 0;
+}
+
+/**
+ * @fn            void memo_doodle_flush(void)
+ * @brief        wait until the queued doodle files are removed
+ * @return        None
+ */
+MEMOAPI void memo_doodle_flush(void)
+{
+    db_doodle_flush();
 }
 
 /**
@@ -198,9 +589,13 @@ MEMOAPI struct memo_data_list* memo_get_all_data_list(void)
 {
     struct memo_data_list *mdl;
 
+    DBHandle *db = _db();
+
     retvm_if(db == NULL, NULL, "DB Handle is null, need memo_init");
 
+    unsigned long long start = STAT_BEGIN();
     mdl = get_all_data_list(db);
+    STAT_END(MEMO_STAT_LIST, start, mdl == NULL);
     return mdl;
 }
 
@@ -218,8 +613,10 @@ MEMOAPI void memo_free_data_list(struct memo_data_list *mdl)
     while(t) {
         d = t;
         t = t->next;
-        if(d->md.content) free(d->md.content);
-        free(d);
+        if(d->md.content) db_free(d->md.content);
+        if(d->md.comment) db_free(d->md.comment);
+        if(d->md.doodle_path) db_free(d->md.doodle_path);
+        db_free(d);
     }
 }
 
@@ -231,9 +628,70 @@ MEMOAPI void memo_free_data_list(struct memo_data_list *mdl)
  */
 MEMOAPI time_t memo_get_modified_time(int id)
 {
+    DBHandle *db = _db();
+    retvm_if(db == NULL, -1, "DB Handle is null, need memo_init");
+
+    unsigned long long start = STAT_BEGIN();
+    time_t t = get_modtime(db, id);
+    STAT_END(MEMO_STAT_GET, start, t == -1);
+    return t;
+}
+
+/**
+ * @fn            int64_t memo_get_modified_utime(int id)
+ * @brief        Get modified time in microseconds
+ * @param[in]    id    db id, 0 for the latest of the db
+ * @return        modified time
+ */
+MEMOAPI int64_t memo_get_modified_utime(int id)
+{
+    DBHandle *db = _db();
+    retvm_if(db == NULL, -1, "DB Handle is null, need memo_init");
+
+    unsigned long long start = STAT_BEGIN();
+    int64_t t = get_modutime(db, id);
+    STAT_END(MEMO_STAT_GET, start, t == -1);
+    return t;
+}
+
+/**
+ * @fn            int memo_probe(int id, bool *exists, int64_t *modi_utime, bool *deleted)
+ * @brief        Get whether a memo exists or is deleted and its modified time
+ * @param[in]    id    db id
+ * @return        Return 0 (Success) or -1 (Failed)
+ */
+MEMOAPI int memo_probe(int id, bool *exists, int64_t *modi_utime, bool *deleted)
+{
+    struct memo_probe p;
+    DBHandle *db = _db();
     retvm_if(db == NULL, -1, "DB Handle is null, need memo_init");
 
-    return get_modtime(db, id);
+    unsigned long long start = STAT_BEGIN();
+    int rc = probe_data(db, id, &p);
+    STAT_END(MEMO_STAT_GET, start, rc == -1);
+    retv_if(rc == -1, -1);
+    if (exists) {
+        *exists = p.exists;
+    }
+    if (modi_utime) {
+        *modi_utime = p.modi_utime;
+    }
+    if (deleted) {
+        *deleted = p.deleted;
+    }
+    return 0;
+}
+
+MEMOAPI int memo_probe_many(const int *ids, int n, struct memo_probe *probes)
+{
+    DBHandle *db = _db();
+    retvm_if(db == NULL, -1, "DB Handle is null, need memo_init");
+    retvm_if(ids == NULL || probes == NULL || n < 1, -1, "Invalid argument");
+
+    unsigned long long start = STAT_BEGIN();
+    int rc = probe_data_many(db, ids, n, probes);
+    STAT_END(MEMO_STAT_GET, start, rc == -1);
+    return rc;
 }
 
 /**
@@ -248,10 +706,13 @@ MEMOAPI time_t memo_get_modified_time(int id)
 MEMOAPI int memo_get_count(int *count)
 {
     int rc;
+    DBHandle *db = _db();
     retvm_if(db == NULL, -1, "DB Handle is null, need memo_init");
     retvm_if(count == NULL, -1, "count pointer is null");
 
+    unsigned long long start = STAT_BEGIN();
     rc = get_data_count(db, count);
+    STAT_END(MEMO_STAT_COUNT, start, rc);
     if(rc) {
         return -1;
     }
@@ -263,9 +724,33 @@ MEMOAPI struct memo_operation_list* memo_get_operation_list(time_t stamp)
 {
     struct memo_operation_list *mol;
 
+    DBHandle *db = _db();
+
     retvm_if(db == NULL, NULL, "DB Handle is null, need memo_init");
 
+    unsigned long long start = STAT_BEGIN();
     mol = get_operation_list(db, stamp);
+    STAT_END(MEMO_STAT_LIST, start, 0);
+    return mol;
+}
+
+/**
+ * @fn            struct memo_operation_list* memo_get_operation_list_since(int64_t ustamp)
+ * @brief        Get operation list since a microsecond stamp
+ * @param[in]    ustamp    modified time in microseconds
+ * @return        operation list
+ */
+MEMOAPI struct memo_operation_list* memo_get_operation_list_since(int64_t ustamp)
+{
+    struct memo_operation_list *mol;
+
+    DBHandle *db = _db();
+
+    retvm_if(db == NULL, NULL, "DB Handle is null, need memo_init");
+
+    unsigned long long start = STAT_BEGIN();
+    mol = get_operation_list_since(db, ustamp);
+    STAT_END(MEMO_STAT_LIST, start, 0);
     return mol;
 }
 
@@ -277,7 +762,7 @@ MEMOAPI void memo_free_operation_list(struct memo_operation_list *mol)
     while(t) {
         d = t;
         t = t->next;
-        free(d);
+        db_free(d);
     }
 }
 
@@ -314,29 +799,264 @@ MEMOAPI void memo_end_trans(void)
     if (trans_count == 0) {
         if(vconf_get_int(VCONFKEY_MEMO_DATA_CHANGE, &value)) {
             LOGD("vconf_get_int FAIL\n");
+            db_stats_trans(0);
         } else {
+            db_stats_trans(1);
             if (value == 0) {
                 vconf_set_int(VCONFKEY_MEMO_DATA_CHANGE, 1);
             } else {
                 vconf_set_int(VCONFKEY_MEMO_DATA_CHANGE, 0);
             }
         }
+        pthread_mutex_lock(&g_db_lock);
+        if (snapshot_path != NULL && g_db != NULL) {
+            db_snapshot_request(g_db, snapshot_path);
+        }
+        pthread_mutex_unlock(&g_db_lock);
     }
 }
 
+MEMOAPI int memo_set_compression(int threshold)
+{
+    retvm_if(threshold < 0, -1, "Invalid compression threshold : %d", threshold);
+    db_compress_set_threshold(threshold);
+    return 0;
+}
+
+MEMOAPI memo_content_stream_t *memo_content_open(int id, int mode)
+{
+    DBHandle *db = _db();
+    retvm_if(db == NULL, NULL, "DB Handle is null, need memo_init");
+    retvm_if(id < 1, NULL, "Invalid memo data ID");
+    return db_content_open(db, id, mode);
+}
+
+MEMOAPI int memo_content_read(memo_content_stream_t *s, char *buf, int len)
+{
+    return db_content_read(s, buf, len);
+}
+
+MEMOAPI int memo_content_write(memo_content_stream_t *s, const char *buf, int len)
+{
+    return db_content_write(s, buf, len);
+}
+
+MEMOAPI int memo_content_close(memo_content_stream_t *s)
+{
+    return db_content_close(s);
+}
+
+MEMOAPI int memo_snapshot_enable(const char *path)
+{
+    DBHandle *db = _db();
+    char *p;
+    int rc;
+
+    retvm_if(db == NULL, -1, "DB Handle is null, need memo_init");
+    p = db_strdup(path ? path : SNAPSHOT_DEFAULT_PATH);
+    retv_if(p == NULL, -1);
+    rc = db_snapshot_publish(db, p);
+
+    pthread_mutex_lock(&g_db_lock);
+    db_free(snapshot_path);
+    snapshot_path = p;
+    pthread_mutex_unlock(&g_db_lock);
+    return rc;
+}
+
+MEMOAPI memo_snapshot_t *memo_snapshot_open(const char *path)
+{
+    return db_snapshot_open(path ? path : SNAPSHOT_DEFAULT_PATH);
+}
+
+MEMOAPI void memo_snapshot_close(memo_snapshot_t *s)
+{
+    db_snapshot_close(s);
+}
+
+MEMOAPI int memo_snapshot_count(memo_snapshot_t *s)
+{
+    return db_snapshot_count(s);
+}
+
+MEMOAPI unsigned long long memo_snapshot_seq(memo_snapshot_t *s)
+{
+    return db_snapshot_seq(s);
+}
+
+MEMOAPI const struct memo_snapshot_record *memo_snapshot_record(memo_snapshot_t *s, int index)
+{
+    return db_snapshot_record(s, index);
+}
+
+MEMOAPI const char *memo_snapshot_preview(memo_snapshot_t *s, const struct memo_snapshot_record *r)
+{
+    return db_snapshot_preview(s, r);
+}
+
+MEMOAPI int memo_snapshot_is_stale(memo_snapshot_t *s)
+{
+    return db_snapshot_is_stale(s);
+}
+
 MEMOAPI int memo_get_indexes(int *aIndex, int len, MEMO_SORT_TYPE sort)
 {
-    return get_indexes(db, aIndex, len, sort);
+    unsigned long long start = STAT_BEGIN();
+    int rc = get_indexes(_db(), aIndex, len, sort);
+    STAT_END(MEMO_STAT_LIST, start, 0);
+    return rc;
 }
 
 MEMOAPI int memo_search_data(const char *search_str, int limit, int offset, MEMO_SORT_TYPE sort,
     memo_data_iterate_cb_t cb, void *user_data)
 {
-    return search_data(db, search_str, limit, offset, sort, cb, user_data);
+    unsigned long long start = STAT_BEGIN();
+    int rc = search_data(_db(), search_str, limit, offset, sort, cb, user_data);
+    STAT_END(MEMO_STAT_SEARCH, start, rc == -1);
+    return rc;
 }
 
 MEMOAPI int memo_all_data(memo_data_iterate_cb_t cb, void *user_data)
 {
-    return all_data(db, cb, user_data);
+    unsigned long long start = STAT_BEGIN();
+    int rc = all_data(_db(), cb, user_data);
+    STAT_END(MEMO_STAT_LIST, start, rc == -1);
+    return rc;
+}
+
+MEMOAPI int memo_all_data_filtered(int limit, int offset, MEMO_SORT_TYPE sort, const struct memo_filter *filter,
+    memo_data_iterate_cb_t cb, void *user_data)
+{
+    unsigned long long start = STAT_BEGIN();
+    int rc = all_data_filtered(_db(), limit, offset, sort, filter, cb, user_data);
+    STAT_END(MEMO_STAT_LIST, start, rc == -1);
+    return rc;
+}
+
+MEMOAPI int memo_search_data_filtered(const char *search_str, int limit, int offset, MEMO_SORT_TYPE sort,
+    const struct memo_filter *filter, memo_data_iterate_cb_t cb, void *user_data)
+{
+    unsigned long long start = STAT_BEGIN();
+    int rc = search_data_filtered(_db(), search_str, limit, offset, sort, filter, cb, user_data);
+    STAT_END(MEMO_STAT_SEARCH, start, rc == -1);
+    return rc;
+}
+
+MEMOAPI int memo_all_data_ex(int limit, int offset, memo_cursor_t *cursor, memo_data_iterate_ex_cb_t cb,
+    void *user_data)
+{
+    unsigned long long start = STAT_BEGIN();
+    int rc = all_data_ex(_db(), limit, offset, cursor, cb, user_data);
+    STAT_END(MEMO_STAT_LIST, start, rc == -1);
+    return rc;
+}
+
+MEMOAPI int memo_search_data_ex(const char *search_str, int limit, int offset, MEMO_SORT_TYPE sort,
+    memo_data_iterate_ex_cb_t cb, void *user_data)
+{
+    unsigned long long start = STAT_BEGIN();
+    int rc = search_data_ex(_db(), search_str, limit, offset, sort, cb, user_data);
+    STAT_END(MEMO_STAT_SEARCH, start, rc == -1);
+    return rc;
+}
+
+MEMOAPI int memo_search_data_parallel(const char *search_str, int limit, int offset, MEMO_SORT_TYPE sort,
+    int threads, memo_data_iterate_cb_t cb, void *user_data)
+{
+    unsigned long long start = STAT_BEGIN();
+    int rc = db_search_parallel(_db(), search_str, limit, offset, sort, threads, cb, user_data);
+    STAT_END(MEMO_STAT_SEARCH, start, rc == -1);
+    return rc;
+}
+
+MEMOAPI int memo_set_collation_locale(const char *locale)
+{
+    DBHandle *db = _db();
+    int rc;
+
+    retv_if(db_collate_set_locale(locale) == -1, -1);
+    if (db == NULL) { /* db_init rebuilds the keys */
+        return 0;
+    }
+    memo_begin_trans();
+    rc = db_collate_refresh(db);
+    memo_end_trans();
+    return rc == -1 ? -1 : 0;
+}
+
+MEMOAPI memo_search_session_t *memo_search_session_open(void)
+{
+    DBHandle *db = _db();
+    retvm_if(db == NULL, NULL, "DB Handle is null, need memo_init");
+    return search_session_open(db);
+}
+
+MEMOAPI int memo_search_session_data(memo_search_session_t *s, const char *search_str, int limit, int offset,
+    MEMO_SORT_TYPE sort, memo_data_iterate_cb_t cb, void *user_data)
+{
+    unsigned long long start = STAT_BEGIN();
+    int rc = search_session_data(s, search_str, limit, offset, sort, cb, user_data);
+    STAT_END(MEMO_STAT_SEARCH, start, rc == -1);
+    return rc;
+}
+
+MEMOAPI void memo_search_session_close(memo_search_session_t *s)
+{
+    search_session_close(s);
+}
+
+MEMOAPI int memo_get_indexes_filtered(int *aIndex, int len, MEMO_SORT_TYPE sort, const struct memo_filter *filter)
+{
+    unsigned long long start = STAT_BEGIN();
+    int rc = get_indexes_filtered(_db(), aIndex, len, sort, filter);
+    STAT_END(MEMO_STAT_LIST, start, rc == -1);
+    return rc;
+}
+
+MEMOAPI int memo_get_count_filtered(const struct memo_filter *filter, int *count)
+{
+    unsigned long long start = STAT_BEGIN();
+    int rc = get_data_count_filtered(_db(), filter, count);
+    STAT_END(MEMO_STAT_COUNT, start, rc == -1);
+    return rc;
+}
+
+MEMOAPI int memo_stats_enable(bool enable)
+{
+    db_stats_enable(enable);
+    return 0;
+}
+
+MEMOAPI int memo_get_stats(struct memo_stats *stats)
+{
+    retvm_if(stats == NULL, -1, "stats pointer is null");
+    pthread_mutex_lock(&g_db_lock);
+    db_stats_get(g_db, stats);
+    pthread_mutex_unlock(&g_db_lock);
+    return 0;
+}
+
+MEMOAPI void memo_reset_stats(void)
+{
+    pthread_mutex_lock(&g_db_lock);
+    db_stats_reset(g_db);
+    pthread_mutex_unlock(&g_db_lock);
+}
+
+MEMOAPI int memo_stats_set_dump_interval(int seconds)
+{
+    retvm_if(seconds < 0, -1, "Invalid interval : %d", seconds);
+    db_stats_set_dump_interval(seconds);
+    return 0;
+}
+
+MEMOAPI int memo_set_busy_timeout(int timeout_ms)
+{
+    return db_busy_set_timeout(timeout_ms);
+}
+
+MEMOAPI int memo_set_busy_backoff(int min_delay_ms, int max_delay_ms)
+{
+    return db_busy_set_backoff(min_delay_ms, max_delay_ms);
 }
 
@@ -0,0 +1,33 @@
+/*
+*
+* Copyright 2012  Samsung Electronics Co., Ltd
+*
+* Licensed under the Flora License, Version 1.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.tizenopensource.org/license
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+
+/*
+ * Local stand-in for db-util, used by off-device builds only.
+ */
+
+#ifndef __MEMO_STUB_DB_UTIL_H__
+#define __MEMO_STUB_DB_UTIL_H__
+
+#include <sqlite3.h>
+
+#define DB_UTIL_REGISTER_HOOK_METHOD 0x00000001
+
+int db_util_open(const char *pszFilePath, sqlite3 **ppDB, int nOption);
+int db_util_close(sqlite3 *pDB);
+
+#endif /* __MEMO_STUB_DB_UTIL_H__ */
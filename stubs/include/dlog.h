@@ -0,0 +1,53 @@
+/*
+*
+* Copyright 2012  Samsung Electronics Co., Ltd
+*
+* Licensed under the Flora License, Version 1.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.tizenopensource.org/license
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+
+/*
+ * Local stand-in for dlog, used by off-device builds only.
+ *
+ * MEMO_STUB_LOG=<min priority>     print to stderr, e.g. 6 for errors only
+ * MEMO_STUB_LOG_RING=<entries>     keep the last entries in memory, see stub_dlog_dump()
+ *
+ * Logs are dropped when neither is set.
+ */
+
+#ifndef __MEMO_STUB_DLOG_H__
+#define __MEMO_STUB_DLOG_H__
+
+#ifndef LOG_TAG
+#define LOG_TAG NULL
+#endif
+
+typedef enum {
+    DLOG_DEBUG = 3,
+    DLOG_INFO,
+    DLOG_WARN,
+    DLOG_ERROR,
+} log_priority;
+
+int stub_dlog_print(log_priority prio, const char *tag, const char *fmt, ...)
+    __attribute__ ((format (printf, 3, 4)));
+
+/* write the ring buffer to fd, oldest entry first */
+void stub_dlog_dump(int fd);
+
+#define LOGD(fmt, arg...) stub_dlog_print(DLOG_DEBUG, LOG_TAG, fmt, ##arg)
+#define LOGI(fmt, arg...) stub_dlog_print(DLOG_INFO, LOG_TAG, fmt, ##arg)
+#define LOGW(fmt, arg...) stub_dlog_print(DLOG_WARN, LOG_TAG, fmt, ##arg)
+#define LOGE(fmt, arg...) stub_dlog_print(DLOG_ERROR, LOG_TAG, fmt, ##arg)
+
+#endif /* __MEMO_STUB_DLOG_H__ */
@@ -0,0 +1,47 @@
+/*
+*
+* Copyright 2012  Samsung Electronics Co., Ltd
+*
+* Licensed under the Flora License, Version 1.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.tizenopensource.org/license
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+
+/*
+ * Local stand-in for vconf, used by off-device builds only.
+ *
+ * Each key is a small text file in $MEMO_STUB_VCONF_DIR (default /tmp/memo-vconf),
+ * named after the key with '/' replaced by '.'. Changes are picked up with inotify,
+ * so other processes using the same directory are notified too.
+ * Unlike vconf, callbacks run on a private thread and not on the main loop.
+ */
+
+#ifndef __MEMO_STUB_VCONF_H__
+#define __MEMO_STUB_VCONF_H__
+
+#define VCONFKEY_MEMO_DATA_CHANGE "db/memo/data-change"
+
+typedef struct _keynode_t keynode_t;
+typedef void (*vconf_callback_fn) (keynode_t *node, void *user_data);
+
+int vconf_get_int(const char *in_key, int *intval);
+int vconf_set_int(const char *in_key, const int intval);
+char *vconf_get_str(const char *in_key);
+int vconf_set_str(const char *in_key, const char *strval);
+int vconf_notify_key_changed(const char *in_key, vconf_callback_fn cb, void *user_data);
+int vconf_ignore_key_changed(const char *in_key, vconf_callback_fn cb);
+
+char *vconf_keynode_get_name(keynode_t *keynode);
+int vconf_keynode_get_int(const keynode_t *keynode);
+char *vconf_keynode_get_str(const keynode_t *keynode);
+
+#endif /* __MEMO_STUB_VCONF_H__ */
@@ -0,0 +1,30 @@
+/*
+*
+* Copyright 2012  Samsung Electronics Co., Ltd
+*
+* Licensed under the Flora License, Version 1.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.tizenopensource.org/license
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+
+#include "db-util.h"
+
+/* no collation hooks are registered off-device, sqlite defaults are used */
+int db_util_open(const char *pszFilePath, sqlite3 **ppDB, int nOption)
+{
+    return sqlite3_open(pszFilePath, ppDB);
+}
+
+int db_util_close(sqlite3 *pDB)
+{
+    return sqlite3_close(pDB);
+}
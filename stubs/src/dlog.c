@@ -0,0 +1,112 @@
+/*
+*
+* Copyright 2012  Samsung Electronics Co., Ltd
+*
+* Licensed under the Flora License, Version 1.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.tizenopensource.org/license
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "dlog.h"
+
+#define RING_ENTRY_LEN 256
+
+static pthread_once_t log_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t log_lock = PTHREAD_MUTEX_INITIALIZER;
+static int min_prio;
+static char (*ring)[RING_ENTRY_LEN] = NULL;
+static int ring_size = 0;
+static int ring_next = 0;
+static int ring_used = 0;
+
+static void _log_init(void)
+{
+    const char *env;
+
+    env = getenv("MEMO_STUB_LOG");
+    min_prio = env ? atoi(env) : DLOG_ERROR + 1;
+
+    env = getenv("MEMO_STUB_LOG_RING");
+    if (env && atoi(env) > 0) {
+        ring = calloc(atoi(env), RING_ENTRY_LEN);
+        if (ring) {
+            ring_size = atoi(env);
+        }
+    }
+}
+
+static char _prio_char(log_priority prio)
+{
+    switch (prio) {
+    case DLOG_DEBUG:
+        return 'D';
+    case DLOG_INFO:
+        return 'I';
+    case DLOG_WARN:
+        return 'W';
+    default:
+        return 'E';
+    }
+}
+
+int stub_dlog_print(log_priority prio, const char *tag, const char *fmt, ...)
+{
+    char line[RING_ENTRY_LEN];
+    va_list args;
+    int n;
+
+    pthread_once(&log_once, _log_init);
+    if ((int)prio < min_prio && ring_size == 0) {
+        return 0;
+    }
+
+    n = snprintf(line, sizeof(line), "%c/%s: ", _prio_char(prio), tag ? tag : "");
+    va_start(args, fmt);
+    vsnprintf(line + n, sizeof(line) - n, fmt, args);
+    va_end(args);
+
+    if ((int)prio >= min_prio) {
+        fprintf(stderr, "%s\n", line);
+    }
+    if (ring_size > 0) {
+        pthread_mutex_lock(&log_lock);
+        memcpy(ring[ring_next], line, sizeof(line));
+        ring_next = (ring_next + 1) % ring_size;
+        if (ring_used < ring_size) {
+            ring_used++;
+        }
+        pthread_mutex_unlock(&log_lock);
+    }
+    return 0;
+}
+
+void stub_dlog_dump(int fd)
+{
+    int i, idx;
+    ssize_t rc;
+
+    pthread_once(&log_once, _log_init);
+    pthread_mutex_lock(&log_lock);
+    for (i = 0; i < ring_used; i++) {
+        idx = (ring_next - ring_used + i + ring_size) % ring_size;
+        rc = write(fd, ring[idx], strlen(ring[idx]));
+        rc = write(fd, "\n", 1);
+    }
+    (void)rc;
+    pthread_mutex_unlock(&log_lock);
+}
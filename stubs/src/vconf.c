@@ -0,0 +1,370 @@
+/*
+*
+* Copyright 2012  Samsung Electronics Co., Ltd
+*
+* Licensed under the Flora License, Version 1.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.tizenopensource.org/license
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+#include "vconf.h"
+
+#define VCONF_DEFAULT_DIR "/tmp/memo-vconf"
+#define VCONF_VALUE_MAX 4096
+
+struct _keynode_t {
+    char *keyname;
+    char value[VCONF_VALUE_MAX];
+};
+
+struct subscription {
+    char *key;
+    char file[NAME_MAX + 1];
+    vconf_callback_fn cb;
+    void *user_data;
+    struct subscription *next;
+};
+
+static pthread_mutex_t sub_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct subscription *subs = NULL;
+static pthread_t watch_thread;
+static int watch_running = 0;
+static int watch_fd = -1;
+static int stop_pipe[2] = {-1, -1};
+
+static const char *_dir(void)
+{
+    const char *dir = getenv("MEMO_STUB_VCONF_DIR");
+    return dir ? dir : VCONF_DEFAULT_DIR;
+}
+
+static void _file_name(const char *key, char *buf, size_t len)
+{
+    char *p;
+
+    snprintf(buf, len, "%s", key);
+    for (p = buf; *p; p++) {
+        if (*p == '/') {
+            *p = '.';
+        }
+    }
+}
+
+static void _key_path(const char *key, char *buf, size_t len)
+{
+    char name[NAME_MAX + 1];
+
+    _file_name(key, name, sizeof(name));
+    snprintf(buf, len, "%s/%s", _dir(), name);
+}
+
+static int _read_value(const char *key, char *buf, size_t len)
+{
+    char path[PATH_MAX];
+    ssize_t n;
+    int fd;
+
+    _key_path(key, path, sizeof(path));
+    fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    n = read(fd, buf, len - 1);
+    close(fd);
+    if (n < 0) {
+        return -1;
+    }
+    buf[n] = '\0';
+    return 0;
+}
+
+/* write "<path>.<pid>" and rename it, so readers never see a partial value */
+static int _write_value(const char *key, const char *value)
+{
+    char path[PATH_MAX], tmp[PATH_MAX + 16];
+    size_t len = strlen(value);
+    int fd, rc = 0;
+
+    mkdir(_dir(), 0775);
+    _key_path(key, path, sizeof(path));
+    snprintf(tmp, sizeof(tmp), "%s.%d", path, getpid());
+    fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0664);
+    if (fd < 0) {
+        return -1;
+    }
+    if (write(fd, value, len) != (ssize_t)len) {
+        rc = -1;
+    }
+    close(fd);
+    if (rc == 0 && rename(tmp, path) == -1) {
+        rc = -1;
+    }
+    if (rc == -1) {
+        unlink(tmp);
+    }
+    return rc;
+}
+
+int vconf_get_int(const char *in_key, int *intval)
+{
+    char buf[32];
+
+    if (in_key == NULL || intval == NULL) {
+        return -1;
+    }
+    if (_read_value(in_key, buf, sizeof(buf)) == -1) {
+        /* an unset key reads as 0, like a freshly installed vconf */
+        *intval = 0;
+        return 0;
+    }
+    *intval = atoi(buf);
+    return 0;
+}
+
+int vconf_set_int(const char *in_key, const int intval)
+{
+    char buf[32];
+
+    if (in_key == NULL) {
+        return -1;
+    }
+    snprintf(buf, sizeof(buf), "%d", intval);
+    return _write_value(in_key, buf);
+}
+
+char *vconf_get_str(const char *in_key)
+{
+    char buf[VCONF_VALUE_MAX];
+
+    if (in_key == NULL || _read_value(in_key, buf, sizeof(buf)) == -1) {
+        return NULL;
+    }
+    return strdup(buf);
+}
+
+int vconf_set_str(const char *in_key, const char *strval)
+{
+    if (in_key == NULL || strval == NULL) {
+        return -1;
+    }
+    return _write_value(in_key, strval);
+}
+
+static void _dispatch(const char *file)
+{
+    struct subscription *s;
+    keynode_t node;
+    vconf_callback_fn cb;
+    void *user_data;
+    int i, n = 0;
+    struct {
+        vconf_callback_fn cb;
+        void *user_data;
+        char *key;
+    } calls[16];
+
+    /* collect under the lock, call without it: a callback may unsubscribe */
+    pthread_mutex_lock(&sub_lock);
+    for (s = subs; s && n < 16; s = s->next) {
+        if (strcmp(s->file, file) == 0) {
+            calls[n].cb = s->cb;
+            calls[n].user_data = s->user_data;
+            calls[n].key = strdup(s->key);
+            n++;
+        }
+    }
+    pthread_mutex_unlock(&sub_lock);
+
+    for (i = 0; i < n; i++) {
+        cb = calls[i].cb;
+        user_data = calls[i].user_data;
+        node.keyname = calls[i].key;
+        if (node.keyname == NULL || _read_value(node.keyname, node.value, sizeof(node.value)) == -1) {
+            node.value[0] = '\0';
+        }
+        cb(&node, user_data);
+        free(calls[i].key);
+    }
+}
+
+static void *_watch(void *arg)
+{
+    char buf[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+    const struct inotify_event *ev;
+    struct pollfd fds[2];
+    ssize_t len;
+    char *p;
+
+    fds[0].fd = watch_fd;
+    fds[0].events = POLLIN;
+    fds[1].fd = stop_pipe[0];
+    fds[1].events = POLLIN;
+
+    while (1) {
+        if (poll(fds, 2, -1) < 0) {
+            continue;
+        }
+        if (fds[1].revents) {
+            break;
+        }
+        len = read(fds[0].fd, buf, sizeof(buf));
+        if (len <= 0) {
+            continue;
+        }
+        for (p = buf; p < buf + len; p += sizeof(struct inotify_event) + ev->len) {
+            ev = (const struct inotify_event *)p;
+            if (ev->len > 0) {
+                _dispatch(ev->name);
+            }
+        }
+    }
+    return NULL;
+}
+
+/* called with sub_lock held */
+static int _watch_start(void)
+{
+    if (watch_running) {
+        return 0;
+    }
+
+    mkdir(_dir(), 0775);
+    watch_fd = inotify_init1(IN_CLOEXEC);
+    if (watch_fd < 0) {
+        return -1;
+    }
+    if (inotify_add_watch(watch_fd, _dir(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0
+            || pipe(stop_pipe) == -1) {
+        close(watch_fd);
+        watch_fd = -1;
+        return -1;
+    }
+    if (pthread_create(&watch_thread, NULL, _watch, NULL) != 0) {
+        close(watch_fd);
+        close(stop_pipe[0]);
+        close(stop_pipe[1]);
+        watch_fd = -1;
+        return -1;
+    }
+    watch_running = 1;
+    return 0;
+}
+
+/* called with sub_lock held */
+static void _watch_stop(void)
+{
+    pthread_t thread = watch_thread;
+    int fd = watch_fd, rfd = stop_pipe[0], wfd = stop_pipe[1];
+    ssize_t rc;
+
+    if (!watch_running) {
+        return;
+    }
+    watch_running = 0;
+    watch_fd = -1;
+
+    rc = write(wfd, "q", 1);
+    (void)rc;
+    if (pthread_equal(pthread_self(), thread)) {
+        /* unsubscribed from inside a callback, the thread ends on its own */
+        pthread_detach(thread);
+        return;
+    }
+    pthread_mutex_unlock(&sub_lock);
+    pthread_join(thread, NULL);
+    pthread_mutex_lock(&sub_lock);
+    close(rfd);
+    close(wfd);
+    close(fd);
+}
+
+int vconf_notify_key_changed(const char *in_key, vconf_callback_fn cb, void *user_data)
+{
+    struct subscription *s;
+
+    if (in_key == NULL || cb == NULL) {
+        return -1;
+    }
+    s = (struct subscription *)calloc(1, sizeof(struct subscription));
+    if (s == NULL) {
+        return -1;
+    }
+    s->key = strdup(in_key);
+    _file_name(in_key, s->file, sizeof(s->file));
+    s->cb = cb;
+    s->user_data = user_data;
+
+    pthread_mutex_lock(&sub_lock);
+    if (_watch_start() == -1) {
+        pthread_mutex_unlock(&sub_lock);
+        free(s->key);
+        free(s);
+        return -1;
+    }
+    s->next = subs;
+    subs = s;
+    pthread_mutex_unlock(&sub_lock);
+    return 0;
+}
+
+int vconf_ignore_key_changed(const char *in_key, vconf_callback_fn cb)
+{
+    struct subscription **pp, *s;
+    int found = 0;
+
+    if (in_key == NULL || cb == NULL) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&sub_lock);
+    for (pp = &subs; *pp; ) {
+        s = *pp;
+        if (s->cb == cb && strcmp(s->key, in_key) == 0) {
+            *pp = s->next;
+            free(s->key);
+            free(s);
+            found = 1;
+        } else {
+            pp = &s->next;
+        }
+    }
+    if (subs == NULL) {
+        _watch_stop();
+    }
+    pthread_mutex_unlock(&sub_lock);
+    return found ? 0 : -1;
+}
+
+char *vconf_keynode_get_name(keynode_t *keynode)
+{
+    return keynode ? keynode->keyname : NULL;
+}
+
+int vconf_keynode_get_int(const keynode_t *keynode)
+{
+    return keynode ? atoi(keynode->value) : 0;
+}
+
+char *vconf_keynode_get_str(const keynode_t *keynode)
+{
+    return keynode ? (char *)keynode->value : NULL;
+}
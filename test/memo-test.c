@@ -0,0 +1,948 @@
+/*
+*
+* Copyright 2012  Samsung Electronics Co., Ltd
+*
+* Licensed under the Flora License, Version 1.0 (the "License");
+* you may not use this file except in compliance with the License.
+* You may obtain a copy of the License at
+*
+*    http://www.tizenopensource.org/license
+*
+* Unless required by applicable law or agreed to in writing, software
+* distributed under the License is distributed on an "AS IS" BASIS,
+* WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+* See the License for the specific language governing permissions and
+* limitations under the License.
+*
+*/
+
+/*
+ * memo-test : regression tests of the public API
+ *
+ * usage: memo-test CASE DIR
+ * CASE runs on DIR/memo.db, created anew.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <utime.h>
+#include <sys/stat.h>
+#include <sqlite3.h>
+#include <png.h>
+
+#include "memo-db.h"
+
+#define CHECK(cond) do { \
+    if (!(cond)) { \
+        fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+        return -1; \
+    } \
+} while (0)
+
+static char db_path[512];
+
+static int _add(const char *content, unsigned int color)
+{
+    struct memo_data *md = memo_create_data();
+    int id;
+
+    md->content = strdup(content);
+    md->color = color;
+    id = memo_add_data(md);
+    memo_free_data(md);
+    return id;
+}
+
+static int _count_color(unsigned int color)
+{
+    struct memo_filter filter;
+    int count = -1;
+
+    memset(&filter, 0, sizeof(filter));
+    filter.flags = MEMO_FILTER_COLOR;
+    filter.color = color;
+    if (memo_get_count_filtered(&filter, &count) != 0) {
+        return -1;
+    }
+    return count;
+}
+
+/* the color filter finds what insert and update stored, 0 and high bit colors included */
+static int t_color(void)
+{
+    struct memo_data *md;
+    struct memo_stats st;
+    int id, id0, idh;
+
+    id = _add("red", 3);
+    id0 = _add("none", 0);
+    idh = _add("argb", 0xff00ff00);
+    CHECK(id > 0 && id0 > 0 && idh > 0);
+    CHECK(_count_color(3) == 1);
+    CHECK(_count_color(0) == 1);
+    CHECK(_count_color(0xff00ff00) == 1);
+
+    md = memo_get_data(id);
+    CHECK(md != NULL && md->color == 3);
+    md->color = 5;
+    CHECK(memo_mod_data(md) == 0);
+    memo_free_data(md);
+    md = memo_get_data(id);
+    CHECK(md != NULL && md->color == 5);
+    memo_free_data(md);
+    CHECK(_count_color(3) == 0);
+    CHECK(_count_color(5) == 1);
+
+    md = memo_get_data(idh);
+    CHECK(md != NULL && md->color == 0xff00ff00);
+    md->color = 0;
+    CHECK(memo_mod_data(md) == 0);
+    memo_free_data(md);
+    CHECK(_count_color(0xff00ff00) == 0);
+    CHECK(_count_color(0) == 2);
+
+    /* filtered counts are measured as counts */
+    CHECK(memo_stats_enable(true) == 0);
+    memo_reset_stats();
+    CHECK(_count_color(5) == 1);
+    CHECK(memo_get_stats(&st) == 0);
+    CHECK(st.op[MEMO_STAT_COUNT].calls == 1 && st.op[MEMO_STAT_GET].calls == 0);
+    memo_stats_enable(false);
+    return 0;
+}
+
+/* other writes go on while a write stream is open, the stream replaces the whole body */
+static int t_content_stream(void)
+{
+    memo_content_stream_t *s;
+    struct memo_data *md;
+    char buf[1000];
+    char *body;
+    int id, other, i, n, len = 0;
+
+    id = _add("short", 0);
+    CHECK(id > 0);
+    s = memo_content_open(id, MEMO_CONTENT_WRITE);
+    CHECK(s != NULL);
+    memset(buf, 'a', sizeof(buf));
+    for (i = 0; i < 100; i++) {
+        buf[0] = '0' + i % 10;
+        CHECK(memo_content_write(s, buf, sizeof(buf)) == 0);
+        if (i == 50) {
+            other = _add("written meanwhile", 1);
+            CHECK(other > 0);
+            CHECK(memo_del_data(other) == 0);
+        }
+    }
+    CHECK(memo_content_close(s) == 0);
+
+    md = memo_get_data(id);
+    CHECK(md != NULL && md->content != NULL && strlen(md->content) == 100 * sizeof(buf));
+    for (i = 0; i < 100; i++) {
+        CHECK(md->content[i * sizeof(buf)] == '0' + i % 10);
+    }
+    memo_free_data(md);
+
+    body = malloc(100 * sizeof(buf) + 1);
+    CHECK(body != NULL);
+    s = memo_content_open(id, MEMO_CONTENT_READ);
+    CHECK(s != NULL);
+    while ((n = memo_content_read(s, body + len, 4096)) > 0) {
+        len += n;
+    }
+    memo_content_close(s);
+    free(body);
+    CHECK(len == 100 * sizeof(buf));
+
+    /* deleted before the close */
+    s = memo_content_open(id, MEMO_CONTENT_WRITE);
+    CHECK(s != NULL);
+    CHECK(memo_content_write(s, buf, sizeof(buf)) == 0);
+    CHECK(memo_del_data(id) == 0);
+    CHECK(memo_content_close(s) == -1);
+    return 0;
+}
+
+/* first column of the first row of sql on an own connection, -1 on error */
+static long long _query_int(const char *sql)
+{
+    sqlite3 *db = NULL;
+    sqlite3_stmt *stmt = NULL;
+    long long value = -1;
+
+    if (sqlite3_open(db_path, &db) == SQLITE_OK && sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) == SQLITE_OK
+            && sqlite3_step(stmt) == SQLITE_ROW) {
+        value = sqlite3_column_int64(stmt, 0);
+    }
+    sqlite3_finalize(stmt);
+    sqlite3_close(db);
+    return value;
+}
+
+/* updating a missing memo fails and leaves no chunks behind */
+static int t_update_missing(void)
+{
+    struct memo_data *md;
+
+    md = memo_create_data();
+    md->id = 4242;
+    md->content = malloc(20000);
+    CHECK(md->content != NULL);
+    memset(md->content, 'x', 19999);
+    md->content[19999] = '\0';
+    CHECK(memo_mod_data(md) == -1);
+    memo_free_data(md);
+
+    CHECK(_query_int("select count(*) from memo_chunk") == 0);
+    return 0;
+}
+
+/* a stale stamp is refused without writing, a missing or deleted memo fails */
+static int t_update_if_unchanged(void)
+{
+    struct memo_data *md;
+    int64_t stamp, newer;
+    int id = _add("base", 0);
+
+    CHECK(id > 0);
+    stamp = memo_get_modified_utime(id);
+    CHECK(stamp > 0);
+
+    md = memo_get_data(id);
+    CHECK(md != NULL);
+    free(md->content);
+    md->content = strdup("first writer");
+    CHECK(memo_mod_data_if_unchanged(md, stamp) == 0);
+    newer = memo_get_modified_utime(id);
+    CHECK(newer > stamp);
+
+    /* a second writer still holding the old stamp */
+    free(md->content);
+    md->content = strdup("second writer");
+    CHECK(memo_mod_data_if_unchanged(md, stamp) == MEMO_ERROR_CONFLICT);
+    CHECK(memo_get_modified_utime(id) == newer);
+    memo_free_data(md);
+    md = memo_get_data(id);
+    CHECK(md != NULL && strcmp(md->content, "first writer") == 0);
+
+    md->id = id + 100;
+    CHECK(memo_mod_data_if_unchanged(md, newer) == -1);
+    md->id = id;
+    CHECK(memo_del_data(id) == 0);
+    CHECK(memo_mod_data_if_unchanged(md, newer) == -1);
+    memo_free_data(md);
+    return 0;
+}
+
+/* a delete only changes a live memo */
+static int t_delete_twice(void)
+{
+    int ids[3];
+    int64_t stamp, newer;
+    bool exists = true, deleted = false;
+
+    ids[0] = _add("gone", 0);
+    ids[1] = _add("kept", 0);
+    ids[2] = ids[1] + 100;
+    CHECK(ids[0] > 0 && ids[1] > 0);
+
+    CHECK(memo_del_data(ids[0]) == 0);
+    CHECK(memo_probe(ids[0], NULL, &stamp, NULL) == 0 && stamp > 0);
+    CHECK(memo_del_data(ids[0]) == -1);
+    CHECK(memo_del_data(ids[2]) == -1);
+    CHECK(memo_probe(ids[0], &exists, &newer, &deleted) == 0 && !exists && deleted);
+    CHECK(newer == stamp);
+
+    CHECK(memo_del_data_many(ids, 3) == 1);
+    CHECK(memo_del_data_many(ids, 3) == 0);
+    return 0;
+}
+
+/* id of the first memo in sort order */
+static int _first_id(MEMO_SORT_TYPE sort)
+{
+    int ids[1];
+
+    return memo_get_indexes_filtered(ids, 1, sort, NULL) == 1 ? ids[0] : -1;
+}
+
+/* sort_key is kept by the library, a connection without its functions can write memos */
+static int t_sort_key(void)
+{
+    struct memo_data *md;
+    sqlite3 *db = NULL;
+    int b, a, c;
+
+    b = _add("banana", 0);
+    a = _add("apple", 0);
+    c = _add("cherry", 0);
+    CHECK(a > 0 && b > 0 && c > 0);
+    CHECK(_first_id(MEMO_SORT_TITLE_ASC) == a);
+
+    md = memo_get_data(a);
+    CHECK(md != NULL);
+    free(md->content);
+    md->content = strdup("zucchini");
+    CHECK(memo_mod_data(md) == 0);
+    memo_free_data(md);
+    CHECK(_first_id(MEMO_SORT_TITLE_ASC) == b);
+    CHECK(_first_id(MEMO_SORT_TITLE) == a);
+
+    CHECK(sqlite3_open(db_path, &db) == SQLITE_OK);
+    CHECK(sqlite3_exec(db, "insert into memo (content, delete_time, create_utime, modi_utime) "
+                "values ('aardvark', -1, 1, 1)", NULL, NULL, NULL) == SQLITE_OK);
+    CHECK(sqlite3_exec(db, "update memo set content = 'apricot' where content = 'cherry'",
+                NULL, NULL, NULL) == SQLITE_OK);
+    sqlite3_close(db);
+
+    /* memo_init fills the keys of memos added meanwhile */
+    memo_fini();
+    CHECK(memo_init(db_path) == 0);
+    CHECK(_first_id(MEMO_SORT_TITLE_ASC) == c + 1);
+    return 0;
+}
+
+/* keys are made with the collator recorded in the db, not the one of the process */
+static int t_collation_stored(void)
+{
+    sqlite3 *db = NULL;
+    int ol, zebra, ost;
+
+    ol = _add("\xc3\xb6l", 0); /* "öl", after z in Swedish */
+    zebra = _add("zebra", 0);
+    ost = _add("ost", 0);
+    CHECK(ol > 0 && zebra > 0 && ost > 0);
+    CHECK(_first_id(MEMO_SORT_TITLE_ASC) == ol);
+
+    /* as if another process had set Swedish, keys of memos added meanwhile are missing */
+    memo_fini();
+    CHECK(sqlite3_open(db_path, &db) == SQLITE_OK);
+    CHECK(sqlite3_exec(db, "update memo_meta set value = 'sv' || substr(value, instr(value, '@')) "
+                "where key = 'collation'; update memo set sort_key = null", NULL, NULL, NULL) == SQLITE_OK);
+    sqlite3_close(db);
+    CHECK(memo_init(db_path) == 0);
+    CHECK(_first_id(MEMO_SORT_TITLE_ASC) == ost);
+    CHECK(_first_id(MEMO_SORT_TITLE) == ol);
+
+    CHECK(memo_set_collation_locale(NULL) == 0);
+    CHECK(_first_id(MEMO_SORT_TITLE_ASC) == ol);
+    memo_fini();
+    CHECK(memo_init(db_path) == 0);
+    CHECK(_first_id(MEMO_SORT_TITLE_ASC) == ol);
+    return 0;
+}
+
+#define CONTAINS_MAX_ID 256
+
+static void _mark(memo_data_t *md, void *user_data)
+{
+    if (md->id < CONTAINS_MAX_ID) {
+        ((char *)user_data)[md->id] = 1;
+    }
+}
+
+/* ids of the memos whose content is LIKE '%needle%' */
+static int _like_ids(const char *needle, char *hits)
+{
+    sqlite3 *db = NULL;
+    sqlite3_stmt *stmt = NULL;
+    int rc = -1;
+
+    memset(hits, 0, CONTAINS_MAX_ID);
+    if (sqlite3_open(db_path, &db) == SQLITE_OK && sqlite3_prepare_v2(db, "select id from memo "
+                "where delete_time = -1 and content like '%' || ?1 || '%'", -1, &stmt, NULL) == SQLITE_OK) {
+        sqlite3_bind_text(stmt, 1, needle, -1, SQLITE_STATIC);
+        while ((rc = sqlite3_step(stmt)) == SQLITE_ROW) {
+            hits[sqlite3_column_int(stmt, 0) % CONTAINS_MAX_ID] = 1;
+        }
+        rc = rc == SQLITE_DONE ? 0 : -1;
+    }
+    sqlite3_finalize(stmt);
+    sqlite3_close(db);
+    return rc;
+}
+
+/* search (memo_contains) gives what LIKE gives, plus Unicode case folding for the needles with such letters */
+static int t_contains_like(void)
+{
+    static const char *texts[] = {
+        "Hello World", "hello world", "HELLO", "abc", "50% off", "a_b", "100 percent",
+        "\xc3\x89lan vital", "\xc3\xa9lan", "\xc3\x89LAN", "Stra\xc3\x9f" "e", "STRASSE",
+        "na\xc3\xafve", "\xed\x95\x9c\xea\xb8\x80 memo", "\xd0\x96\xd1\x83\xd0\xba",
+    };
+    static const struct {
+        const char *needle;
+        int folds; /* cased letters outside ASCII */
+        const char *also; /* a text LIKE misses which it has to find */
+    } cases[] = {
+        { "hello", 0, NULL }, { "HELLO", 0, NULL }, { "lo wo", 0, NULL }, { "quick", 0, NULL },
+        { "QuIcK", 0, NULL }, { "quicl", 0, NULL }, { "zquickz", 0, NULL }, { "", 0, NULL },
+        { "%", 0, NULL }, { "_", 0, NULL }, { "50%", 0, NULL }, { "a_b", 0, NULL }, { "0 p", 0, NULL },
+        { "zzzzzzzzzzzzzzzzquick", 0, NULL }, { "zzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzzquick", 0, NULL },
+        { "\xed\x95\x9c\xea\xb8\x80", 0, NULL }, { "\xc3\xafve", 1, NULL },
+        { "\xc3\xa9", 1, "\xc3\x89LAN" }, { "\xc3\x89lan", 1, "\xc3\xa9lan" },
+        { "e\xcc\x81lan", 1, "\xc3\xa9lan" }, { "stra\xc3\x9f" "e", 1, "STRASSE" },
+        { "\xd0\xb6\xd1\x83", 1, "\xd0\x96\xd1\x83\xd0\xba" },
+    };
+    static const int lens[] = { 5, 15, 16, 17, 31, 32, 33, 47, 48, 49 };
+    char like[CONTAINS_MAX_ID], found[CONTAINS_MAX_ID];
+    char text[64];
+    unsigned int i, j, k;
+    int id, also;
+
+    for (i = 0; i < sizeof(texts) / sizeof(texts[0]); i++) {
+        CHECK(_add(texts[i], 0) > 0);
+    }
+    /* "QuIcK" at the start, the middle and the end of texts around the vector width */
+    for (i = 0; i < sizeof(lens) / sizeof(lens[0]); i++) {
+        for (k = 0; k < 3; k++) {
+            int at = k == 0 ? 0 : (k == 1 ? lens[i] / 2 - 2 : lens[i] - 5);
+            memset(text, 'z', lens[i]);
+            text[lens[i]] = '\0';
+            memcpy(text + (at < 0 ? 0 : at), "QuIcK", 5);
+            CHECK(_add(text, 0) > 0);
+        }
+    }
+
+    for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        CHECK(_like_ids(cases[i].needle, like) == 0);
+        memset(found, 0, sizeof(found));
+        CHECK(memo_search_data(cases[i].needle, CONTAINS_MAX_ID, 0, MEMO_SORT_CREATE_TIME, _mark, found) == 0);
+        also = 0;
+        for (j = 1; j < CONTAINS_MAX_ID; j++) {
+            if (found[j] == like[j]) {
+                continue;
+            }
+            if (!cases[i].folds || like[j]) {
+                fprintf(stderr, "needle %u, memo %u : like %d contains %d\n", i, j, like[j], found[j]);
+                CHECK(0);
+            }
+            also = 1;
+        }
+        if (cases[i].also != NULL) {
+            struct memo_data *md;
+            CHECK(also);
+            for (id = 1; id < CONTAINS_MAX_ID; id++) {
+                if (!found[id] || like[id] || (md = memo_get_data(id)) == NULL) {
+                    continue;
+                }
+                also = strcmp(md->content, cases[i].also) == 0 ? -1 : also;
+                memo_free_data(md);
+            }
+            CHECK(also == -1);
+        }
+    }
+    return 0;
+}
+
+#define TIE_MEMOS 40
+
+struct id_list {
+    int ids[TIE_MEMOS * 2];
+    int n;
+};
+
+static void _collect(memo_data_t *md, void *user_data)
+{
+    struct id_list *l = (struct id_list *)user_data;
+
+    if (l->n < TIE_MEMOS * 2) {
+        l->ids[l->n++] = md->id;
+    }
+}
+
+/* memos of equal title come in one order from every list, search and page */
+static int t_title_ties(void)
+{
+    memo_search_session_t *session;
+    struct id_list all, paged, search, sess;
+    int i, sort;
+
+    for (i = 0; i < TIE_MEMOS; i++) {
+        CHECK(_add(i % 4 ? "same title" : "other title", 0) > 0);
+    }
+    for (sort = MEMO_SORT_TITLE; sort <= MEMO_SORT_TITLE_ASC; sort++) {
+        memset(&all, 0, sizeof(all));
+        memset(&paged, 0, sizeof(paged));
+        memset(&search, 0, sizeof(search));
+        memset(&sess, 0, sizeof(sess));
+        CHECK(memo_all_data_filtered(-1, 0, sort, NULL, _collect, &all) >= 0 && all.n == TIE_MEMOS);
+        for (i = 0; i < TIE_MEMOS; i += 7) {
+            CHECK(memo_all_data_filtered(7, i, sort, NULL, _collect, &paged) >= 0);
+        }
+        CHECK(paged.n == TIE_MEMOS && memcmp(all.ids, paged.ids, sizeof(all.ids)) == 0);
+
+        CHECK(memo_search_data("title", -1, 0, sort, _collect, &search) >= 0);
+        CHECK(memo_search_data_parallel("title", -1, 0, sort, 2, _collect, &sess) >= 0);
+        CHECK(search.n == TIE_MEMOS && memcmp(all.ids, search.ids, sizeof(all.ids)) == 0);
+        CHECK(sess.n == TIE_MEMOS && memcmp(all.ids, sess.ids, sizeof(all.ids)) == 0);
+
+        memset(&sess, 0, sizeof(sess));
+        session = memo_search_session_open();
+        CHECK(session != NULL);
+        CHECK(memo_search_session_data(session, "title", -1, 0, sort, _collect, &sess) >= 0);
+        memo_search_session_close(session);
+        CHECK(sess.n == TIE_MEMOS && memcmp(all.ids, sess.ids, sizeof(all.ids)) == 0);
+    }
+    return 0;
+}
+
+/* doodles of an archive land in the doodle dir under their own name, no temp file is left */
+static int t_import_doodle(void)
+{
+    struct memo_data *md;
+    struct stat st;
+    struct dirent *e;
+    DIR *d;
+    char dir[600], path[700], archive[600], buf[16];
+    int id, fd, n, temps = 0;
+
+    snprintf(path, sizeof(path), "%s.doodle.png", db_path);
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    CHECK(fd >= 0 && write(fd, "not a png", 9) == 9);
+    close(fd);
+    md = memo_create_data();
+    md->has_doodle = 1;
+    md->doodle_path = strdup(path);
+    id = memo_add_data(md);
+    memo_free_data(md);
+    CHECK(id > 0);
+
+    snprintf(archive, sizeof(archive), "%s.archive", db_path);
+    fd = open(archive, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    CHECK(fd >= 0);
+    CHECK(memo_export(fd, MEMO_EXPORT_BINARY | MEMO_EXPORT_DOODLES) == 0);
+    memo_fini();
+    unlink(path);
+    unlink(db_path);
+
+    snprintf(dir, sizeof(dir), "%s.doodles", db_path);
+    mkdir(dir, 0755);
+    CHECK(memo_init(db_path) == 0);
+    CHECK(memo_import_set_doodle_dir(dir) == 0);
+    CHECK(lseek(fd, 0, SEEK_SET) == 0);
+    CHECK(memo_import(fd, MEMO_IMPORT_REPLACE, NULL, NULL) == 1);
+    close(fd);
+    unlink(archive);
+
+    md = memo_get_data(id);
+    CHECK(md != NULL && md->doodle_path != NULL);
+    snprintf(path, sizeof(path), "%s/memo.db.doodle.png", dir);
+    CHECK(strcmp(md->doodle_path, path) == 0);
+    memo_free_data(md);
+    CHECK(stat(path, &st) == 0 && (st.st_mode & 0777) == 0644);
+    fd = open(path, O_RDONLY);
+    n = fd >= 0 ? read(fd, buf, sizeof(buf)) : -1;
+    close(fd);
+    CHECK(n == 9 && memcmp(buf, "not a png", 9) == 0);
+    unlink(path);
+
+    d = opendir(dir);
+    CHECK(d != NULL);
+    while ((e = readdir(d)) != NULL) {
+        temps += strncmp(e->d_name, ".import.", 8) == 0;
+    }
+    closedir(d);
+    CHECK(temps == 0);
+    return 0;
+}
+
+/* import packs content only with compression enabled, like memo_add_data */
+static int t_import_compression(void)
+{
+    char archive[600];
+    int fd, i, threshold;
+
+    for (i = 0; i < 60; i++) {
+        char content[80];
+        snprintf(content, sizeof(content), "meeting tomorrow morning %d, shopping list: milk bread eggs", i);
+        CHECK(_add(content, 0) > 0);
+    }
+    snprintf(archive, sizeof(archive), "%s.archive", db_path);
+    fd = open(archive, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    CHECK(fd >= 0 && memo_export(fd, MEMO_EXPORT_JSON_LINES) == 0);
+    unlink(archive);
+
+    for (threshold = 0; threshold <= 32; threshold += 32) {
+        memo_fini();
+        unlink(db_path);
+        CHECK(memo_set_compression(threshold) == 0);
+        CHECK(memo_init(db_path) == 0);
+        CHECK(lseek(fd, 0, SEEK_SET) == 0);
+        CHECK(memo_import(fd, MEMO_IMPORT_REPLACE, NULL, NULL) == 60);
+        CHECK(_query_int("select count(*) from memo where typeof(content) = 'blob'") == (threshold ? 60 : 0));
+    }
+    memo_set_compression(0);
+    close(fd);
+    return 0;
+}
+
+/* a line over the record limit fails the import instead of ending it */
+static int t_import_long_line(void)
+{
+    char archive[600];
+    const char *head = "{\"id\": 7, \"content\": \"";
+    int fd;
+
+    CHECK(_add("kept", 0) > 0);
+    snprintf(archive, sizeof(archive), "%s.archive", db_path);
+    fd = open(archive, O_RDWR | O_CREAT | O_TRUNC, 0600);
+    CHECK(fd >= 0 && memo_export(fd, MEMO_EXPORT_JSON_LINES) == 0);
+    unlink(archive);
+    CHECK(memo_del_data(1) == 0);
+
+    /* sparse, the line runs to the end of the file */
+    CHECK(write(fd, head, strlen(head)) == (ssize_t)strlen(head));
+    CHECK(ftruncate(fd, lseek(fd, 0, SEEK_CUR) + 65 * 1024 * 1024) == 0);
+    CHECK(lseek(fd, 0, SEEK_SET) == 0);
+    CHECK(memo_import(fd, MEMO_IMPORT_REPLACE, NULL, NULL) == -1);
+    close(fd);
+    CHECK(_query_int("select count(*) from memo where delete_time = -1") == 0);
+    return 0;
+}
+
+/* a backup of a db locked by another connection gives up after the busy timeout */
+static int t_backup_locked(void)
+{
+    char dest[600];
+    sqlite3 *db = NULL;
+
+    CHECK(_add("copied", 0) > 0);
+    snprintf(dest, sizeof(dest), "%s.backup", db_path);
+    unlink(dest);
+    CHECK(memo_backup(dest) == 0 && access(dest, F_OK) == 0);
+    unlink(dest);
+
+    CHECK(memo_set_busy_timeout(100) == 0);
+    CHECK(sqlite3_open(db_path, &db) == SQLITE_OK);
+    CHECK(sqlite3_exec(db, "BEGIN EXCLUSIVE", NULL, NULL, NULL) == SQLITE_OK);
+    alarm(10); /* the copy used to retry forever */
+    CHECK(memo_backup(dest) == -1);
+    alarm(0);
+    sqlite3_exec(db, "ROLLBACK", NULL, NULL, NULL);
+    sqlite3_close(db);
+    CHECK(access(dest, F_OK) == -1);
+    memo_set_busy_timeout(3000);
+    return 0;
+}
+
+/* the snapshot seq comes from the db, commits are published by memo_fini at the latest */
+static int t_snapshot(void)
+{
+    char path[600];
+    memo_snapshot_t *snap;
+    unsigned long long seq;
+    int id;
+
+    snprintf(path, sizeof(path), "%s.snapshot", db_path);
+    unlink(path);
+    CHECK(memo_snapshot_enable(path) == 0);
+    snap = memo_snapshot_open(path);
+    CHECK(snap != NULL && memo_snapshot_count(snap) == 0 && memo_snapshot_seq(snap) == 0);
+
+    id = _add("first", 0);
+    CHECK(id > 0);
+    CHECK(_add("second", 0) > 0);
+    memo_fini();
+    CHECK(memo_snapshot_is_stale(snap) == 1);
+    memo_snapshot_close(snap);
+
+    snap = memo_snapshot_open(path);
+    CHECK(snap != NULL && memo_snapshot_count(snap) == 2);
+    seq = memo_snapshot_seq(snap);
+    CHECK(seq == (unsigned long long)_query_int("select max(modi_utime) from memo") && seq > 0);
+    memo_snapshot_close(snap);
+
+    /* rewritten from the same data, the seq does not move */
+    unlink(path);
+    CHECK(memo_init(db_path) == 0);
+    CHECK(memo_snapshot_enable(path) == 0);
+    snap = memo_snapshot_open(path);
+    CHECK(snap != NULL && memo_snapshot_seq(snap) == seq);
+    memo_snapshot_close(snap);
+
+    CHECK(memo_del_data(id) == 0);
+    memo_fini();
+    snap = memo_snapshot_open(path);
+    CHECK(snap != NULL && memo_snapshot_count(snap) == 1 && memo_snapshot_seq(snap) > seq);
+    memo_snapshot_close(snap);
+    unlink(path);
+    CHECK(memo_init(db_path) == 0);
+    return 0;
+}
+
+/* an old file in dir, a memo referring to it by doodle_path when ref is set */
+static int _doodle(const char *dir, const char *name, const char *ref)
+{
+    char path[700];
+    struct utimbuf old = { 1000, 1000 };
+    struct memo_data *md;
+    int fd, id = 0;
+
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd < 0 || utime(path, &old) == -1) {
+        return -1;
+    }
+    close(fd);
+    if (ref != NULL) {
+        md = memo_create_data();
+        md->content = strdup(name);
+        md->has_doodle = 1;
+        md->doodle_path = strdup(ref);
+        id = memo_add_data(md);
+        memo_free_data(md);
+    }
+    return id;
+}
+
+/* a doodle_path naming the file another way keeps it */
+static int t_doodle_orphans(void)
+{
+    char dir[600], sub[700], link[700], ref[800];
+
+    snprintf(dir, sizeof(dir), "%s.doodles", db_path);
+    snprintf(sub, sizeof(sub), "%s/sub", dir);
+    snprintf(link, sizeof(link), "%s.link", db_path);
+    mkdir(dir, 0700);
+    mkdir(sub, 0700);
+    unlink(link);
+
+    snprintf(ref, sizeof(ref), "%s//slash.png", dir);
+    CHECK(_doodle(dir, "slash.png", ref) > 0);
+    snprintf(ref, sizeof(ref), "%s/../dots.png", sub);
+    CHECK(_doodle(dir, "dots.png", ref) > 0);
+    snprintf(ref, sizeof(ref), "%s/link.png", dir);
+    CHECK(symlink(ref, link) == 0);
+    CHECK(_doodle(dir, "link.png", link) > 0);
+    CHECK(_doodle(dir, "orphan.png", NULL) == 0);
+
+    CHECK(memo_doodle_reap_orphans(dir) == 1);
+    memo_doodle_flush();
+    snprintf(ref, sizeof(ref), "%s/orphan.png", dir);
+    CHECK(access(ref, F_OK) == -1);
+    snprintf(ref, sizeof(ref), "%s/slash.png", dir);
+    CHECK(access(ref, F_OK) == 0);
+    snprintf(ref, sizeof(ref), "%s/dots.png", dir);
+    CHECK(access(ref, F_OK) == 0);
+    CHECK(access(link, F_OK) == 0);
+    return 0;
+}
+
+#define STATS_THREADS 4
+#define STATS_CALLS 500
+
+static void *_get_many(void *data)
+{
+    int i;
+
+    for (i = 0; i < STATS_CALLS; i++) {
+        memo_free_data(memo_get_data(*(int *)data));
+    }
+    return NULL;
+}
+
+/* no call is lost when threads are measured at once */
+static int t_stats_threads(void)
+{
+    pthread_t threads[STATS_THREADS];
+    struct memo_stats st;
+    int id = _add("counted", 0);
+    int i;
+
+    CHECK(id > 0);
+    CHECK(memo_stats_enable(true) == 0);
+    memo_reset_stats();
+    for (i = 0; i < STATS_THREADS; i++) {
+        CHECK(pthread_create(&threads[i], NULL, _get_many, &id) == 0);
+    }
+    for (i = 0; i < STATS_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    CHECK(memo_get_stats(&st) == 0);
+    CHECK(st.op[MEMO_STAT_GET].calls == STATS_THREADS * STATS_CALLS);
+    CHECK(st.op[MEMO_STAT_GET].errors == 0);
+    memo_stats_enable(false);
+    return 0;
+}
+
+#define ALLOC_MAGIC 0x6d656d6fUL
+
+struct alloc_count {
+    long live;
+    size_t bytes;
+};
+
+static struct alloc_count allocs;
+
+/* a header marks the blocks of the hooks, a block from elsewhere aborts in _free */
+static void *_malloc(size_t size, void *ctx)
+{
+    struct alloc_count *c = (struct alloc_count *)ctx;
+    unsigned long *p = (unsigned long *)malloc(size + 2 * sizeof(unsigned long));
+
+    if (p == NULL) {
+        return NULL;
+    }
+    p[0] = ALLOC_MAGIC;
+    c->live++;
+    c->bytes += size;
+    return p + 2;
+}
+
+static void _free(void *ptr, void *ctx)
+{
+    struct alloc_count *c = (struct alloc_count *)ctx;
+    unsigned long *p = (unsigned long *)ptr - 2;
+
+    if (p[0] != ALLOC_MAGIC) {
+        abort();
+    }
+    p[0] = 0;
+    c->live--;
+    free(p);
+}
+
+static void *_realloc(void *ptr, size_t size, void *ctx)
+{
+    unsigned long *p;
+
+    if (ptr == NULL) {
+        return _malloc(size, ctx);
+    }
+    p = (unsigned long *)ptr - 2;
+    if (p[0] != ALLOC_MAGIC) {
+        abort();
+    }
+    p = (unsigned long *)realloc(p, size + 2 * sizeof(unsigned long));
+    return p ? p + 2 : NULL;
+}
+
+static int s_allocator(void)
+{
+    return memo_set_allocator(_malloc, _free, _realloc, &allocs, false);
+}
+
+/* zlib and libpng allocate through the hooks of memo_set_allocator too */
+static int t_allocator(void)
+{
+    struct memo_data *md;
+    png_image image;
+    unsigned char pixels[16 * 8 * 4];
+    unsigned char *thumb = NULL;
+    char path[600];
+    size_t bytes;
+    int id, len = 0, i;
+
+    CHECK(memo_set_compression(64) == 0);
+    md = memo_create_data();
+    md->content = _malloc(4000, &allocs);
+    CHECK(md->content != NULL);
+    for (i = 0; i < 3999; i++) {
+        md->content[i] = "meeting tomorrow "[i % 17];
+    }
+    md->content[3999] = '\0';
+    bytes = allocs.bytes;
+    id = memo_add_data(md);
+    memo_free_data(md);
+    CHECK(id > 0);
+    CHECK(allocs.bytes - bytes > 256 * 1024); /* the state of deflate */
+    md = memo_get_data(id);
+    CHECK(md != NULL && strlen(md->content) == 3999);
+    memo_free_data(md);
+
+    /* a red doodle, twice as wide as high */
+    memset(pixels, 0, sizeof(pixels));
+    for (i = 0; i < 16 * 8; i++) {
+        pixels[i * 4] = 0xff;
+        pixels[i * 4 + 3] = 0xff;
+    }
+    memset(&image, 0, sizeof(image));
+    image.version = PNG_IMAGE_VERSION;
+    image.width = 16;
+    image.height = 8;
+    image.format = PNG_FORMAT_RGBA;
+    snprintf(path, sizeof(path), "%s.png", db_path);
+    CHECK(png_image_write_to_file(&image, path, 0, pixels, 0, NULL));
+
+    md = memo_create_data();
+    md->has_doodle = 1;
+    md->doodle_path = _malloc(strlen(path) + 1, &allocs);
+    CHECK(md->doodle_path != NULL);
+    strcpy(md->doodle_path, path);
+    id = memo_add_data(md);
+    memo_free_data(md);
+    CHECK(id > 0);
+    CHECK(memo_get_thumbnail(id, &thumb, &len) == 0 && len == MEMO_THUMB_WIDTH * MEMO_THUMB_HEIGHT * 4);
+    /* centered, the top quarter stays transparent */
+    CHECK(thumb[3] == 0);
+    i = (MEMO_THUMB_HEIGHT / 2 * MEMO_THUMB_WIDTH + MEMO_THUMB_WIDTH / 2) * 4;
+    CHECK(thumb[i] == 0xff && thumb[i + 1] == 0 && thumb[i + 3] == 0xff);
+    memo_free_thumbnail(thumb);
+    unlink(path);
+
+    memo_fini();
+    CHECK(allocs.live == 0);
+    return 0;
+}
+
+static const struct {
+    const char *name;
+    int (*fn)(void);
+    int (*setup)(void); /* before memo_init */
+} cases[] = {
+    {"color", t_color},
+    {"content_stream", t_content_stream},
+    {"update_missing", t_update_missing},
+    {"update_if_unchanged", t_update_if_unchanged},
+    {"delete_twice", t_delete_twice},
+    {"sort_key", t_sort_key},
+    {"collation_stored", t_collation_stored},
+    {"contains_like", t_contains_like},
+    {"title_ties", t_title_ties},
+    {"allocator", t_allocator, s_allocator},
+    {"import_doodle", t_import_doodle},
+    {"import_compression", t_import_compression},
+    {"import_long_line", t_import_long_line},
+    {"backup_locked", t_backup_locked},
+    {"snapshot", t_snapshot},
+    {"doodle_orphans", t_doodle_orphans},
+    {"stats_threads", t_stats_threads},
+};
+
+int main(int argc, char *argv[])
+{
+    unsigned int i;
+    int rc;
+
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s CASE DIR\n", argv[0]);
+        return 2;
+    }
+    for (i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        if (strcmp(cases[i].name, argv[1]) != 0) {
+            continue;
+        }
+        mkdir(argv[2], 0755);
+        snprintf(db_path, sizeof(db_path), "%s/memo.db", argv[2]);
+        unlink(db_path);
+        if (cases[i].setup != NULL && cases[i].setup() != 0) {
+            fprintf(stderr, "can't set up %s\n", cases[i].name);
+            return 1;
+        }
+        if (memo_init(db_path) != 0) {
+            fprintf(stderr, "can't open %s\n", db_path);
+            return 1;
+        }
+        rc = cases[i].fn();
+        memo_fini();
+        return rc == 0 ? 0 : 1;
+    }
+    fprintf(stderr, "no test case %s\n", argv[1]);
+    return 2;
+}